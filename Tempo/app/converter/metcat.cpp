@@ -12,42 +12,29 @@
  * binding.
  */
 
-#ifndef _COLOSSAL_METRIC_H
-#define _COLOSSAL_METRIC_H
+// Print a binary metrics stream written by sched_pred as text, one
+// metric per line, e.g. "metcat.app metrics.bin | grep runningTasks".
 
 #include <cstdio>
-#include <stdint.h>
-#include <string>
+#include <cstdlib>
+#include <Tempo/tempo.hpp>
 
-namespace Tempo
-{
-
-class metric {
-public:
-	metric(const std::string pref = "", FILE * fp = stdout)
-		: _key(pref), _fp(fp) { }
+using namespace Tempo;
 
-	void set_key(const std::string &key)
-	{
-		_key = key;
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s metrics\n", argv[0]);
+		return EXIT_FAILURE;
 	}
 
-	void set_value(const std::string &val)
-	{
-		fprintf(_fp, "%s\t%s\n", _key.c_str(), val.c_str());
+	metrics_file mf;
+	if (mf.open(argv[1]))
+		return EXIT_FAILURE;
+	if (mf.write_text(stdout)) {
+		fprintf(stderr, "Unable to print %s\n", argv[1]);
+		return EXIT_FAILURE;
 	}
 
-	void set_value(double val);
-	void set_value(int val);
-	void set_value(uint64_t val);
-
-	metric operator[](const std::string &key);
-
-protected:
-	std::string _key;
-	FILE *_fp;
-};
-
+	return 0;
 }
-
-#endif
@@ -12,42 +12,29 @@
  * binding.
  */
 
-#ifndef _COLOSSAL_METRIC_H
-#define _COLOSSAL_METRIC_H
+// Print a binary schedule written by sched_pred in the text format,
+// e.g. to feed the awk tools with "schedcat.app sched.bin | awk ...".
 
 #include <cstdio>
-#include <stdint.h>
-#include <string>
+#include <cstdlib>
+#include <Tempo/tempo.hpp>
 
-namespace Tempo
-{
-
-class metric {
-public:
-	metric(const std::string pref = "", FILE * fp = stdout)
-		: _key(pref), _fp(fp) { }
+using namespace Tempo;
 
-	void set_key(const std::string &key)
-	{
-		_key = key;
+int main(int argc, char *argv[])
+{
+	if (argc != 2) {
+		fprintf(stderr, "Usage: %s schedule\n", argv[0]);
+		return EXIT_FAILURE;
 	}
 
-	void set_value(const std::string &val)
-	{
-		fprintf(_fp, "%s\t%s\n", _key.c_str(), val.c_str());
+	schedule_file sf;
+	if (sf.open(argv[1]))
+		return EXIT_FAILURE;
+	if (sf.write_text(stdout)) {
+		fprintf(stderr, "Unable to print %s\n", argv[1]);
+		return EXIT_FAILURE;
 	}
 
-	void set_value(double val);
-	void set_value(int val);
-	void set_value(uint64_t val);
-
-	metric operator[](const std::string &key);
-
-protected:
-	std::string _key;
-	FILE *_fp;
-};
-
+	return 0;
 }
-
-#endif
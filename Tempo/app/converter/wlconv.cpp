@@ -0,0 +1,82 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+// Convert a text workload to the binary workload format, which
+// sched_pred and optimizer load in place of the text file.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <unistd.h>
+#include <Tempo/tempo.hpp>
+
+using namespace Tempo;
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-p] [-d] [-t threads] input output\n"
+		"  -p  input lines end with CTIME PTIME (optimizer workloads),\n"
+		"      otherwise with CTIME STIME FTIME (sched_pred workloads)\n"
+		"  -d  input is the dataset table of the extractor, with -p only\n"
+		"      the processing times are kept\n"
+		"  -t  number of parsing threads, all CPUs by default\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	bool ptime = false;
+	bool dataset = false;
+	int nthreads = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "pdt:h")) != -1) {
+		switch (c) {
+		case 'p':
+			ptime = true;
+			break;
+		case 'd':
+			dataset = true;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (argc - optind != 2) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+
+	workload_format fmt;
+	if (dataset)
+		fmt = ptime? WORKLOAD_DATASET_PTIME: WORKLOAD_DATASET;
+	else
+		fmt = ptime? WORKLOAD_PTIME: WORKLOAD_STIME_FTIME;
+	if (convert_text_workload(argv[optind], fmt, argv[optind + 1], nthreads)) {
+		fprintf(stderr, "Unable to convert %s\n", argv[optind]);
+		return EXIT_FAILURE;
+	}
+
+	workload_file wf;
+	if (wf.open(argv[optind + 1]))
+		return EXIT_FAILURE;
+	fprintf(stderr, "Converted %zu pools, %zu jobs and %zu tasks\n",
+		wf.pool_count(), wf.job_count(), wf.task_count());
+
+	return 0;
+}
@@ -20,8 +20,12 @@
 #include <vector>
 #include <iostream>
 #include <algorithm>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
 #include <gsl/gsl_blas.h>
 #include <libconfig.h++>
+#include <ulib/hash_func.h>
 #include <ulib/hash_open.h>
 #include <Tempo/tempo.hpp>
 
@@ -38,7 +42,7 @@ public:
 
     void proj(gsl_vector *x)
     {
-	size_t npools = _jt->getpools().size();
+	size_t npools = _reps[0]->jt->getpools().size();
 
 	for (size_t i = 0; i < npools; ++i) {
 	    size_t base = i * 5;
@@ -57,14 +61,146 @@ public:
 	}
     }
 
+    // Evaluate @x on the full workload
     void eval(const gsl_vector *x, gsl_vector *y)
     {
-	apply_params(x);
-	_jt->reset_time();
-	_jt->process();
-	compute_objs(y);
+	string line;
+	size_t k = _fids.size() - 1;
+	if (_fids[k]->recorded && _cache.lookup(x, y))
+	    describe(*_reps[0], x, y, &line);
+	else {
+	    simulate(*_reps[0], x, y, &line, true, k);
+	    _cache.insert(x, y);
+	    _fids[k]->recorded = true;
+	}
+	write_traj(line);
+    }
+
+    // Evaluate the points on the replicas concurrently, the trajectory
+    // keeps the order of the points. Points evaluated before, or equal
+    // to an earlier point of the batch, are not simulated. Only the
+    // evaluations on the full workload are cached.
+    void eval_batch(const gsl_matrix *xs, gsl_matrix *ys)
+    {
+	size_t n = xs->size1;
+	size_t first = 0;
+	fidelity &fd = *_fids[_fid];
+	bool full = _fid + 1 == _fids.size();
+	vector<pair<size_t, size_t> > dups;  // (point, its earlier copy)
+	batch_ctx ctx;
+	ctx.inst = this;
+	ctx.xs = xs;
+	ctx.ys = ys;
+	ctx.lines.resize(n);
+	ctx.exact.resize(n, true);
+	ctx.fid = _fid;
+	ctx.next = 0;
+	// the deadline baselines are recorded by the first evaluation
+	if (!fd.recorded && n) {
+	    gsl_vector_const_view x = gsl_matrix_const_row(xs, 0);
+	    gsl_vector_view y = gsl_matrix_column(ys, 0);
+	    simulate(*_reps[0], &x.vector, &y.vector, &ctx.lines[0], true, _fid);
+	    if (full)
+		_cache.insert(&x.vector, &y.vector);
+	    fd.recorded = true;
+	    first = 1;
+	}
+	for (size_t i = first; i < n; ++i) {
+	    gsl_vector_const_view x = gsl_matrix_const_row(xs, i);
+	    gsl_vector_view y = gsl_matrix_column(ys, i);
+	    size_t k = 0;
+	    while (k < ctx.todo.size() && !same_row(xs, ctx.todo[k], i))
+		++k;
+	    if (k < ctx.todo.size())
+		dups.push_back(make_pair(i, ctx.todo[k]));
+	    else if (full && _cache.lookup(&x.vector, &y.vector))
+		describe(*_reps[0], &x.vector, &y.vector, &ctx.lines[i]);
+	    else
+		ctx.todo.push_back(i);
+	}
+
+	vector<batch_worker> workers(_reps.size());
+	vector<pthread_t> tids(_reps.size());
+	size_t nstarted = 0;
+	for (size_t i = 0; i < _reps.size(); ++i) {
+	    workers[i].ctx = &ctx;
+	    workers[i].rep = _reps[i];
+	}
+	for (size_t i = 1; i < workers.size(); ++i)
+	    if (pthread_create(&tids[nstarted], NULL, run_batch, &workers[i]) == 0)
+		++nstarted;
+	run_batch(&workers[0]);
+	for (size_t i = 0; i < nstarted; ++i)
+	    pthread_join(tids[i], NULL);
+
+	// only complete simulations are kept
+	for (size_t k = 0; k < ctx.todo.size(); ++k) {
+	    if (!full || !ctx.exact[ctx.todo[k]])
+		continue;
+	    gsl_vector_const_view x = gsl_matrix_const_row(xs, ctx.todo[k]);
+	    gsl_vector_view y = gsl_matrix_column(ys, ctx.todo[k]);
+	    _cache.insert(&x.vector, &y.vector);
+	}
+	for (size_t k = 0; k < dups.size(); ++k) {
+	    gsl_vector_view y = gsl_matrix_column(ys, dups[k].first);
+	    gsl_vector_view src = gsl_matrix_column(ys, dups[k].second);
+	    gsl_vector_memcpy(&y.vector, &src.vector);
+	    ctx.lines[dups[k].first] = ctx.lines[dups[k].second];
+	}
+	_nrepeated += dups.size();
+
+	for (size_t i = 0; i < ctx.lines.size(); ++i)
+	    write_traj(ctx.lines[i]);
     }
 
+    // Bound the mean response times of latency pools by the limits
+    // of the pools and the objectives by @ub, see simulate()
+    void set_bound(const gsl_vector *ub)
+    {
+	for (size_t i = 0; i < _limit.size(); ++i) {
+	    _bound_ub[i] = _limit[i];
+	    if (ub)
+		_bound_ub[i] = min(_bound_ub[i], gsl_vector_get(ub, i));
+	}
+    }
+
+    // Batches of larger perturbations are simulated on smaller samples
+    // of the workload, the fidelity doubling each time @scale halves up
+    // to the full workload. @ref gets the objectives of x0 on the
+    // sample, recorded the first time the sample is used.
+    void set_scale(double scale, gsl_vector *ref)
+    {
+	size_t k = 0;
+	double lowest = _fids[0]->fraction;
+	while (k + 1 < _fids.size() &&
+	       _fids[k + 1]->fraction * scale <= lowest * (1 + 1e-9))
+	    ++k;
+	fidelity &fd = *_fids[k];
+	if (k != _fid) {
+	    _fid = k;
+	    if (_fid_mode == "jobs")
+		fprintf(stderr, "Batches simulate %g%% of the jobs on %d maps and %d reduces\n",
+			fd.fraction * 100, fd.nmap, fd.nreduce);
+	    else
+		fprintf(stderr, "Batches simulate %g%% of the creation time window\n",
+			fd.fraction * 100);
+	}
+	if (k + 1 == _fids.size())
+	    return;
+	if (!fd.recorded) {
+	    string line;
+	    simulate(*_reps[0], _x0, fd.ref, &line, true, k);
+	    fd.recorded = true;
+	}
+	gsl_vector_memcpy(ref, fd.ref);
+    }
+
+    // evaluations served by the cache
+    const eval_cache &cache() const { return _cache; }
+    size_t simulated() const { return _nsim; }
+    size_t stopped() const { return _nstopped; }
+    size_t repeated() const { return _nrepeated; }
+
     problem(const string &conf)
     {
 	try {
@@ -89,21 +225,86 @@ public:
 	    _alpha      = _conf.lookup("optimizer.learning_rate");
 	    _lambda     = _conf.lookup("optimizer.regularization");
 	    _tau        = _conf.lookup("optimizer.bandwidth");
+	    // optional window of job creation times to optimize for
+	    _win_start  = -HUGE_VAL;
+	    _win_end    = HUGE_VAL;
+	    _windowed   = _conf.lookupValue("optimizer.window_start", _win_start);
+	    _windowed   = _conf.lookupValue("optimizer.window_end", _win_end) || _windowed;
+	    // optional socket serving the state of the optimization
+	    std::string sock;
+	    if (_conf.lookupValue("optimizer.introspect", sock) &&
+		introspect_open(sock.c_str()))
+		cerr << "Introspection is disabled" << endl;
+	    // optional number of simulations run at once
+	    _nthreads = 1;
+	    _conf.lookupValue("optimizer.threads", _nthreads);
+	    // optional file keeping the evaluations across runs
+	    _conf.lookupValue("optimizer.cache", _cache_file);
+	    _strict = false;
+	    _conf.lookupValue("optimizer.strict", _strict);
+	    // optional multi-fidelity batches
+	    _fid_min = 0.25;
+	    _conf.lookupValue("optimizer.fidelity", _fid_mode);
+	    _conf.lookupValue("optimizer.fidelity_min", _fid_min);
 	} catch (const SettingNotFoundException &e) {
 	    cerr << "Missing a setting in configuration file" << endl;
 	    exit(EXIT_FAILURE);
 	}
 
+	if (_nthreads <= 0)
+	    _nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	// no more threads than points in a batch
+	_nthreads = max(1, min(_nthreads, 2 * _bs));
+	if (_fid_mode.size() && _fid_mode != "jobs" && _fid_mode != "window") {
+	    cerr << "Fidelity " << _fid_mode << " is not predefined" << endl;
+	    exit(EXIT_FAILURE);
+	}
+	if (!(_fid_min > 0 && _fid_min <= 1)) {
+	    cerr << "Illegal fidelity_min " << _fid_min << endl;
+	    exit(EXIT_FAILURE);
+	}
+
 	cerr << "Initialize the job tracker ...\t";
-	_jt = new job_tracker(_nmap, _nreduce);
-	init_job_tracker();
+	for (int i = 0; i < _nthreads; ++i) {
+	    _reps.push_back(new replica);
+	    _reps[i]->jt = new job_tracker(_nmap, _nreduce);
+	    init_job_tracker(_reps[i], i == 0);
+	    _reps[i]->bound.init(this, _reps[i]);
+	}
+	init_fidelities();
+	_bound_ub = _limit;
+	_x0 = gsl_vector_alloc(var_count());
+	get_config(_x0);
+	proj(_x0);
+	if (_nthreads > 1)
+	    cerr << "Simulating " << _nthreads << " configurations at once" << endl;
+
+	_nsim = 0;
+	_nstopped = 0;
+	_nrepeated = 0;
+	if (_cache_file.size()) {
+	    if (_cache.open(_cache_file.c_str(), context()))
+		cerr << "Evaluations are not saved" << endl;
+	    else
+		cerr << "Loaded " << _cache.size() << " saved evaluations" << endl;
+	}
 
 	_fp_traj = NULL;
     }
 
     ~problem()
     {
-	delete _jt;
+	for (size_t i = 0; i < _reps.size(); ++i) {
+	    delete _reps[i]->jt;
+	    for (size_t k = 0; k < _reps[i]->samples.size(); ++k)
+		delete _reps[i]->samples[k];
+	    delete _reps[i];
+	}
+	for (size_t k = 0; k < _fids.size(); ++k) {
+	    gsl_vector_free(_fids[k]->ref);
+	    delete _fids[k];
+	}
+	gsl_vector_free(_x0);
 	if (_fp_traj)
 	    fclose(_fp_traj);
     }
@@ -115,12 +316,12 @@ public:
     double get_lambda() const { return _lambda; }
     double get_bandwidth() const { return _tau; }
     bool   get_strict() const { return _strict; }
-    size_t var_count() const { return _jt->getpools().size() * 5; }
-    size_t obj_count() const { return _jt->getpools().size(); }
+    size_t var_count() const { return _reps[0]->jt->getpools().size() * 5; }
+    size_t obj_count() const { return _reps[0]->jt->getpools().size(); }
 
     void get_config(gsl_vector *x) const
     {
-	const job_tracker::pool_container_type &pools = _jt->getpools();
+	const job_tracker::pool_container_type &pools = _reps[0]->jt->getpools();
 	typename job_tracker::pool_container_type::const_iterator it = pools.begin();
 	for (size_t i = 0; it != pools.end(); ++i, ++it) {
 	    size_t base = i * 5;
@@ -134,42 +335,231 @@ public:
 
 
 private:
-    void init_job_tracker()
+    // A deterministic sample of the workload the batches may be
+    // simulated on, see set_scale()
+    struct fidelity {
+	double fraction;   // of the jobs or of the creation time window
+	int    nmap;       // slots scaled to the jobs simulated
+	int    nreduce;
+	double start;      // creation time window simulated
+	double end;
+	bool   recorded;   // whether the deadline baselines are recorded
+	open_hash_map<uint64_t,double> job_ftime;  // deadline baselines
+	gsl_vector *ref;   // objectives of x0
+    };
+
+    struct replica;
+
+    // Stops a simulation once its objectives are decided: the jobs of
+    // every objective pool have completed, or the objective of a pool
+    // is known to exceed its bound. Pools are indexed in their order.
+    class objective_bound : public run_bound {
+    public:
+	void init(problem *inst, replica *rep)
+	{
+	    _inst = inst;
+	    const job_tracker::pool_container_type &pools = rep->jt->getpools();
+	    size_t i = 0;
+	    for (typename job_tracker::pool_container_type::const_iterator it = pools.begin();
+		 it != pools.end(); ++it, ++i)
+		_index[it->id] = i;
+	    _left.resize(pools.size());
+	    _njobs.resize(pools.size());
+	    _acc.resize(pools.size());
+	}
+
+	void reset(const vector<double> &ub, const fidelity *fd)
+	{
+	    _ub = ub;
+	    _fd = fd;
+	}
+
+	void start(const std::list<pool> &pools)
+	{
+	    fill(_left.begin(), _left.end(), 0);
+	    fill(_njobs.begin(), _njobs.end(), 0);
+	    fill(_acc.begin(), _acc.end(), 0);
+	    _exceeded = false;
+	    size_t i = 0;
+	    for (std::list<pool>::const_iterator it = pools.begin();
+		 it != pools.end(); ++it, ++i) {
+		size_t nrun = 0;
+		for (size_t k = 0; k < it->jobs.size(); ++k) {
+		    if (it->jobs[k].nleft == 0)
+			continue;
+		    ++nrun;
+		    if (_inst->_slack[i] >= 0 && objective(it->jobs[k]))
+			++_left[i];
+		}
+		// the response times count in the ancestors too
+		for (const pool *p = &*it; p; p = p->parent) {
+		    size_t a = _index[p->id];
+		    if (is_latency(a)) {
+			_njobs[a] += nrun;
+			_left[a] += nrun;
+		    }
+		}
+	    }
+	    _pending = 0;
+	    for (i = 0; i < _left.size(); ++i)
+		_pending += !complete(i);
+	}
+
+	bool job_done(const pool &p, const job &j, double now)
+	{
+	    (void)now;
+	    size_t i = _index[p.id];
+	    if (_inst->_slack[i] >= 0 && objective(j)) {
+		double base = _inst->baseline(*_fd, j.id);
+		if (!double_equal(base, 0) && _inst->is_late(i, j, base) &&
+		    ++_acc[i] > _ub[i])
+		    _exceeded = true;
+		if (--_left[i] == 0)
+		    --_pending;
+	    }
+	    for (const pool *q = &p; q; q = q->parent) {
+		size_t a = _index[q->id];
+		if (!is_latency(a))
+		    continue;
+		_acc[a] += j.ftime - j.ctime;
+		if (_acc[a] / _njobs[a] > _ub[a])
+		    _exceeded = true;
+		if (--_left[a] == 0)
+		    --_pending;
+	    }
+	    return _exceeded || _pending == 0;
+	}
+
+	bool exceeded() const { return _exceeded; }
+
+	// Whether the objective of the i-th pool is final
+	bool complete(size_t i) const
+	{
+	    double slack = _inst->_slack[i];
+	    if (fabs(slack + 3) < 0.1 || fabs(slack + 4) < 0.1)
+		return false;  // utilizations depend on the whole run
+	    return _left[i] == 0;
+	}
+
+	// A lower bound of the objective of the i-th pool
+	double lower_bound(size_t i) const
+	{
+	    double slack = _inst->_slack[i];
+	    if (slack >= 0)
+		return _acc[i];
+	    if (is_latency(i))
+		return _acc[i] / _njobs[i];
+	    if (fabs(slack + 1) < 0.1)
+		return 0;
+	    return -1.0;  // utilizations are at most one
+	}
+
+    private:
+	bool is_latency(size_t i) const { return fabs(_inst->_slack[i] + 2) < 0.1; }
+
+	// the deadlines count the jobs of the simulated sample
+	bool objective(const job &j) const
+	{
+	    return j.ctime >= _fd->start && j.ctime < _fd->end &&
+		(_inst->_fid_mode != "jobs" || workload_index::sampled(j, _fd->fraction));
+	}
+
+	problem *_inst;
+	const fidelity *_fd;
+	open_hash_map<uint64_t, size_t> _index;  // pool id to position
+	vector<size_t> _left;    // jobs left to complete
+	vector<size_t> _njobs;   // jobs of the latency pools
+	vector<double> _acc;     // missed deadlines or response times
+	vector<double> _ub;
+	size_t _pending;         // pools whose objectives are not final
+	bool   _exceeded;
+    };
+
+    // A copy of the pools and the workload with the engine simulating
+    // them, one per simulation run at once
+    struct replica {
+	job_tracker    *jt;
+	workload_index  index;
+	vector<workload_index *> samples;  // job samples by fidelity
+	vector<workload_view> views;       // by fidelity
+	objective_bound bound;
+    };
+
+    struct batch_ctx {
+	problem             *inst;
+	const gsl_matrix    *xs;
+	gsl_matrix          *ys;
+	vector<size_t>       todo;   // points to simulate
+	vector<string>       lines;
+	vector<char>         exact;  // whether the points ran to the end
+	size_t               fid;
+	volatile size_t      next;
+    };
+
+    struct batch_worker {
+	batch_ctx *ctx;
+	replica   *rep;
+    };
+
+    // Simulate the points of a batch as they are claimed
+    static void *run_batch(void *arg)
+    {
+	batch_worker *w = (batch_worker *)arg;
+	batch_ctx *ctx = w->ctx;
+
+	for (;;) {
+	    size_t k = __sync_fetch_and_add(&ctx->next, 1);
+	    if (k >= ctx->todo.size())
+		break;
+	    size_t i = ctx->todo[k];
+	    gsl_vector_const_view x = gsl_matrix_const_row(ctx->xs, i);
+	    gsl_vector_view y = gsl_matrix_column(ctx->ys, i);
+	    ctx->exact[i] = ctx->inst->simulate(*w->rep, &x.vector, &y.vector,
+						&ctx->lines[i], false, ctx->fid);
+	}
+	return NULL;
+    }
+
+    // Add the pools of a pool list to @jt, recursing into nested
+    // "pools" lists, the UDS are kept for the first replica
+    // Returns the number of pools added
+    int add_pools(job_tracker *jt, const Setting &pools, Tempo::pool *parent)
     {
-	// setup pools
-	const Setting &pools = _conf.lookup("pools");
 	int npools = pools.getLength();
+	int nadded = 0;
 
 	for (int i = 0; i < npools; ++i) {
 	    const Setting &pool = pools[i];
+	    bool internal = pool.exists("pools");
 	    string name;
-	    string sched_mode;
-	    double min_share_timeout;
-	    double fair_share_timeout;
+	    string sched_mode = "fair";
+	    double min_share_timeout = -1;
+	    double fair_share_timeout = -1;
 	    double weight;
-	    string uds;
+	    string uds = "ignore";
 	    double slack = 0.0;
+	    double latency_limit = HUGE_VAL;
 	    int    map_min_share;
 	    int    reduce_min_share;
 	    gen_param_t param;
 	    param.resize(9);
+	    // scheduling mode, timeouts and UDS only matter to leaf pools
 	    if (!(pool.lookupValue("name", name) &&
-		  pool.lookupValue("sched_mode", sched_mode) &&
-		  pool.lookupValue("min_share_timeout", min_share_timeout) &&
-		  pool.lookupValue("fair_share_timeout", fair_share_timeout) &&
+		  (pool.lookupValue("sched_mode", sched_mode) || internal) &&
+		  (pool.lookupValue("min_share_timeout", min_share_timeout) || internal) &&
+		  (pool.lookupValue("fair_share_timeout", fair_share_timeout) || internal) &&
 		  pool.lookupValue("weight", weight) &&
-		  pool.lookupValue("uds", uds) &&
+		  (pool.lookupValue("uds", uds) || internal) &&
 		  pool.lookupValue("map_min_share", map_min_share) &&
 		  pool.lookupValue("reduce_min_share", reduce_min_share))) {
-		cerr << "Missing pool settings for pool " << i << endl;
+		cerr << "Missing pool settings for pool " << i;
+		if (parent)
+		    cerr << " of " << parent->name;
+		cerr << endl;
 		exit(EXIT_FAILURE);
 	    }
 	    pool::sched_mode sched;
-	    if (sched_mode == "fair")
-		sched = pool::SCHED_FAIR;
-	    else if (sched_mode == "fcfs" || sched_mode == "fifo")
-		sched = pool::SCHED_FCFS;
-	    else {
+	    if (!selector::parse_sched_mode(sched_mode.c_str(), &sched)) {
 		ULIB_WARNING("invalid scheduling mode:%s for pool %s",
 			     sched_mode.c_str(), name.c_str());
 		exit(EXIT_FAILURE);
@@ -182,8 +572,10 @@ private:
 		    cerr << "Illegal slack specified for pool " << i << endl;
 		    exit(EXIT_FAILURE);
 		}
-	    } else if (!strcasecmp(uds.c_str(), "latency"))
+	    } else if (!strcasecmp(uds.c_str(), "latency")) {
 		slack = -2;
+		pool.lookupValue("latency_limit", latency_limit);
+	    }
 	    else if (!strcasecmp(uds.c_str(), "map_util"))
 		slack = -3;
 	    else if (!strcasecmp(uds.c_str(), "red_util"))
@@ -192,27 +584,256 @@ private:
 		cerr << "UDS " << uds << " is not predefined" << endl;
 		exit(EXIT_FAILURE);
 	    }
-	    _slack.push_back(slack);
-	    _jt->add_pool(name, min_share_timeout, fair_share_timeout,
-			  weight, map_min_share, reduce_min_share, sched);
+	    if (jt == _reps[0]->jt) {
+		_slack.push_back(slack);
+		_limit.push_back(latency_limit);
+	    }
+	    Tempo::pool &p =
+		jt->add_pool(name, min_share_timeout, fair_share_timeout,
+			     weight, map_min_share, reduce_min_share, sched, parent);
+	    ++nadded;
+	    if (internal)
+		nadded += add_pools(jt, pool["pools"], &p);
 	}
-	_jt->scale_minshares();
-	cerr << "Loaded " << npools << " pools" << endl;
-	if (import_workload1(_workload.c_str(), &_jt->getpools())) {
+	return nadded;
+    }
+
+    // Load the pools and the workload into a replica, reporting on
+    // the first one only
+    void init_job_tracker(replica *rep, bool verbose)
+    {
+	job_tracker *jt = rep->jt;
+
+	// replicas simulate at once, only the primary shows its progress
+	// and publishes its state, so that the rates are of one engine
+	jt->report_progress(verbose);
+	jt->report_state(verbose);
+
+	// setup pools
+	int npools = add_pools(jt, _conf.lookup("pools"), NULL);
+	jt->scale_minshares();
+	if (verbose)
+	    cerr << "Loaded " << npools << " pools" << endl;
+	if (import_workload1(_workload.c_str(), &jt->getpools())) {
 	    cerr << "Unable to load workload" << endl;
 	    exit(EXIT_FAILURE);
 	}
+	// the windows of creation times are sliced from the index
+	if (_windowed || _fid_mode == "window")
+	    rep->index.build(jt->getpools());
+	if (!verbose)
+	    return;
 	cerr << "Loaded workload" << endl;
+	// workloads with observed task times, e.g. binary workloads
+	// converted from a trace, show the utilization to improve on
+	utilization_report r;
+	if (!analyze_utilization(jt->getpools(), _nmap, _nreduce, &r) &&
+	    r.ntasks[task::TASK_TYPE_MAP] + r.ntasks[task::TASK_TYPE_REDUCE])
+	    cerr << "Observed utilization map: " << r.cluster[task::TASK_TYPE_MAP]
+		 << " reduce: " << r.cluster[task::TASK_TYPE_REDUCE] << endl;
+    }
+
+    // Set up the fidelities from fidelity_min doubling up to the full
+    // workload, and the views of the replicas simulating them
+    void init_fidelities()
+    {
+	vector<double> fractions;
+	for (double f = _fid_min; _fid_mode.size() && f < 1; f *= 2)
+	    fractions.push_back(f);
+	fractions.push_back(1);
+
+	// the window the samples are taken from
+	const workload_index &index = _reps[0]->index;
+	double start = max(_win_start, index.min_ctime());
+	double end = min(_win_end, index.max_ctime());
+	for (size_t k = 0; k < fractions.size(); ++k) {
+	    fidelity *fd = new fidelity;
+	    fd->fraction = fractions[k];
+	    fd->nmap = _nmap;
+	    fd->nreduce = _nreduce;
+	    fd->start = _win_start;
+	    fd->end = _win_end;
+	    if (k + 1 < fractions.size()) {
+		if (_fid_mode == "jobs") {
+		    fd->nmap = max(1, (int)(_nmap * fd->fraction + 0.5));
+		    fd->nreduce = max(1, (int)(_nreduce * fd->fraction + 0.5));
+		} else if (start <= end) {
+		    fd->start = start;
+		    fd->end = start + fd->fraction * (end - start);
+		}
+	    }
+	    fd->recorded = false;
+	    fd->ref = gsl_vector_alloc(obj_count());
+	    _fids.push_back(fd);
+	}
+	_fid = _fids.size() - 1;
+
+	for (size_t i = 0; i < _reps.size(); ++i) {
+	    replica *rep = _reps[i];
+	    for (size_t k = 0; k < _fids.size(); ++k) {
+		const fidelity &fd = *_fids[k];
+		workload_index *sample = NULL;
+		if (k + 1 < _fids.size() && _fid_mode == "jobs") {
+		    sample = new workload_index;
+		    sample->build(rep->jt->getpools(), 64, fd.fraction);
+		}
+		rep->samples.push_back(sample);
+		if (sample)
+		    rep->views.push_back(sample->slice(fd.start, fd.end));
+		else if (k + 1 < _fids.size() || _windowed)
+		    rep->views.push_back(rep->index.slice(fd.start, fd.end));
+		else
+		    rep->views.push_back(workload_view());
+	    }
+	}
+
+	const workload_view &full = _reps[0]->views.back();
+	if (_windowed)
+	    cerr << "Optimizing for " << full.job_count() << " jobs and "
+		 << full.task_count() << " tasks within the window" << endl;
+	for (size_t k = 0; k + 1 < _fids.size(); ++k)
+	    cerr << "Fidelity " << _fids[k]->fraction << ": "
+		 << _reps[0]->views[k].job_count() << " jobs and "
+		 << _reps[0]->views[k].task_count() << " tasks on "
+		 << _fids[k]->nmap << " maps and " << _fids[k]->nreduce
+		 << " reduces" << endl;
+    }
+
+    // The view simulated at the k-th fidelity, NULL for all jobs
+    const workload_view *view_of(const replica &rep, size_t k) const
+    {
+	if (k + 1 == _fids.size() && !_windowed)
+	    return NULL;
+	return &rep.views[k];
+    }
+
+    // jobs of the i-th pool the objectives are computed for
+    size_t job_count(const workload_view *view, size_t i, const pool &p) const
+    {
+	return view? view->parts[i].job_count(): p.jobs.size();
+    }
+
+    const job &job_at(const workload_view *view, size_t i, const pool &p, size_t k) const
+    {
+	if (view)
+	    return view->parts[i].job_at(view->parts[i].jobs[k]);
+	return p.jobs[k];
+    }
+
+    // Hash of what the evaluations depend on besides the decision
+    // variables: the workload, the cluster, the UDS and the initial
+    // configuration, of which the deadline baselines are recorded
+    uint64_t context() const
+    {
+	char buf[64];
+	struct stat st;
+	string ctx = _workload;
+
+	if (stat(_workload.c_str(), &st) == 0) {
+	    snprintf(buf, sizeof(buf), " %ld %ld", (long)st.st_size, (long)st.st_mtime);
+	    ctx += buf;
+	}
+	snprintf(buf, sizeof(buf), " %d %d ", _nmap, _nreduce);
+	ctx += buf;
+	ctx.append(buf, format_double(_win_start, buf));
+	ctx += ' ';
+	ctx.append(buf, format_double(_win_end, buf));
+	const job_tracker::pool_container_type &pools = _reps[0]->jt->getpools();
+	size_t i = 0;
+	for (typename job_tracker::pool_container_type::const_iterator it = pools.begin();
+	     it != pools.end(); ++it, ++i) {
+	    ctx += ' ' + it->name + ' ' + selector::get_policy(it->sched)->name + ' ';
+	    ctx.append(buf, format_double(_slack[i], buf));
+	}
+	gsl_vector *x0 = gsl_vector_alloc(var_count());
+	get_config(x0);
+	for (i = 0; i < x0->size; ++i) {
+	    ctx += ' ';
+	    ctx.append(buf, format_double(gsl_vector_get(x0, i), buf));
+	}
+	gsl_vector_free(x0);
+
+	return hash_fast64(ctx.data(), ctx.size(), 0);
+    }
+
+    static bool same_row(const gsl_matrix *m, size_t i, size_t j)
+    {
+	for (size_t k = 0; k < m->size2; ++k)
+	    if (gsl_matrix_get(m, i, k) != gsl_matrix_get(m, j, k))
+		return false;
+	return true;
+    }
+
+    // Simulate the configuration @x on a replica, the trajectory line
+    // of the evaluation goes to @line
+    // record: record the deadline baselines of jobs without one, only
+    // one replica may do so at a time. Otherwise the simulation stops
+    // once the objectives are decided, see objective_bound.
+    // Returns false if an objective exceeded its bound, the objectives
+    // of the pools whose jobs did not all complete are lower bounds.
+    // k: the fidelity to simulate at
+    bool simulate(replica &rep, const gsl_vector *x, gsl_vector *y,
+		  string *line, bool record, size_t k)
+    {
+	fidelity &fd = *_fids[k];
+	apply_params(rep.jt, x, fd);
+	rep.jt->reset_time();
+	rep.bound.reset(_bound_ub, &fd);
+	rep.jt->set_bound(record? NULL: &rep.bound);
+	rep.jt->process(view_of(rep, k));
+	__sync_fetch_and_add(&_nsim, 1);
+	compute_objs(rep, k, y, record);
+	if (rep.jt->stopped())
+	    __sync_fetch_and_add(&_nstopped, 1);
+	bool exact = record || !rep.bound.exceeded();
+	if (!exact) {
+	    for (size_t i = 0; i < y->size; ++i)
+		if (!rep.bound.complete(i))
+		    gsl_vector_set(y, i, rep.bound.lower_bound(i));
+	}
+	format_traj(*rep.jt, y, fd, line);
+	return exact;
+    }
+
+    // The recorded finish time of a job, 0 if none
+    double baseline(const fidelity &fd, uint64_t id) const
+    {
+	open_hash_map<uint64_t,double>::const_iterator b = fd.job_ftime.find(id);
+	return b == fd.job_ftime.end()? 0: b.value();
+    }
+
+    // Whether job @jb of the i-th pool misses its deadline, given the
+    // baseline finish time @base
+    bool is_late(size_t i, const job &jb, double base) const
+    {
+	if (_slack[i] < 1.0)
+	    // slack is in percentage,
+	    // slack computed based on job processing time
+	    return jb.ftime > base + _slack[i] * (base - jb.ctime);
+	return jb.ftime > base + _slack[i];
     }
 
-    void apply_params(const gsl_vector *x)
+    // The trajectory line of a cached evaluation
+    void describe(replica &rep, const gsl_vector *x, const gsl_vector *y,
+		  string *line)
     {
-	job_tracker::pool_container_type &pools = _jt->getpools();
+	apply_params(rep.jt, x, *_fids.back());
+	format_traj(*rep.jt, y, *_fids.back(), line);
+    }
+
+    // Apply @x to the pools on the slots of the fidelity, min shares
+    // are scaled with the slots
+    void apply_params(job_tracker *jt, const gsl_vector *x, const fidelity &fd)
+    {
+	job_tracker::pool_container_type &pools = jt->getpools();
 	if (x->size != 5 * pools.size()) {
 	    cerr << "Number of decision variables is incorrect: " << x->size << endl;
 	    exit(EXIT_FAILURE);
 	}
 
+	jt->set_slots(fd.nmap, fd.nreduce);
+	double map_scale = fd.nmap == _nmap? 1: (double)fd.nmap / _nmap;
+	double reduce_scale = fd.nreduce == _nreduce? 1: (double)fd.nreduce / _nreduce;
 	size_t i = 0;
 	for (typename job_tracker::pool_container_type::iterator it = pools.begin();
 	     it != pools.end(); ++it, ++i) {
@@ -222,81 +843,97 @@ private:
 		       gsl_vector_get(x, base + 0),
 		       gsl_vector_get(x, base + 1),
 		       gsl_vector_get(x, base + 2),
-		       gsl_vector_get(x, base + 3),
-		       gsl_vector_get(x, base + 4),
+		       gsl_vector_get(x, base + 3) * map_scale,
+		       gsl_vector_get(x, base + 4) * reduce_scale,
 		       it->sched);
 	}
-	_jt->scale_minshares();
+	jt->scale_minshares();
     }
 
-    void compute_objs(gsl_vector *y)
+    void write_traj(const string &line)
     {
 	if (_fp_traj == NULL && (_fp_traj = fopen(_traj_file.c_str(), "w")) == NULL) {
 	    cerr << "Cannot open trajectory file " << _traj_file << endl;
 	    exit(EXIT_FAILURE);
 	}
+	fputs(line.c_str(), _fp_traj);
+	fflush(_fp_traj);
+    }
 
-	job_tracker::pool_container_type &pools = _jt->getpools();
+    // The applied settings of the pools followed by the objectives,
+    // and the fraction of the workload simulated if the batches may
+    // simulate a sample
+    void format_traj(const job_tracker &jt, const gsl_vector *y,
+		     const fidelity &fd, string *line) const
+    {
+	char buf[512];
+
+	line->clear();
+	const job_tracker::pool_container_type &pools = jt.getpools();
 	size_t npool = pools.size();
 	size_t i = 0;
 	for (typename job_tracker::pool_container_type::const_iterator it = pools.begin();
 	     it != pools.end(); ++it, ++i) {
-	    fprintf(_fp_traj, "%lf %lf %lf %lf %lf%c",
-		    it->ms_timeout,
-		    it->hf_timeout,
-		    it->fs_ctx_map.weight,
-		    it->fs_ctx_map.minshare,
-		    it->fs_ctx_reduce.minshare,
-		    i == npool - 1? '\t': ' ');
+	    snprintf(buf, sizeof(buf), "%lf %lf %lf %lf %lf%c",
+		     it->ms_timeout,
+		     it->hf_timeout,
+		     it->fs_ctx_map.weight,
+		     it->fs_ctx_map.minshare,
+		     it->fs_ctx_reduce.minshare,
+		     i == npool - 1? '\t': ' ');
+	    line->append(buf);
+	}
+	for (i = 0; i < npool; ++i) {
+	    snprintf(buf, sizeof(buf), "%lf%c", gsl_vector_get(y, i),
+		     i == npool - 1? '\n': ' ');
+	    line->append(buf);
+	}
+	if (_fids.size() > 1) {
+	    snprintf(buf, sizeof(buf), "\t%lf\n", fd.fraction);
+	    line->replace(line->size() - 1, 1, buf);
 	}
+    }
 
-	i = 0;
+    void compute_objs(replica &rep, size_t k, gsl_vector *y, bool record)
+    {
+	fidelity &fd = *_fids[k];
+	const workload_view *view = view_of(rep, k);
+	job_tracker::pool_container_type &pools = rep.jt->getpools();
+	size_t i = 0;
 	for (typename job_tracker::pool_container_type::const_iterator it = pools.begin();
 	     it != pools.end(); ++it, ++i) {
 	    double jd = 0.0;
 	    if (_slack[i] < 0) {
 		if (fabs(_slack[i] + 1) < 0.1) // ignore UDS
 		    jd = 0;
-		else if (fabs(_slack[i] + 2) < 0.1) { // latency UDS
-		    for (size_t j = 0; j < it->jobs.size(); ++j)
-			jd += it->jobs[j].ftime - it->jobs[j].ctime;
-		    if (it->jobs.size())
-			jd /= it->jobs.size();
-		    else
-			jd = 0.0;
-		} else if (fabs(_slack[i] + 3) < 0.1) // map util UDS
-		    jd = -compute_utilization(*it, task::TASK_TYPE_MAP, _nmap);
+		else if (fabs(_slack[i] + 2) < 0.1) // latency UDS
+		    jd = it->response_times.mean();
+		else if (fabs(_slack[i] + 3) < 0.1) // map util UDS
+		    jd = -it->map_usage.utilization(fd.nmap);
 		else if (fabs(_slack[i] + 4) < 0.1) // reduce util UDS
-		    jd = -compute_utilization(*it, task::TASK_TYPE_REDUCE, _nreduce);
+		    jd = -it->reduce_usage.utilization(fd.nreduce);
 		else {
 		    cerr << "Unknown slack value:" << _slack[i] << endl;
 		    exit(EXIT_FAILURE);
 		}
 	    } else {  // use the number of deadline violations
-		for (size_t j = 0; j < it->jobs.size(); ++j) {
-		    if (double_equal(_job_ftime[it->jobs[j].id], 0))
-			_job_ftime[it->jobs[j].id] = it->jobs[j].ftime;
-		    else {
-			if (_slack[i] < 1.0) {
-			    // slack is in percentage,
-			    // slack computed based on job processing time
-			    jd += it->jobs[j].ftime > _job_ftime[it->jobs[j].id] +
-				_slack[i] * (_job_ftime[it->jobs[j].id] - it->jobs[j].ctime);
-			} else
-			    jd += it->jobs[j].ftime > _job_ftime[it->jobs[j].id] + _slack[i];
-		    }
+		for (size_t j = 0; j < job_count(view, i, *it); ++j) {
+		    const job &jb = job_at(view, i, *it, j);
+		    // concurrent evaluations only look the baselines up
+		    double base = record? fd.job_ftime[jb.id]: baseline(fd, jb.id);
+		    if (double_equal(base, 0)) {
+			if (record)
+			    fd.job_ftime[jb.id] = jb.ftime;
+		    } else
+			jd += is_late(i, jb, base);
 		}
 	    }
 	    gsl_vector_set(y, i, jd);
-	    fprintf(_fp_traj, "%lf%c", jd,
-		    i == npool - 1? '\n': ' ');
 	}
-
-	fflush(_fp_traj);
     }
 
     Config _conf;
-    job_tracker * _jt;
+    vector<replica *> _reps;  // the first one also serves eval()
     FILE *_fp_traj;
 
     int _nmap;
@@ -312,7 +949,22 @@ private:
     double _tau;
     bool   _strict;
     vector<double> _slack;
-    open_hash_map<uint64_t,double> _job_ftime;
+    vector<double> _limit;     // latency limits, HUGE_VAL if none
+    vector<double> _bound_ub;  // bounds of the objectives
+    bool   _windowed;
+    double _win_start;
+    double _win_end;
+    int    _nthreads;
+    string _cache_file;
+    eval_cache _cache;
+    vector<fidelity *> _fids;  // rising, the last one is the full workload
+    size_t _fid;               // the fidelity of the batches
+    string _fid_mode;          // "jobs", "window" or empty for none
+    double _fid_min;
+    gsl_vector *_x0;           // the initial configuration
+    size_t _nsim;
+    size_t _nstopped;   // simulations stopped at a bound
+    size_t _nrepeated;  // points repeated within a batch
 };
 
 int main()
@@ -361,16 +1013,16 @@ int main()
     }
 
     inst.get_config(x0);
-    gsl_vector *ub = gsl_vector_alloc(nobj);
     inst.proj(x0);
-    inst.eval(x0, ub);
-    
-    solver(&inst, x0, niter, bs, deg, alpha, lambda, tau, xval, fval);
-    //solver(&inst, x0, niter, bs, deg, alpha, lambda, tau, ub, xval, fval);
 
-    cerr << "Optimization completed, trajectory has been saved" << endl;
+    solver(&inst, x0, niter, bs, deg, alpha, lambda, tau, xval, fval,
+	   umbra::OPT_LINEAR, strict);
 
-    gsl_vector_free(ub);
+    cerr << "Optimization completed, trajectory has been saved" << endl;
+    const eval_cache &cache = inst.cache();
+    fprintf(stderr, "Evaluations: %zu simulated, %zu stopped early, %zu cached, "
+	    "%zu repeated, %.1f%% cache hits\n", inst.simulated(), inst.stopped(),
+	    cache.hits(), inst.repeated(), cache.hit_rate() * 100);
     gsl_vector_free(x0);
     gsl_matrix_free(xval);
     gsl_matrix_free(fval);
@@ -13,17 +13,20 @@ function blue(s) {
 }
 
 {
-	yidx = NF/6*5 + 1;
+	# a multi-fidelity run ends the lines with the fidelity
+	npool = int(NF/6);
+	yidx = npool*5 + 1;
+	yend = npool*6;
 	if (FNR % (BS+1) == 1) {
 		if (FNR == 1) {
 			print $0;
-			for (i = yidx; i <= NF; ++i)
+			for (i = yidx; i <= yend; ++i)
 				_[i-yidx] = $i;
 		} else {
 			cnt = 0;
-			for (i = yidx; i <= NF; ++i)
+			for (i = yidx; i <= yend; ++i)
 				cnt += $i <= _[i-yidx];
-			if (cnt == NF - yidx + 1)
+			if (cnt == yend - yidx + 1)
 				green($0);
 			else
 				red($0);
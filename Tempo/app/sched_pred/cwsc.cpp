@@ -31,10 +31,14 @@ const char *CONFIG_FILE = "./conf/cwsc.conf";
 Config        g_conf;
 int           g_nmaps;
 int           g_nreduces;
-int           g_metrics_win;
+double        g_metrics_interval = 1.0;
+double        g_util_interval = 0;
 string        g_metrics;
+string        g_trace;
+trace_options g_trace_opts;
 string        g_input;
 string        g_output;
+schedule_format g_output_format = SCHEDULE_TEXT;
 job_tracker * g_job_tracker = NULL;
 
 // Load simulator settings
@@ -43,7 +47,57 @@ void initialize_simulator()
 	g_input   = (const char *)g_conf.lookup("simulator.input");
 	g_output  = (const char *)g_conf.lookup("simulator.output");
 	g_metrics = (const char *)g_conf.lookup("simulator.metrics");
-	g_metrics_win = g_conf.lookup("simulator.metrics_win");
+	g_conf.lookupValue("simulator.metrics_interval", g_metrics_interval);
+	g_conf.lookupValue("simulator.utilization_interval", g_util_interval);
+
+	string fmt;
+	if (g_conf.lookupValue("simulator.output_format", fmt) && fmt != "text") {
+		if (fmt != "binary") {
+			ULIB_FATAL("unknown output format %s", fmt.c_str());
+			exit(EXIT_FAILURE);
+		}
+		g_output_format = SCHEDULE_BINARY;
+	}
+
+	if (g_conf.lookupValue("simulator.trace", g_trace)) {
+		string tfmt, pools;
+		int sample;
+		if (g_conf.lookupValue("simulator.trace_format", tfmt) && tfmt != "json") {
+			if (tfmt != "perfetto") {
+				ULIB_FATAL("unknown trace format %s", tfmt.c_str());
+				exit(EXIT_FAILURE);
+			}
+			g_trace_opts.format = TRACE_PERFETTO;
+		}
+		g_conf.lookupValue("simulator.trace_interval", g_trace_opts.interval);
+		if (g_conf.lookupValue("simulator.trace_sample", sample))
+			g_trace_opts.sample = sample > 1? sample: 1;
+		if (g_conf.lookupValue("simulator.trace_pools", pools))
+			g_trace_opts.pools = pools;
+		g_conf.lookupValue("simulator.trace_start", g_trace_opts.start);
+		g_conf.lookupValue("simulator.trace_end", g_trace_opts.end);
+	}
+
+	string sock;
+	if (g_conf.lookupValue("simulator.introspect", sock) &&
+	    introspect_open(sock.c_str()))
+		ULIB_WARNING("introspection is disabled");
+
+	string level, cats;
+	log_level lv = LOG_LEVEL_NOTICE;
+	unsigned mask = LOG_ALL;
+	if (g_conf.lookupValue("simulator.log_level", level) &&
+	    !log_parse_level(level.c_str(), &lv)) {
+		ULIB_FATAL("unknown log level %s", level.c_str());
+		exit(EXIT_FAILURE);
+	}
+	if (g_conf.lookupValue("simulator.log_categories", cats) &&
+	    !log_parse_categories(cats.c_str(), &mask)) {
+		ULIB_FATAL("unknown log categories %s", cats.c_str());
+		exit(EXIT_FAILURE);
+	}
+	if (level.size() || cats.size())
+		log_set_level(lv, mask);
 }
 
 // Load cluster settings and create a job tracker
@@ -53,130 +107,168 @@ void create_job_tracker()
 	g_nreduces = g_conf.lookup("cluster.total_reduces");
 	g_job_tracker = new job_tracker(g_nmaps, g_nreduces);
 	if (!g_job_tracker->set_metrics(
-		    g_metrics.size()? g_metrics.c_str(): NULL, g_metrics_win)) {
+		    g_metrics.size()? g_metrics.c_str(): NULL, g_metrics_interval)) {
 		ULIB_FATAL("failed to set metrics");
 		exit(EXIT_FAILURE);
 	}
+	g_job_tracker->keep_usage_series(g_util_interval > 0);
+	if (g_trace.size() && !g_job_tracker->set_trace(g_trace.c_str(), g_trace_opts)) {
+		ULIB_FATAL("failed to set the trace");
+		exit(EXIT_FAILURE);
+	}
 }
 
-void create_pools()
+// Add the pools of a pool list, recursing into nested "pools" lists
+// Returns the number of pools added
+int add_pools(const Setting &pools, pool *parent)
 {
-	const Setting &pools = g_conf.lookup("pools");
 	int npools = pools.getLength();
+	int nadded = 0;
 	for (int i = 0; i < npools; ++i) {
 		const Setting &pool = pools[i];
+		bool internal = pool.exists("pools");
 		string name;
-		string sched_mode;
-		double min_share_timeout;
-		double fair_share_timeout;
+		string sched_mode = "fair";
+		double min_share_timeout = -1;
+		double fair_share_timeout = -1;
 		double weight;
 		int   map_min_share;
 		int   reduce_min_share;
+		// scheduling mode and timeouts only matter to leaf pools
 		if (!(pool.lookupValue("name", name) &&
-		      pool.lookupValue("sched_mode", sched_mode) &&
-		      pool.lookupValue("min_share_timeout", min_share_timeout) &&
-		      pool.lookupValue("fair_share_timeout", fair_share_timeout) &&
+		      (pool.lookupValue("sched_mode", sched_mode) || internal) &&
+		      (pool.lookupValue("min_share_timeout", min_share_timeout) || internal) &&
+		      (pool.lookupValue("fair_share_timeout", fair_share_timeout) || internal) &&
 		      pool.lookupValue("weight", weight) &&
 		      pool.lookupValue("map_min_share", map_min_share) &&
 		      pool.lookupValue("reduce_min_share", reduce_min_share))) {
-			cerr << "Missing pool settings for pool " << i << endl;
+			cerr << "Missing pool settings for pool " << i;
+			if (parent)
+				cerr << " of " << parent->name;
+			cerr << endl;
 			exit(EXIT_FAILURE);
 		}
 		pool::sched_mode sched;
-		if (sched_mode == "fair")
-			sched = pool::SCHED_FAIR;
-		else if (sched_mode == "fcfs" || sched_mode == "fifo")
-			sched = pool::SCHED_FCFS;
-		else {
+		if (!selector::parse_sched_mode(sched_mode.c_str(), &sched)) {
 			ULIB_WARNING("invalid scheduling mode:%s for pool %s",
 				     sched_mode.c_str(), name.c_str());
 			exit(EXIT_FAILURE);
 		}
-		g_job_tracker->add_pool(name, min_share_timeout, fair_share_timeout,
-					weight, map_min_share, reduce_min_share, sched);
+		Tempo::pool &p =
+			g_job_tracker->add_pool(name, min_share_timeout, fair_share_timeout,
+						weight, map_min_share, reduce_min_share,
+						sched, parent);
+		++nadded;
+		if (internal)
+			nadded += add_pools(pool["pools"], &p);
 	}
+	return nadded;
+}
+
+void create_pools()
+{
+	int npools = add_pools(g_conf.lookup("pools"), NULL);
 	// Scale min shares if necessary
 	g_job_tracker->scale_minshares();
 	cerr << "Loaded settings for " << npools << " pools" << endl;
 }
 
+// Utilization of the observed task times
 void calc_utils()
 {
-	cout << "Map effective utilization:"
-	     <<	compute_utilization(g_job_tracker->getpools(),
-				    task::TASK_TYPE_MAP, g_nmaps)
-	     << endl;
+	utilization_report r;
+	if (analyze_utilization(g_job_tracker->getpools(), g_nmaps, g_nreduces,
+				&r, g_util_interval)) {
+		cerr << "Unable to analyze the observed utilization" << endl;
+		return;
+	}
 
+	cout << "Map effective utilization:"
+	     << r.cluster[task::TASK_TYPE_MAP] << endl;
 	cout << "Reduce effective utilization:"
-	     <<	compute_utilization(g_job_tracker->getpools(),
-				    task::TASK_TYPE_REDUCE, g_nreduces)
-	     << endl;
+	     << r.cluster[task::TASK_TYPE_REDUCE] << endl;
 
 	job_tracker::pool_container_type &pools = g_job_tracker->getpools();
+	size_t i = 0;
 	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
-	     pit != pools.end(); ++pit) {
+	     pit != pools.end(); ++pit, ++i) {
 		cout << ">> Pool " << pit->name << " map effective utilization:"
-		     << compute_utilization(*pit, task::TASK_TYPE_MAP, g_nmaps)
-		     << endl;
+		     << r.pools[task::TASK_TYPE_MAP][i] << endl;
 		cout << ">> Pool " << pit->name << " reduce effective utilization:"
-		     << compute_utilization(*pit, task::TASK_TYPE_REDUCE, g_nreduces)
-		     << endl;
+		     << r.pools[task::TASK_TYPE_REDUCE][i] << endl;
+	}
+
+	// the observed utilization of the cluster over time
+	for (size_t k = 0; k < r.curve[task::TASK_TYPE_MAP].size(); ++k) {
+		char from[32];
+		snprintf(from, sizeof(from), "%.3f", r.origin + k * r.window);
+		cout << ">> Observed utilization from " << from << " map:"
+		     << r.curve[task::TASK_TYPE_MAP][k] << " reduce:"
+		     << r.curve[task::TASK_TYPE_REDUCE][k] << endl;
 	}
 }
 
-// Writing output
-int export_comparison(const char *file,
-		      const engine::pool_container_type &old,
-		      const engine::pool_container_type &res)
+// Utilization of the predicted schedule, accumulated by the run
+void print_usage()
 {
-	FILE *fp = fopen(file, "w");
-	if (fp == NULL) {
-		ULIB_WARNING("cannot open %s for writing", file);
-		return -1;
-	}
+	const slot_usage &mu = g_job_tracker->usage(task::TASK_TYPE_MAP);
+	const slot_usage &ru = g_job_tracker->usage(task::TASK_TYPE_REDUCE);
 
-	for (engine::pool_container_type::const_iterator pit = old.begin(), pit1 = res.begin();
-	     pit != old.end(); ++pit, ++pit1) {
-		if (pit->name != pit1->name) {
-			cerr << "Pool names mismatch:" << pit->name << ", " << pit1->name << endl;
-			return -1;
-		}
-		for (pool::job_container_type::const_iterator jit = pit->jobs.begin(), jit1 = pit1->jobs.begin();
-		     jit != pit->jobs.end(); ++jit, ++jit1) {
-			if (jit->id != jit1->id) {
-				cerr << "Job ids mismatch:" << jit->id << ", " << jit1->id << endl;
-				return -1;
-			}
-			for (job::task_container_type::const_iterator tit = jit->tasks[task::TASK_TYPE_MAP].begin(),
-				     tit1 = jit1->tasks[task::TASK_TYPE_MAP].begin();
-			     tit != jit->tasks[task::TASK_TYPE_MAP].end(); ++tit, ++tit1) {
-				if (tit->id != tit1->id) {
-					cerr << "Task ids mismatch:" << tit->id << ", " << tit1->id << endl;
-					return -1;
-				}
-				// pool job:weight task type ctime type ctime ptime stime stime1 ftime ftime1
-				fprintf(fp, "%s\t%016lx:%lf\t%016lx\t%d\t%f\t%f\t%f\t%f\t%f\t%f\n",
-					pit->name.c_str(), jit->id, jit->fs_ctx_map.weight, tit->id, task::TASK_TYPE_MAP,
-					tit->ctime, tit->ptime, tit->stime, tit1->stime, tit->ftime, tit1->ftime);
-			}
-			for (job::task_container_type::const_iterator tit = jit->tasks[task::TASK_TYPE_REDUCE].begin(),
-				     tit1 = jit1->tasks[task::TASK_TYPE_REDUCE].begin();
-			     tit != jit->tasks[task::TASK_TYPE_REDUCE].end(); ++tit, ++tit1) {
-				if (tit->id != tit1->id) {
-					cerr << "Task ids mismatch:" << tit->id << ", " << tit1->id << endl;
-					return -1;
-				}
-				// pool job:weight task type ctime ptime stime stime1 ftime ftime1
-				fprintf(fp, "%s\t%016lx:%lf\t%016lx\t%d\t%f\t%f\t%f\t%f\t%f\t%f\n",
-					pit->name.c_str(), jit->id, jit->fs_ctx_reduce.weight, tit->id, task::TASK_TYPE_REDUCE,
-					tit->ctime, tit->ptime, tit->stime, tit1->stime, tit->ftime, tit1->ftime);
-			}
-		}
+	cout << "Map effective utilization:" << mu.utilization(g_nmaps) << endl;
+	cout << "Reduce effective utilization:" << ru.utilization(g_nreduces) << endl;
+
+	job_tracker::pool_container_type &pools = g_job_tracker->getpools();
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		cout << ">> Pool " << pit->name << " map effective utilization:"
+		     << pit->map_usage.utilization(g_nmaps) << endl;
+		cout << ">> Pool " << pit->name << " reduce effective utilization:"
+		     << pit->reduce_usage.utilization(g_nreduces) << endl;
+		cout << ">> Pool " << pit->name << " slot time preempted map:"
+		     << pit->map_usage.preempted() << " reduce:"
+		     << pit->reduce_usage.preempted() << endl;
 	}
 
-	fclose(fp);
+	if (!(g_util_interval > 0) || mu.series().empty())
+		return;
+	// the utilization of the cluster over time
+	double start = mu.series().front().time;
+	if (ru.series().size())
+		start = min(start, ru.series().front().time);
+	double end = mu.series().back().time;
+	if (ru.series().size())
+		end = max(end, ru.series().back().time);
+	for (double t = start; t < end; t += g_util_interval) {
+		char from[32];
+		snprintf(from, sizeof(from), "%.3f", t);
+		cout << ">> Utilization from " << from << " map:"
+		     << mu.utilization_between(t, t + g_util_interval, g_nmaps)
+		     << " reduce:"
+		     << ru.utilization_between(t, t + g_util_interval, g_nreduces)
+		     << endl;
+	}
+}
 
-	return 0;
+// Response time and slowdown quantiles of the jobs in each pool
+void print_latencies()
+{
+	job_tracker::pool_container_type &pools = g_job_tracker->getpools();
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		const histogram &r = pit->response_times;
+		const histogram &s = pit->slowdowns;
+		cout << ">> Pool " << pit->name << " jobs:" << r.count()
+		     << " response time mean:" << r.mean()
+		     << " p50:" << r.quantile(0.5)
+		     << " p95:" << r.quantile(0.95)
+		     << " p99:" << r.quantile(0.99)
+		     << " max:" << r.max() << endl;
+		cout << ">> Pool " << pit->name << " slowdown mean:" << s.mean()
+		     << " p50:" << s.quantile(0.5)
+		     << " p95:" << s.quantile(0.95)
+		     << " p99:" << s.quantile(0.99)
+		     << " max:" << s.max() << endl;
+	}
 }
 
 int main()
@@ -206,17 +298,19 @@ int main()
 		exit(EXIT_FAILURE);
 	}
 
-	cerr << "Loaded workload, backing up ..." << endl;
-	job_tracker::pool_container_type old = g_job_tracker->getpools();
+	cerr << "Loaded workload" << endl;
+	g_job_tracker->keep_observed();
 
 	calc_utils();
 	cerr << "Processing workload ..." << endl;
 
 	g_job_tracker->process();
 
-	calc_utils();
+	print_usage();
+	print_latencies();
 
-	if (!export_comparison(g_output.c_str(), old, g_job_tracker->getpools()))
+	if (!export_comparison(g_output.c_str(), g_job_tracker->getpools(),
+			       g_output_format))
 		cerr << "Saved comparison to " << g_output << endl;
 
 	delete g_job_tracker;
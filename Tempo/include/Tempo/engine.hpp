@@ -26,6 +26,8 @@
 #include "pool.hpp"
 #include "event.hpp"
 #include "selector.hpp"
+#include "metrics_file.hpp"
+#include "trace_writer.hpp"
 
 namespace Tempo
 {
@@ -86,6 +88,80 @@ struct reduce_fs_itr {
 	}
 };
 
+template<typename T>
+struct map_fs_ptr_itr {
+	typename T::iterator itr;
+
+	map_fs_ptr_itr(const typename T::iterator &it) : itr(it) { }
+
+	map_fs_ptr_itr &operator++()
+	{
+		++itr;
+		return *this;
+	}
+
+	bool operator==(const map_fs_ptr_itr &other) const
+	{
+		return itr == other.itr;
+	}
+
+	bool operator!=(const map_fs_ptr_itr &other) const
+	{
+		return itr != other.itr;
+	}
+
+	operator fs_context *()
+	{
+		return &(*itr)->fs_ctx_map;
+	}
+};
+
+template<typename T>
+struct reduce_fs_ptr_itr {
+	typename T::iterator itr;
+
+	reduce_fs_ptr_itr(const typename T::iterator &it) : itr(it) { }
+
+	reduce_fs_ptr_itr &operator++()
+	{
+		++itr;
+		return *this;
+	}
+
+	bool operator==(const reduce_fs_ptr_itr &other) const
+	{
+		return itr == other.itr;
+	}
+
+	bool operator!=(const reduce_fs_ptr_itr &other) const
+	{
+		return itr != other.itr;
+	}
+
+	operator fs_context *()
+	{
+		return &(*itr)->fs_ctx_reduce;
+	}
+};
+
+// Bound on a run, notified as jobs complete
+// process() stops once the bound returns true, e.g. when an objective
+// computed from the completed jobs is decided. The engine is then left
+// ready for another run, and jobs that did not complete keep the
+// times of an earlier run.
+class run_bound {
+public:
+	virtual ~run_bound() { }
+
+	// A run is starting, job::nleft holds the number of tasks each
+	// job of @pools runs, jobs with none do not complete
+	virtual void start(const std::list<pool> &pools) { (void)pools; }
+
+	// Job @j of the leaf pool @p has completed at @now
+	// Returns true to stop the run.
+	virtual bool job_done(const pool &p, const job &j, double now) = 0;
+};
+
 class engine
 {
 public:
@@ -97,6 +173,7 @@ public:
         typedef hlist<stime_hash>    taskset_type;
         typedef std::vector<event *> eventheap_type;
 	typedef std::list<pool>      pool_container_type;
+	typedef std::vector<pool *>  pool_group_type;
 	typedef vsem<event *>        vsem_type;
 
         engine(int nmaps,        // number of map slots in the cluster
@@ -105,24 +182,61 @@ public:
 
         ~engine();
 
-	// Set the output metric file and metric sampling window size
-	bool set_metrics(const char * met, int met_win);
+	// Set the output metric file and the simulated time between samples
+	bool set_metrics(const char * met, double met_interval);
+
+	// Keep the slot usage series of the pools in later runs, for
+	// the utilization of any window
+	void keep_usage_series(bool keep) { _usage_series = keep; }
+
+	// Show the progress of later runs on stderr, on by default; off
+	// for all but one of the engines running at once
+	void report_progress(bool on) { _progress = on; }
+
+	// Publish the state of later runs for introspection, on by
+	// default; engines share one snapshot, so at most one of the
+	// engines running at once should publish
+	void report_state(bool on) { _state = on; }
 
-	// Add a pool to the engine
+	// Set the output timeline trace file, see trace_writer.hpp
+	bool set_trace(const char *file, const trace_options &opts);
+
+	// Set the bound of later runs, NULL to run all jobs
+	void set_bound(run_bound *b) { _bound = b; }
+
+	// Whether the bound stopped the last run
+	bool stopped() const { return _stopped; }
+
+	// Add a pool to the engine, as a child of @parent if given
+	// Jobs should only be added to leaf pools
 	pool &add_pool(const std::string &ns, double mto, double fto,
 		       double weight, int minmap, int minred,
-		       pool::sched_mode sched);
+		       pool::sched_mode sched, pool *parent = NULL);
 
 	// Scale map and reduce min shares
 	// Required if pool min shares exceed the maximum number of slots
+	// Min shares of child pools are scaled to fit in the min share
+	// of their parent.
 	void scale_minshares();
 
-	// Start processing jobs in the pools
-        void process();
+	// Set the number of slots of later runs, e.g. to simulate a
+	// sample of the workload on a cluster scaled to match
+	void set_slots(int nmaps, int nreduces);
+
+	// Start processing jobs in the pools, or only the tasks in @view
+	// if given; tasks outside the view are left as they are
+        void process(const workload_view *view = NULL);
 
+	// All pools, including the non-leaf ones, in the order added
 	const pool_container_type &getpools() const { return _pools; }
 	pool_container_type &getpools() { return _pools; }
 
+	// Top-level pools
+	const pool_group_type &getroots() const { return _roots; }
+
+	// Slot usage of the cluster in the last run
+	const slot_usage &usage(task::task_type type) const { return _usage[type]; }
+
 	// Event APIs
 	void add_event(event *ev);
 	void run_map(td_ref *t);
@@ -133,6 +247,7 @@ public:
         void preempt_reduces(int num);
 	void update_map_fairshares();
 	void update_reduce_fairshares();
+	void finish_job(pool *p, job *j);
 
 	double        time_now;
         vsem_type    *sem_map;
@@ -143,15 +258,32 @@ public:
 
 private:
         void   submit_tasks();
+	void   track_jobs(const workload_view *view);
 	double map_progress() const;
 	double reduce_progress() const;
+	void   publish_state(size_t nev);
+	void   start_usage(td_ref *t, task::task_type type);
+	void   stop_usage(td_ref *t, task::task_type type, bool preempted);
+	void   discard_run();
+
+	// Divide the share of a parent among the pools of the group, and
+	// recursively among the children whose inputs have changed
+	static void update_map_fairshares(pool_group_type &group, double total);
+	static void update_reduce_fairshares(pool_group_type &group, double total);
 
         pool_container_type _pools;
+	pool_group_type _roots;
         eventheap_type _eventheap;
         int _nmap;
         int _nreduce;
-	int _met_win;
-	FILE * _fp_met;
+	metrics_recorder _met;
+	trace_writer _trace;
+	slot_usage _usage[task::TASK_TYPE_NUM];
+	bool _usage_series;
+	bool _progress;
+	bool _state;
+	run_bound *_bound;
+	bool _stopped;
 };
 
 }
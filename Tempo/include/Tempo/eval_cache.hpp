@@ -0,0 +1,80 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_EVAL_CACHE_H
+#define _COLOSSAL_EVAL_CACHE_H
+
+#include <cstdio>
+#include <vector>
+#include <stdint.h>
+#include <gsl/gsl_vector.h>
+#include <ulib/hash_open.h>
+
+namespace Tempo {
+
+// Objective values of the evaluated decision vectors
+// Results are keyed by the exact decision vector, so they are only
+// reused for points projected to the same configuration. An optional
+// file keeps the results across runs, valid for a context, e.g. a hash
+// of the workload and settings the results depend on. The cache is not
+// thread-safe.
+class eval_cache
+{
+public:
+	eval_cache();
+	~eval_cache();
+
+	// Load the results kept in @file for @context, and append new
+	// results to it. A file of another context is started over.
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file, uint64_t context);
+	void close();
+
+	// Returns true and sets @y if @x has been evaluated
+	bool lookup(const gsl_vector *x, gsl_vector *y);
+	// Add the objective values @y of @x, and append them to the file
+	void insert(const gsl_vector *x, const gsl_vector *y);
+
+	size_t size() const { return _entries.size(); }
+	size_t hits() const { return _hits; }
+	size_t misses() const { return _misses; }
+	double hit_rate() const
+	{
+		return _hits + _misses? (double)_hits / (_hits + _misses): 0;
+	}
+
+private:
+	eval_cache(const eval_cache &);
+	eval_cache &operator=(const eval_cache &);
+
+	struct entry {
+		std::vector<double> x;
+		std::vector<double> y;
+	};
+
+	static uint64_t key_of(const std::vector<double> &x);
+	static void copy(const gsl_vector *v, std::vector<double> *out);
+	void add(const entry &e);
+	void append(const entry &e);
+
+	std::vector<entry> _entries;
+	ulib::open_hash_map<uint64_t, size_t> _index;  // key to entry
+	FILE  *_fp;
+	size_t _hits;
+	size_t _misses;
+};
+
+}
+
+#endif
@@ -0,0 +1,81 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_FOLLOWER_H
+#define _COLOSSAL_FOLLOWER_H
+
+#include <string>
+#include <vector>
+#include <sys/types.h>
+#include "importer.hpp"
+#include "job_tracker.hpp"
+
+namespace Tempo {
+
+// Follows a growing text workload and imports the lines appended to it
+//
+// The followed path is either a file or a directory of rotated files,
+// read in name order. Files are read from their start, and an
+// incomplete last line is held back until its newline arrives. A file
+// is finished once a later file appears in the directory, or once the
+// file name refers to a new file, e.g. when the file has been rotated
+// away and recreated. Changes are waited for with inotify, with a
+// fallback to polling. Gzip-compressed files cannot be followed.
+class workload_follower
+{
+public:
+	workload_follower(workload_format fmt, job_tracker::pool_container_type *pools);
+	~workload_follower();
+
+	// Start following @path
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *path);
+	void close();
+
+	// Import the lines appended since the last call, waiting up to
+	// @timeout_ms milliseconds for some to arrive, < 0 for no limit
+	// Returns the number of imported tasks, 0 on timeout, -1 on error.
+	long poll(int timeout_ms);
+
+	// path of the file being read, empty if none
+	const std::string &current() const { return _file; }
+
+	// bytes of an incomplete last line held back
+	size_t pending() const { return _partial.size(); }
+
+private:
+	workload_follower(const workload_follower &);
+	workload_follower &operator=(const workload_follower &);
+
+	long update();
+	long read_appended();
+	long finish_file();
+	bool open_next();
+	bool next_file(std::string *file) const;
+	void wait(int timeout_ms);
+
+	workload_appender _app;
+	std::string _path;        // followed file or directory
+	bool        _dir;
+	std::string _file;        // file being read
+	int         _fd;          // -1 if no file is being read
+	ino_t       _fino;        // inode of _fd
+	off_t       _off;         // bytes of _file read so far
+	std::vector<char> _partial;  // incomplete last line
+	int         _ifd;         // inotify descriptor, -1 to poll
+};
+
+}
+
+#endif
@@ -82,7 +82,7 @@ static inline double compute_fairshare(const fs_conf &conf, double r)
 // T is an iterator of a class that inherits fs_conf
 // total: the total number of slots of certain type (map/reduce)
 template<typename T>
-static void scale_minshares(T begin, T end, int total)
+static void scale_minshares(T begin, T end, double total)
 {
         double sum = 0;
         for (T it = begin; it != end; ++it)
@@ -100,7 +100,7 @@ static void scale_minshares(T begin, T end, int total)
 // Returns the fair share ratio
 // Note: must first scale the min shares
 template<typename T>
-static double compute_fairshares(T begin, T end, int total)
+static double compute_fairshares(T begin, T end, double total)
 {
         double ru = 1.0;
 
@@ -145,7 +145,7 @@ static double compute_fairshares(T begin, T end, int total)
 // Returns the fair share ratio
 // Note: must first scale the min shares
 template<typename T>
-static double compute_ratio(T begin, T end, int total)
+static double compute_ratio(T begin, T end, double total)
 {
         double ru = 1.0;
 
@@ -264,6 +264,122 @@ private:
         ulib::open_hash_set<hash_pointer<T>, except> _users;
 };
 
+// Indexed heap of users ordered by the fair share comparator, with
+// the neediest user on top. Unlike fs_select, which is rebuilt for
+// every selection, users stay in the heap until erased, and a user
+// whose allocation or demand has changed is repositioned with
+// update() in O(log n). Allocations are left to the caller.
+// T must be comparable and hashable through hash_pointer<T>.
+template<typename T>
+class fs_heap
+{
+public:
+	typedef ulib::open_hash_map<hash_pointer<T>, size_t, except> index_type;
+
+	bool contain(T it) const
+	{
+		return _pos.contain(it);
+	}
+
+	// Returns false if the user is already in the heap
+	bool push(T it)
+	{
+		if (_pos.contain(it))
+			return false;
+		_heap.push_back(it);
+		_pos[it] = _heap.size() - 1;
+		sift_up(_heap.size() - 1);
+		return true;
+	}
+
+	// Returns false if the user is not in the heap
+	bool update(T it)
+	{
+		typename index_type::iterator pit = _pos.find(it);
+		if (pit == _pos.end())
+			return false;
+		size_t i = pit.value();
+		sift_up(i);
+		sift_down(i);
+		return true;
+	}
+
+	// Returns false if the user is not in the heap
+	bool erase(T it)
+	{
+		typename index_type::iterator pit = _pos.find(it);
+		if (pit == _pos.end())
+			return false;
+		size_t i = pit.value();
+		_pos.erase(pit);
+		T last = _heap.back();
+		_heap.pop_back();
+		if (i < _heap.size()) {
+			_heap[i] = last;
+			_pos[last] = i;
+			sift_up(i);
+			sift_down(i);
+		}
+		return true;
+	}
+
+	// The heap must be non-empty
+	T top() const
+	{
+		return _heap.front();
+	}
+
+	size_t size() const
+	{
+		return _heap.size();
+	}
+
+private:
+	static bool less(T a, T b)
+	{
+		return comp_pointer<T>(a) < comp_pointer<T>(b);
+	}
+
+	void place(size_t i, T it)
+	{
+		_heap[i] = it;
+		_pos[it] = i;
+	}
+
+	void sift_up(size_t i)
+	{
+		T it = _heap[i];
+		while (i > 0) {
+			size_t parent = (i - 1) / 2;
+			if (!less(it, _heap[parent]))
+				break;
+			place(i, _heap[parent]);
+			i = parent;
+		}
+		place(i, it);
+	}
+
+	void sift_down(size_t i)
+	{
+		T it = _heap[i];
+		for (;;) {
+			size_t child = 2 * i + 1;
+			if (child >= _heap.size())
+				break;
+			if (child + 1 < _heap.size() && less(_heap[child + 1], _heap[child]))
+				++child;
+			if (!less(_heap[child], it))
+				break;
+			place(i, _heap[child]);
+			i = child;
+		}
+		place(i, it);
+	}
+
+	std::vector<T> _heap;
+	index_type     _pos;
+};
+
 }
 
 #endif
@@ -0,0 +1,65 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_HISTOGRAM_H
+#define _COLOSSAL_HISTOGRAM_H
+
+#include <cstddef>
+#include <stdint.h>
+
+namespace Tempo {
+
+// Log-bucketed histogram of non-negative values
+// Each power of two between 2^HIST_MIN_EXP and 2^HIST_MAX_EXP is split
+// into HIST_SUB_BUCKETS buckets, so quantiles are within about 1.5% of
+// the exact ones. Smaller values share the first bucket, and larger
+// ones the last. Memory use is fixed.
+class histogram
+{
+public:
+	enum {
+		HIST_MIN_EXP     = -10,
+		HIST_MAX_EXP     = 40,
+		HIST_SUB_BUCKETS = 32,
+		HIST_NBUCKETS    = (HIST_MAX_EXP - HIST_MIN_EXP) * HIST_SUB_BUCKETS
+	};
+
+	histogram() { clear(); }
+
+	void clear();
+	void add(double v);
+	void merge(const histogram &other);
+
+	uint64_t count() const { return _count; }
+	double   sum() const { return _sum; }
+	double   mean() const { return _count? _sum / _count: 0; }
+	double   min() const { return _min; }  // 0 if empty
+	double   max() const { return _max; }  // 0 if empty
+
+	// Value at quantile @q in [0, 1], 0 if empty
+	double quantile(double q) const;
+
+private:
+	static size_t bucket_of(double v);
+
+	uint64_t _count;
+	double   _sum;
+	double   _min;
+	double   _max;
+	uint64_t _buckets[HIST_NBUCKETS];
+};
+
+}
+
+#endif
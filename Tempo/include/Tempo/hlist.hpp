@@ -17,6 +17,7 @@
 
 #include <ulib/hash_chain_prot.h>
 #include "common.hpp"
+#include "profile.hpp"
 
 namespace Tempo
 {
@@ -181,6 +182,7 @@ public:
         virtual
         ~hlist()
         {
+                note_free_all();
                 chainhash_destroy(inclass, _hashing);
         }
 
@@ -221,6 +223,12 @@ public:
         iterator
         insert(const _Key &key)
         {
+#ifdef TEMPO_PROFILE_ALLOC
+                // ulib allocates a node with malloc() per new key, the
+                // library and its users agree on the flag, see profile.hpp
+                if (!contain(key))
+                        PROFILE_ALLOC_NOTE(ALLOC_HLIST, sizeof(_Key) + sizeof(void *));
+#endif
                 hashing_iterator itr = chainhash_set(inclass, _hashing, key);
                 if (itr.entry == NULL)
                         throw _Except();
@@ -248,18 +256,23 @@ public:
         void
         erase(const _Key &key)
         {
-                chainhash_del(inclass, chainhash_get(inclass, _hashing, key));
+                erase(find(key));
         }
 
         void
         erase(const iterator &it)
         {
+#ifdef TEMPO_PROFILE_ALLOC
+                if (it._cur.entry)
+                        PROFILE_FREE_NOTE(ALLOC_HLIST, sizeof(_Key) + sizeof(void *));
+#endif
                 chainhash_del(inclass, it._cur);
         }
 
         void
         clear()
         {
+                note_free_all();
                 chainhash_clear(inclass, _hashing);
         }
 
@@ -291,6 +304,15 @@ public:
         }
 
 private:
+        void
+        note_free_all()
+        {
+#ifdef TEMPO_PROFILE_ALLOC
+                for (iterator it = begin(); it != end(); ++it)
+                        PROFILE_FREE_NOTE(ALLOC_HLIST, sizeof(_Key) + sizeof(void *));
+#endif
+        }
+
         hashing _hashing;
 };
 
@@ -31,16 +31,35 @@ public:
 
 	virtual ~job_tracker();
 
-	// Set the output metric file and sampling window size
-	bool set_metrics(const char * met, int met_win);
+	// Set the output metric file and the simulated time between samples
+	// The file is a binary stream, see metrics_file.hpp.
+	bool set_metrics(const char * met, double met_interval);
 
-	// Add a pool to the engine
+	// Set the output timeline trace file and what to trace
+	// The file is loadable by chrome://tracing or Perfetto, see
+	// trace_writer.hpp.
+	bool set_trace(const char *file, const trace_options &opts = trace_options());
+
+	// Set the bound of later runs, NULL to run all jobs, see
+	// run_bound in engine.hpp
+	void set_bound(run_bound *b);
+
+	// Whether the bound stopped the last run
+	bool stopped() const;
+
+	// Add a pool to the engine, as a child of @parent if given
 	pool &add_pool(const std::string &ns, double mto, double fto,
 		       double weight, int minmap, int minred,
-		       pool::sched_mode sched);
+		       pool::sched_mode sched, pool *parent = NULL);
 
-	// Start processing all jobs
-	void process();
+	// Save the observed start and finish times of the imported tasks
+	// in the observed columns of the pools, process() overwrites the
+	// task times with the predicted ones
+	void keep_observed();
+
+	// Start processing all jobs, or only the tasks in @view if given,
+	// e.g. a time window taken from a workload_index
+	void process(const workload_view *view = NULL);
 
 	// Reset the job tracker time
 	// Used to reinitialize the job tracker
@@ -50,6 +69,22 @@ public:
 	// Required if min shares exceed the total number of slots
 	void scale_minshares();
 
+	// Set the number of map and reduce slots of later runs
+	void set_slots(int nmaps, int nreduces);
+
+	// Slot usage of the cluster in the last run, see pool::map_usage
+	// and pool::reduce_usage for the pools
+	const slot_usage &usage(task::task_type type) const;
+
+	// Keep the slot usage series in later runs, see slot_usage
+	void keep_usage_series(bool keep);
+
+	// Show the progress of later runs on stderr, see engine
+	void report_progress(bool on);
+
+	// Publish the state of later runs for introspection, see engine
+	void report_state(bool on);
+
 	size_t running_maps() const;
 	size_t running_reduces() const;
 
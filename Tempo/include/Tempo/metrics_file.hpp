@@ -0,0 +1,158 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_METRICS_FILE_H
+#define _COLOSSAL_METRICS_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include "pool.hpp"
+
+namespace Tempo {
+
+// Binary metrics stream
+//
+// The file starts with a mt_header, followed by a string table of the
+// NUL-terminated pool names, the 8-byte aligned pool directory and
+// the records until the end of the file. Each sample adds one
+// mt_record per pool, in the order of the directory. Integers and
+// doubles are stored in host byte order.
+
+#define METRICS_MAGIC   "TEMPOMT"
+#define METRICS_VERSION 1
+
+struct mt_header {
+	char     magic[8];     // METRICS_MAGIC
+	uint32_t version;      // METRICS_VERSION
+	uint32_t reserved;
+	double   interval;     // simulated time between samples
+	uint64_t npools;
+	uint64_t strtab_off;   // section offsets from the file start
+	uint64_t strtab_size;
+	uint64_t pools_off;    // one string table offset per pool
+	uint64_t records_off;
+};
+
+// Fair scheduling state of a pool for one task type
+struct mt_share {
+	int32_t demand;
+	int32_t running;
+	double  fairshare;
+	double  minshare;
+	double  weight;
+	double  last_at_ms;    // last time seen below min share
+	double  last_at_hf;    // last time seen below half fair share
+};
+
+struct mt_record {
+	double   time;
+	uint32_t pool;         // index into the pool directory
+	uint32_t reserved;
+	mt_share map;
+	mt_share reduce;
+};
+
+// Writes samples of the pool states at a fixed simulated-time interval
+// Records are buffered and written in large blocks.
+class metrics_recorder
+{
+public:
+	metrics_recorder();
+	~metrics_recorder();
+
+	// Create @file, sampling every @interval of simulated time
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file, double interval);
+	void close();
+
+	bool is_open() const { return _fp != NULL; }
+
+	// Start sampling @pools from @now on, writing the pool directory
+	// on the first call. Pools must not change between calls.
+	// Returns 0 on success, -1 with the recorder closed otherwise.
+	int start(const std::list<pool> &pools, double now);
+
+	// Returns true if the states as of the next sample time are
+	// final once the events before @next_event are processed
+	bool due(double next_event) const { return next_event > _next; }
+
+	// Record the states at the due sample time, then skip to the
+	// first sample time not before @next_event; intervals without
+	// events are not repeated
+	void sample(const std::list<pool> &pools, double next_event);
+
+	// Record the states at @now regardless of the interval
+	void record(const std::list<pool> &pools, double now);
+
+	// Write out the buffered records
+	// Returns 0 on success, -1 otherwise.
+	int flush();
+
+private:
+	metrics_recorder(const metrics_recorder &);
+	metrics_recorder &operator=(const metrics_recorder &);
+
+	FILE  *_fp;
+	double _interval;
+	double _origin;    // first sample time of the run
+	double _next;      // next sample time
+	bool   _started;
+	std::vector<mt_record> _buf;
+};
+
+// Read-only view of a memory-mapped metrics stream
+// A partially written trailing record is ignored.
+class metrics_file
+{
+public:
+	metrics_file();
+	~metrics_file();
+
+	// Map and validate a metrics stream
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file);
+	void close();
+
+	size_t pool_count() const { return _hdr? _hdr->npools: 0; }
+	size_t record_count() const { return _nrecords; }
+	double interval() const { return _hdr? _hdr->interval: 0; }
+
+	const char      *pool_name(size_t i) const { return _strtab + _pools[i]; }
+	const mt_record &record_at(size_t i) const { return _records[i]; }
+
+	// Print the records in the format:
+	// TIME"\t"POOL"\t"TYPE"\t"METRIC"\t"VALUE
+	// with TYPE being map or reduce
+	// Returns 0 on success, -1 otherwise.
+	int write_text(FILE *fp) const;
+
+private:
+	metrics_file(const metrics_file &);
+	metrics_file &operator=(const metrics_file &);
+
+	const char      *_data;
+	size_t           _size;
+	const mt_header *_hdr;
+	const char      *_strtab;
+	const uint64_t  *_pools;
+	const mt_record *_records;
+	size_t           _nrecords;
+};
+
+}
+
+#endif
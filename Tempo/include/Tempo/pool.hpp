@@ -20,7 +20,9 @@
 #include <string>
 #include "job.hpp"
 #include "fsched.hpp"
-#include "metric.hpp"
+#include "histogram.hpp"
+#include "slot_usage.hpp"
+#include "strtab.hpp"
 
 namespace Tempo
 {
@@ -33,7 +35,8 @@ struct pool
 
 	enum sched_mode {
 		SCHED_FAIR,
-		SCHED_FCFS
+		SCHED_FCFS,
+		SCHED_NMODES  // number of modes, not a mode
 	};
 
         uint64_t id;        // integer unique id, typically a one-to-one mapping to name
@@ -48,6 +51,23 @@ struct pool
         fs_context fs_ctx_map;    // fair scheduling context
         fs_context fs_ctx_reduce; // fair scheduling context
         job_container_type jobs;    // all jobs records in the pool
+	string_table names;         // names of the jobs and tasks
+	pool *parent;                  // enclosing pool, NULL for a top-level pool
+	std::vector<pool *> children;  // child pools, jobs only go to leaf pools
+	double map_children_total;     // map share last divided among children, < 0 if stale
+	double reduce_children_total;  // reduce share last divided among children, < 0 if stale
+	// observed start and finish times saved by job_tracker::keep_observed(),
+	// one per task in the order of jobs, maps before reduces
+	std::vector<double> observed_stimes;
+	std::vector<double> observed_ftimes;
+	// response times and slowdowns of the jobs completed in the current
+	// run, including the jobs of child pools
+	histogram response_times;
+	histogram slowdowns;
+	// slot usage of the tasks run in the current run, including the
+	// tasks of child pools
+	slot_usage map_usage;
+	slot_usage reduce_usage;
 
         // timeout < 0 disables preemption
         pool(const std::string &ns, double mto, double fto,
@@ -58,9 +78,22 @@ struct pool
 		    double weight, int minmap, int minred, sched_mode sched);
 
 	static uint64_t id_from_str(const char *str);
+	static uint64_t id_from_str(const char *str, size_t len);
 
 	job &add_job(const job &j);
 
+	// name of a job or a task of the pool, NULL if unnamed
+	const char *name_of(const job &j) const { return j.name? names.str(j.name): NULL; }
+	const char *name_of(const task &t) const { return t.name? names.str(t.name): NULL; }
+
+	bool is_leaf() const { return children.empty(); }
+
+	// number of ancestors, 0 for a top-level pool
+	int depth() const;
+
+	// attach the pool as a child of @p
+	void set_parent(pool *p);
+
 	// returns the number of needed slots if starved for minimum share, 0 otherwise
 	int starved_for_map_minshare(double now) const;
 	int starved_for_reduce_minshare(double now) const;
@@ -77,7 +110,6 @@ struct pool
         void reduce_transit_s2n();
 
 	std::string to_str() const;
-	void print_metrics(metric met) const;
 };
 
 }
@@ -0,0 +1,128 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_SCHEDULE_FILE_H
+#define _COLOSSAL_SCHEDULE_FILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+#include "pool.hpp"
+#include "job_tracker.hpp"
+
+namespace Tempo {
+
+// Schedule output formats
+enum schedule_format {
+	SCHEDULE_TEXT,   // one tab-separated line per task
+	SCHEDULE_BINARY  // fixed-size records, see sc_header
+};
+
+// Binary schedule format
+//
+// The file starts with a sc_header, followed by a string table of
+// NUL-terminated names and the 8-byte aligned rows, one sc_row per
+// task in the order of the text output. Integers and doubles are
+// stored in host byte order.
+
+#define SCHEDULE_MAGIC   "TEMPOSC"
+#define SCHEDULE_VERSION 1
+
+struct sc_header {
+	char     magic[8];     // SCHEDULE_MAGIC
+	uint32_t version;      // SCHEDULE_VERSION
+	uint32_t flags;        // SC_FLAG_*
+	uint64_t nrows;
+	uint64_t strtab_off;   // section offsets from the file start
+	uint64_t strtab_size;
+	uint64_t rows_off;
+
+	enum {
+		SC_FLAG_PREDICTED = 1  // stime1 and ftime1 are set
+	};
+};
+
+struct sc_row {
+	uint64_t pool;     // string table offsets
+	uint64_t job;      // 0 if the job has no name
+	uint64_t task;     // 0 if the task has no name
+	uint64_t job_id;
+	uint64_t task_id;
+	double   weight;
+	double   ctime;
+	double   ptime;
+	double   stime;
+	double   ftime;
+	double   stime1;   // predicted times, -1 without SC_FLAG_PREDICTED
+	double   ftime1;
+	uint32_t type;
+	uint32_t reserved;
+};
+
+// Read-only view of a memory-mapped binary schedule
+class schedule_file
+{
+public:
+	schedule_file();
+	~schedule_file();
+
+	// Map and validate a binary schedule
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file);
+	void close();
+
+	// Returns true if @file starts with the binary schedule magic
+	static bool is_binary(const char *file);
+
+	size_t row_count() const { return _hdr? _hdr->nrows: 0; }
+	bool   has_prediction() const { return _hdr && (_hdr->flags & sc_header::SC_FLAG_PREDICTED); }
+
+	const sc_row &row_at(size_t i) const { return _rows[i]; }
+	const char   *str(uint64_t off) const { return _strtab + off; }
+
+	// Print the rows the way the text output does
+	// Returns 0 on success, -1 otherwise.
+	int write_text(FILE *fp) const;
+
+private:
+	schedule_file(const schedule_file &);
+	schedule_file &operator=(const schedule_file &);
+
+	const char      *_data;
+	size_t           _size;
+	const sc_header *_hdr;
+	const char      *_strtab;
+	const sc_row    *_rows;
+};
+
+// Export the schedule, jobs and tasks are printed by name if they have one
+// Each text line is in the format:
+// POOL"\t"JOB:WEIGHT"\t"TASK"\t"TYPE"\t"CTIME"\t"PTIME"\t"STIME"\t"FTIME
+// Numbers are printed with the fewest digits that read back exactly.
+// nthreads: number of formatting threads, <= 0 to use all online CPUs
+// Returns 0 on success, -1 otherwise.
+int export_schedule(const char *file, const job_tracker::pool_container_type &pools,
+		    schedule_format fmt = SCHEDULE_TEXT, int nthreads = 0);
+
+// Export the observed times kept by job_tracker::keep_observed() along
+// with the predicted task times, in the format:
+// POOL"\t"JOB:WEIGHT"\t"TASK"\t"TYPE"\t"CTIME"\t"PTIME"\t"STIME"\t"STIME1"\t"FTIME"\t"FTIME1
+// where STIME1 and FTIME1 are the predicted times
+// Returns 0 on success, -1 otherwise.
+int export_comparison(const char *file, const job_tracker::pool_container_type &pools,
+		      schedule_format fmt = SCHEDULE_TEXT, int nthreads = 0);
+
+}
+
+#endif
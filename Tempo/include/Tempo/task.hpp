@@ -15,6 +15,7 @@
 #ifndef _COLOSSAL_TASK_H
 #define _COLOSSAL_TASK_H
 
+#include <cstddef>
 #include <stdint.h>
 #include <string>
 
@@ -38,7 +39,10 @@ struct task
 		TASK_FLAG_PREEMPTED = 2
 	};
 
+	task() : name(0) { }
+
 	static uint64_t id_from_str(const char *str);
+	static uint64_t id_from_str(const char *str, size_t len);
 
         std::string to_str() const;
 
@@ -48,6 +52,7 @@ struct task
         double stime;  // start time
         double ftime;  // finish time
         task_type type;
+	size_t name;   // offset in the names of the pool, 0 if unnamed
 };
 
 // Reference-counted task description class
@@ -16,11 +16,24 @@
 #define _COLOSSAL_H
 
 #include "common.hpp"
+#include "log.hpp"
+#include "strtab.hpp"
+#include "slot_usage.hpp"
 #include "task.hpp"
 #include "job.hpp"
 #include "pool.hpp"
 #include "job_tracker.hpp"
 #include "helper.hpp"
+#include "utilization.hpp"
+#include "importer.hpp"
+#include "follower.hpp"
+#include "workload_file.hpp"
+#include "workload_index.hpp"
+#include "schedule_file.hpp"
+#include "metrics_file.hpp"
+#include "trace_writer.hpp"
+#include "introspect.hpp"
+#include "eval_cache.hpp"
 #include "job_gen.hpp"
 #include "pald.hpp"
 #include "umbra.hpp"
@@ -0,0 +1,161 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_TRACE_WRITER_H
+#define _COLOSSAL_TRACE_WRITER_H
+
+#include <cstdio>
+#include <stdint.h>
+#include <list>
+#include <string>
+#include <vector>
+#include <ulib/hash_open.h>
+#include "task.hpp"
+#include "pool.hpp"
+
+namespace Tempo {
+
+// Timeline trace of a simulation, for chrome://tracing or Perfetto
+//
+// Every task is a slice on the lane of the slot it ran in, maps and
+// reduces having one lane per slot in use. Preemptions are instants
+// on the slots, and the fair shares, running tasks and demands of the
+// pools are counters, sampled on a simulated-time grid like metrics.
+// A pool below its min share or half fair share has a slice on its
+// starvation track for the period, in sampling resolution. Times are
+// simulated time since the first traced event.
+
+enum trace_format {
+	TRACE_JSON,     // Chrome trace event JSON
+	TRACE_PERFETTO  // Perfetto protobuf TracePacket stream
+};
+
+// What to trace, the defaults trace everything
+struct trace_options {
+	trace_format format;
+	double interval;     // simulated time between counter samples
+	unsigned sample;     // trace the tasks of 1 in @sample jobs
+	std::string pools;   // comma-separated pools to trace with their
+			     // children, empty for all
+	double start;        // trace the tasks started in [@start, @end)
+	double end;          // and counters in the window, < 0 for no end
+
+	trace_options()
+		: format(TRACE_JSON), interval(1.0), sample(1), start(0), end(-1)
+	{ }
+};
+
+// Streams a trace as the engine runs
+// Events are buffered and written in large chunks.
+class trace_writer
+{
+public:
+	trace_writer();
+	~trace_writer();
+
+	// Create @file with the options @opts
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file, const trace_options &opts);
+
+	// Write out the trace trailer and close the file
+	void close();
+
+	bool is_open() const { return _fp != NULL; }
+
+	// Start tracing @pools from @now on, describing the tracks on
+	// the first call. Pools must not change between calls.
+	// Returns 0 on success, -1 otherwise.
+	int start(const std::list<pool> &pools, double now);
+
+	// A task started or stopped in a slot at @now
+	void start_task(td_ref *t);
+	void stop_task(td_ref *t, double now, bool preempted);
+
+	// @num tasks of @type were preempted, @need were requested
+	void preempt(task::task_type type, double now, int need, int num);
+
+	// Same as metrics_recorder::due() and sample(), for the pools
+	// given to start()
+	bool due(double next_event) const { return next_event > _next; }
+	void sample(double next_event);
+
+	// Record the counters at @now, end the starvation periods and
+	// write out the buffered events
+	void finish(double now);
+
+	// Write out the buffered events
+	// Returns 0 on success, -1 otherwise.
+	int flush();
+
+private:
+	trace_writer(const trace_writer &);
+	trace_writer &operator=(const trace_writer &);
+
+	// counters of a pool last written, for one task type
+	struct share_state {
+		double fairshare;
+		int    running;
+		int    demand;
+		double starved_since[2];  // < 0 if not starved, for min
+					  // share and half fair share
+	};
+
+	struct pool_state {
+		const pool *p;
+		bool traced;
+		share_state share[task::TASK_TYPE_NUM];
+	};
+
+	// lanes of a task type: a task takes the lowest free lane
+	struct lane_set {
+		std::vector<uint32_t> free;  // min-heap
+		uint32_t nlanes;
+	};
+
+	typedef ulib::open_hash_map<uint64_t, uint32_t> index_type;
+
+	bool in_window(double t) const
+	{
+		return t >= _opts.start && (_opts.end < 0 || t < _opts.end);
+	}
+	bool traced(const pool_state &s, const job *j) const;
+	void record(double now, bool closing);
+	void counter(size_t pool, int type, int metric, double now, double value);
+	void span(uint64_t track, const char *name, double begin, double end,
+		  const char *key, const char *value, bool highlight);
+	void instant(uint64_t group, double now, int need, int num);
+	void describe(uint64_t track, uint64_t parent, const std::string &name,
+		      bool counter);
+	void add_lane(int type);
+	void append_event();
+
+	FILE        *_fp;
+	trace_options _opts;
+	double       _base;    // simulated time at the trace start
+	double       _origin;
+	double       _next;
+	bool         _started;
+	bool         _first;  // no event written yet
+	std::vector<pool_state> _pools;
+	index_type   _pool_index;  // pool address to index into _pools
+	index_type   _lanes;       // task address to lane
+	lane_set     _free[task::TASK_TYPE_NUM];
+	std::string  _buf;
+	std::string  _ev;   // scratch for encoding Perfetto messages
+	std::string  _pk;
+};
+
+}
+
+#endif
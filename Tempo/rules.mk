@@ -15,6 +15,8 @@ EXTINC		?= -I$(PREFIX)/../ulib/include
 CFLAGS		?= -O3 -Wall -W -pipe -c -fPIC -Werror
 CXXFLAGS	?= -O3 -Wall -W -pipe -c -fPIC -Werror
 DEBUG		?= -DNDEBUG
+# -DTEMPO_PROFILE to build in the instrumentation, see src/profile.hpp
+PROFILE		?=
 
 OBJS		= \
 		$(patsubst %.c, %.o, $(wildcard *.c)) \
@@ -25,12 +27,12 @@ HEADERS		= $(wildcard *.hpp)
 .c.o:
 	$(QUIET)echo "CC "$<
 	$(QUIET)$(CC) -DVERSION="\"$(VERSION)\"" -DBUILDTIME="\"$(BUILDTIME)\"" \
-		$(CFLAGS) -I$(INCPATH) $(EXTINC) $(DEBUG) $< -o $@
+		$(CFLAGS) -I$(INCPATH) $(EXTINC) $(DEBUG) $(PROFILE) $< -o $@
 
 .cpp.o:
 	$(QUIET)echo "CXX "$<
 	$(QUIET)$(CXX) -DVERSION="\"$(VERSION)\"" -DBUILDTIME="\"$(BUILDTIME)\"" \
-		$(CXXFLAGS) -I$(INCPATH) $(EXTINC) $(DEBUG) $< -o $@
+		$(CXXFLAGS) -I$(INCPATH) $(EXTINC) $(DEBUG) $(PROFILE) $< -o $@
 
 .PHONY: install_headers install_libs install_binaries \
 	uninstall_headers uninstall_libs uninstall_binaries \
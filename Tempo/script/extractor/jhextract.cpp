@@ -0,0 +1,531 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+// Extract a Tempo workload from Hadoop job history files
+//
+// This is a native replacement of parser.awk followed by
+// app/*/data/loader.awk: it reads (concatenated) job history files and
+// writes the workload lines of the simulator directly. Each file is
+// memory-mapped and split at job boundaries into chunks that are
+// scanned in parallel; the output keeps the order of the jobs in the
+// input.
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ulib/hash_func.h>
+#include <ulib/hash_open.h>
+#include <ulib/util_log.h>
+
+// chunks smaller than this are not worth a thread
+#define EXTRACT_MIN_CHUNK (1 << 20)
+
+struct span {
+	const char *p;
+	size_t      len;
+};
+
+// keys used by the extractor, other keys are skipped
+enum jh_key {
+	KEY_JOBID,
+	KEY_JOB_QUEUE,
+	KEY_SUBMIT_TIME,
+	KEY_LAUNCH_TIME,
+	KEY_TOTAL_MAPS,
+	KEY_TOTAL_REDUCES,
+	KEY_JOB_PRIORITY,
+	KEY_FINISHED_MAPS,
+	KEY_TASK_TYPE,
+	KEY_TASK_ATTEMPT_ID,
+	KEY_TASK_STATUS,
+	KEY_START_TIME,
+	KEY_FINISH_TIME,
+	KEY_NUM
+};
+
+static const char *g_keys[KEY_NUM] = {
+	"JOBID",
+	"JOB_QUEUE",
+	"SUBMIT_TIME",
+	"LAUNCH_TIME",
+	"TOTAL_MAPS",
+	"TOTAL_REDUCES",
+	"JOB_PRIORITY",
+	"FINISHED_MAPS",
+	"TASK_TYPE",
+	"TASK_ATTEMPT_ID",
+	"TASK_STATUS",
+	"START_TIME",
+	"FINISH_TIME"
+};
+
+enum jh_record_type {
+	REC_JOB,
+	REC_ATTEMPT,   // MapAttempt or ReduceAttempt
+	REC_OTHER
+};
+
+// the fields of one history record
+struct jh_record {
+	jh_record_type type;
+	span vals[KEY_NUM];  // p is NULL if the key is absent
+
+	bool has(jh_key k) const { return vals[k].p != NULL; }
+};
+
+struct jh_attempt {
+	span    id;
+	span    type;
+	int64_t start;
+	int64_t finish;
+};
+
+// parsing state and output of one chunk
+struct chunk_ctx {
+	const char *begin;   // at a job boundary
+	const char *end;
+	const char *base;    // start of the file, for error offsets
+	bool        ptime;   // write CTIME PTIME instead of CTIME STIME FTIME
+	std::string out;
+	size_t      nlines;  // workload lines written
+	int         ret;
+	char        err[256];
+};
+
+// Returns the end of the record at @p, records end with " .\n"
+static const char *record_end(const char *p, const char *end)
+{
+	for (;;) {
+		const char *nl = (const char *)memchr(p, '\n', end - p);
+		if (nl == NULL)
+			return end;
+		if (nl - p >= 2 && nl[-1] == '.' && nl[-2] == ' ')
+			return nl - 2;
+		p = nl + 1;
+	}
+}
+
+// Returns the start of the record after the one ending at @rend
+static inline const char *record_next(const char *rend, const char *end)
+{
+	return rend + 3 <= end? rend + 3: end;
+}
+
+static int lookup_key(const char *k, size_t len)
+{
+	for (int i = 0; i < KEY_NUM; ++i)
+		if (strlen(g_keys[i]) == len && memcmp(g_keys[i], k, len) == 0)
+			return i;
+	return -1;
+}
+
+// Split a record into its type and KEY="VALUE" pairs
+// Values may contain backslash-escaped characters, which are kept.
+// Returns 0 on success, -1 if the record is malformed.
+static int parse_record(const char *p, const char *end, jh_record *rec)
+{
+	memset(rec->vals, 0, sizeof(rec->vals));
+
+	const char *q = p;
+	while (q < end && *q != ' ')
+		++q;
+	if (q - p == 3 && memcmp(p, "Job", 3) == 0)
+		rec->type = REC_JOB;
+	else if ((q - p == 10 && memcmp(p, "MapAttempt", 10) == 0) ||
+		 (q - p == 13 && memcmp(p, "ReduceAttempt", 13) == 0))
+		rec->type = REC_ATTEMPT;
+	else {
+		rec->type = REC_OTHER;
+		return 0;
+	}
+
+	while (q < end) {
+		while (q < end && (*q == ' ' || *q == '\n'))
+			++q;
+		if (q == end)
+			break;
+		const char *k = q;
+		while (q < end && *q != '=')
+			++q;
+		if (q + 1 >= end || q[1] != '"')
+			return -1;
+		size_t klen = q - k;
+		const char *v = q += 2;
+		while (q < end && *q != '"')
+			q += *q == '\\'? 2: 1;
+		if (q >= end)
+			return -1;
+		int key = lookup_key(k, klen);
+		if (key >= 0) {
+			rec->vals[key].p = v;
+			rec->vals[key].len = q - v;
+		}
+		++q;
+	}
+
+	return 0;
+}
+
+static inline bool span_equal(const span &a, const span &b)
+{
+	return a.len == b.len && memcmp(a.p, b.p, a.len) == 0;
+}
+
+// Returns the value of a decimal field, 0 if it is absent or empty
+static int64_t span_int(const span &s)
+{
+	int64_t v = 0;
+	for (size_t i = 0; i < s.len && s.p[i] >= '0' && s.p[i] <= '9'; ++i)
+		v = v * 10 + (s.p[i] - '0');
+	return v;
+}
+
+static inline void append(std::string &out, const span &s)
+{
+	out.append(s.p, s.len);
+}
+
+// Append milliseconds as seconds with three decimals, i.e. "%.3f"
+static void append_sec(std::string &out, int64_t ms)
+{
+	char buf[32];
+	uint64_t v = ms < 0? -ms: ms;
+	char *p = buf + sizeof(buf);
+	for (int i = 0; i < 3; ++i, v /= 10)
+		*--p = '0' + v % 10;
+	*--p = '.';
+	do {
+		*--p = '0' + v % 10;
+		v /= 10;
+	} while (v);
+	if (ms < 0)
+		*--p = '-';
+	out.append(p, buf + sizeof(buf) - p);
+}
+
+static void *extract_chunk(void *arg)
+{
+	chunk_ctx *ctx = (chunk_ctx *)arg;
+	ulib::open_hash_map<uint64_t, size_t> amap;
+	std::vector<jh_attempt> attempts;  // in order of their start records
+	span jobid = { NULL, 0 };
+	span queue = { NULL, 0 };
+	span priority = { NULL, 0 };
+	int64_t launch = 0;
+	jh_record rec;
+
+	ctx->ret = -1;
+	ctx->nlines = 0;
+	for (const char *p = ctx->begin; p < ctx->end; ) {
+		const char *rend = record_end(p, ctx->end);
+		const char *next = record_next(rend, ctx->end);
+		while (p < rend && (*p == '\n' || *p == ' '))
+			++p;
+		if (p == rend) {
+			p = next;
+			continue;
+		}
+		if (parse_record(p, rend, &rec)) {
+			snprintf(ctx->err, sizeof(ctx->err), "malformed record at offset %zu",
+				 (size_t)(p - ctx->base));
+			return NULL;
+		}
+
+		if (rec.type == REC_JOB) {
+			if (rec.has(KEY_SUBMIT_TIME)) {
+				// a new job starts
+				if (!rec.has(KEY_JOBID) || !rec.has(KEY_JOB_QUEUE)) {
+					snprintf(ctx->err, sizeof(ctx->err),
+						 "JOBID, SUBMIT_TIME, and JOB_QUEUE must be in one record "
+						 "at offset %zu", (size_t)(p - ctx->base));
+					return NULL;
+				}
+				jobid = rec.vals[KEY_JOBID];
+				queue = rec.vals[KEY_JOB_QUEUE];
+				priority.p = NULL;
+				priority.len = 0;
+				launch = 0;
+				amap.clear();
+				attempts.clear();
+			}
+			if ((rec.has(KEY_LAUNCH_TIME) || rec.has(KEY_JOB_PRIORITY) ||
+			     rec.has(KEY_FINISHED_MAPS)) &&
+			    !(rec.has(KEY_JOBID) && jobid.p && span_equal(rec.vals[KEY_JOBID], jobid))) {
+				snprintf(ctx->err, sizeof(ctx->err),
+					 "JOBID %.*s does not match the submitted job %.*s at offset %zu",
+					 (int)rec.vals[KEY_JOBID].len, rec.vals[KEY_JOBID].p,
+					 (int)jobid.len, jobid.p, (size_t)(p - ctx->base));
+				return NULL;
+			}
+			if (rec.has(KEY_LAUNCH_TIME))
+				launch = span_int(rec.vals[KEY_LAUNCH_TIME]);
+			if (rec.has(KEY_JOB_PRIORITY))
+				priority = rec.vals[KEY_JOB_PRIORITY];
+			if (rec.has(KEY_FINISHED_MAPS)) {
+				// the job is finished, write its attempts
+				for (size_t i = 0; i < attempts.size(); ++i) {
+					const jh_attempt &a = attempts[i];
+					if (a.start == 0 || a.finish == 0)
+						continue;
+					bool reduce = a.type.len == 6 && memcmp(a.type.p, "REDUCE", 6) == 0;
+					// POOL JOB:PRIORITY TASK <MAP|REDUCE> CTIME [STIME FTIME|PTIME]
+					append(ctx->out, queue);
+					ctx->out += '\t';
+					append(ctx->out, jobid);
+					ctx->out += ':';
+					append(ctx->out, priority);
+					ctx->out += '\t';
+					append(ctx->out, a.id);
+					ctx->out += reduce? "\tREDUCE\t": "\tMAP\t";
+					append_sec(ctx->out, launch);
+					ctx->out += '\t';
+					if (ctx->ptime)
+						append_sec(ctx->out, a.finish - a.start);
+					else {
+						append_sec(ctx->out, a.start);
+						ctx->out += '\t';
+						append_sec(ctx->out, a.finish);
+					}
+					ctx->out += '\n';
+					++ctx->nlines;
+				}
+				amap.clear();
+				attempts.clear();
+			}
+		} else if (rec.type == REC_ATTEMPT && rec.has(KEY_TASK_ATTEMPT_ID)) {
+			const span &id = rec.vals[KEY_TASK_ATTEMPT_ID];
+			uint64_t h = hash_fast64(id.p, id.len, 0);
+			ulib::open_hash_map<uint64_t, size_t>::iterator it = amap.find(h);
+			if (rec.has(KEY_START_TIME)) {
+				if (!rec.has(KEY_TASK_TYPE)) {
+					snprintf(ctx->err, sizeof(ctx->err),
+						 "TASK_TYPE, TASK_ATTEMPT_ID, and START_TIME must be in one record "
+						 "at offset %zu", (size_t)(p - ctx->base));
+					return NULL;
+				}
+				if (it == amap.end()) {
+					jh_attempt a;
+					a.id = id;
+					a.finish = 0;
+					attempts.push_back(a);
+					it = amap.insert(h, attempts.size() - 1);
+				}
+				jh_attempt &a = attempts[it.value()];
+				a.type = rec.vals[KEY_TASK_TYPE];
+				a.start = span_int(rec.vals[KEY_START_TIME]);
+			}
+			if (rec.has(KEY_FINISH_TIME)) {
+				if (!rec.has(KEY_TASK_TYPE) || !rec.has(KEY_TASK_STATUS)) {
+					snprintf(ctx->err, sizeof(ctx->err),
+						 "TASK_TYPE, TASK_ATTEMPT_ID, TASK_STATUS, and FINISH_TIME must be "
+						 "in one record at offset %zu", (size_t)(p - ctx->base));
+					return NULL;
+				}
+				if (it == amap.end() ||
+				    !span_equal(attempts[it.value()].type, rec.vals[KEY_TASK_TYPE])) {
+					snprintf(ctx->err, sizeof(ctx->err),
+						 "finish type %.*s of attempt %.*s mismatches its start type "
+						 "at offset %zu",
+						 (int)rec.vals[KEY_TASK_TYPE].len, rec.vals[KEY_TASK_TYPE].p,
+						 (int)id.len, id.p, (size_t)(p - ctx->base));
+					return NULL;
+				}
+				attempts[it.value()].finish = span_int(rec.vals[KEY_FINISH_TIME]);
+			}
+		}
+
+		p = next;
+	}
+
+	ctx->ret = 0;
+	return NULL;
+}
+
+// Returns true if the record at @p submits a job
+static bool is_job_start(const char *p, const char *rend)
+{
+	static const char key[] = " SUBMIT_TIME=\"";
+	return rend - p > 4 && memcmp(p, "Job ", 4) == 0 &&
+		memmem(p, rend - p, key, sizeof(key) - 1) != NULL;
+}
+
+// Returns the first job boundary at or after @p
+static const char *next_job(const char *p, const char *data, const char *end)
+{
+	// move to the start of a record
+	while (p > data && p < end) {
+		const char *nl = (const char *)memchr(p, '\n', end - p);
+		if (nl == NULL)
+			return end;
+		p = nl + 1;
+		if (nl - data >= 2 && nl[-1] == '.' && nl[-2] == ' ')
+			break;
+	}
+	while (p < end) {
+		const char *rend = record_end(p, end);
+		if (is_job_start(p, rend))
+			return p;
+		p = record_next(rend, end);
+	}
+	return end;
+}
+
+static int extract_file(const char *file, bool ptime, int nthreads, FILE *out,
+			size_t *nlines)
+{
+	int fd = open(file, O_RDONLY);
+	if (fd == -1) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st)) {
+		ULIB_WARNING("cannot read %s", file);
+		close(fd);
+		return -1;
+	}
+	if (st.st_size == 0) {
+		close(fd);
+		return 0;
+	}
+	void *mem = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (mem == MAP_FAILED) {
+		ULIB_WARNING("cannot map %s", file);
+		return -1;
+	}
+	const char *data = (const char *)mem;
+	size_t size = st.st_size;
+	madvise(mem, size, MADV_SEQUENTIAL);
+
+	if ((size_t)nthreads > size / EXTRACT_MIN_CHUNK + 1)
+		nthreads = size / EXTRACT_MIN_CHUNK + 1;
+
+	// split at job boundaries so that chunks are independent
+	std::vector<chunk_ctx> ctxs(nthreads);
+	const char *pos = data;
+	for (int i = 0; i < nthreads; ++i) {
+		const char *cend = data + size;
+		if (i < nthreads - 1) {
+			cend = data + size / nthreads * (i + 1);
+			cend = next_job(cend < pos? pos: cend, data, data + size);
+		}
+		ctxs[i].begin = pos;
+		ctxs[i].end = cend;
+		ctxs[i].base = data;
+		ctxs[i].ptime = ptime;
+		ctxs[i].err[0] = '\0';
+		pos = cend;
+	}
+
+	// the calling thread takes the first chunk
+	std::vector<pthread_t> tids(nthreads);
+	std::vector<bool> started(nthreads, false);
+	for (int i = 1; i < nthreads; ++i)
+		started[i] = pthread_create(&tids[i], NULL, extract_chunk, &ctxs[i]) == 0;
+	extract_chunk(&ctxs[0]);
+	for (int i = 1; i < nthreads; ++i) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			extract_chunk(&ctxs[i]);
+	}
+	munmap(mem, size);
+
+	for (int i = 0; i < nthreads; ++i) {
+		if (ctxs[i].ret) {
+			ULIB_WARNING("Error encounterred while parsing %s: %s", file, ctxs[i].err);
+			return -1;
+		}
+		if (ctxs[i].out.size() &&
+		    fwrite(ctxs[i].out.data(), ctxs[i].out.size(), 1, out) != 1) {
+			ULIB_WARNING("failed to write the workload");
+			return -1;
+		}
+		*nlines += ctxs[i].nlines;
+	}
+
+	return 0;
+}
+
+static void usage(const char *prog)
+{
+	fprintf(stderr,
+		"Usage: %s [-p] [-t threads] [-o output] history_file...\n"
+		"  -p  write CTIME PTIME (optimizer workloads),\n"
+		"      otherwise CTIME STIME FTIME (sched_pred workloads)\n"
+		"  -t  number of parsing threads, all CPUs by default\n"
+		"  -o  output workload file, the standard output by default\n", prog);
+}
+
+int main(int argc, char *argv[])
+{
+	const char *output = NULL;
+	bool ptime = false;
+	int nthreads = 0;
+	int c;
+
+	while ((c = getopt(argc, argv, "pt:o:h")) != -1) {
+		switch (c) {
+		case 'p':
+			ptime = true;
+			break;
+		case 't':
+			nthreads = atoi(optarg);
+			break;
+		case 'o':
+			output = optarg;
+			break;
+		default:
+			usage(argv[0]);
+			return EXIT_FAILURE;
+		}
+	}
+	if (optind == argc) {
+		usage(argv[0]);
+		return EXIT_FAILURE;
+	}
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	FILE *out = stdout;
+	if (output && (out = fopen(output, "w")) == NULL) {
+		ULIB_WARNING("cannot open %s for writing", output);
+		return EXIT_FAILURE;
+	}
+
+	size_t nlines = 0;
+	int ret = 0;
+	for (int i = optind; i < argc && ret == 0; ++i)
+		ret = extract_file(argv[i], ptime, nthreads, out, &nlines);
+	if (out != stdout && fclose(out)) {
+		ULIB_WARNING("failed to write %s", output);
+		ret = -1;
+	}
+	if (ret)
+		return EXIT_FAILURE;
+	fprintf(stderr, "Extracted %zu task attempts\n", nlines);
+
+	return 0;
+}
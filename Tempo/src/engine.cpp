@@ -14,14 +14,16 @@
 
 #include <cstddef>
 #include <cstdio>
+#include <cstring>
 #include <algorithm>
 #include <ulib/util_log.h>
 #include "log.hpp"
 #include "common.hpp"
 #include "fsched.hpp"
 #include "helper.hpp"
-#include "metric.hpp"
 #include "engine.hpp"
+#include "profile.hpp"
+#include "introspect.hpp"
 
 namespace Tempo
 {
@@ -30,8 +32,8 @@ const double engine::LOAD_FACTOR = 0.7;
 const int    engine::PROGRESS_WINSIZE = 50000;
 
 engine::engine(int nmaps, int nreduces, double now)
-        : time_now(now), _nmap(nmaps), _nreduce(nreduces),
-	  _met_win(0), _fp_met(NULL)
+        : time_now(now), _nmap(nmaps), _nreduce(nreduces), _usage_series(false),
+	  _progress(true), _state(true), _bound(NULL), _stopped(false)
 {
 	select = NULL; // allocate only when jobs are loaded
         sem_map = new vsem_type(nmaps);
@@ -47,30 +49,32 @@ engine::~engine()
         delete running_maps;
         delete running_reduces;
 	delete select;
-
-	if (_fp_met)
-		fclose(_fp_met);
 }
 
-bool engine::set_metrics(const char * met, int met_win)
+bool engine::set_metrics(const char * met, double met_interval)
 {
 	if (met == NULL)
 		return false;
-	_met_win = met_win;
-	_fp_met = fopen(met, "w");
-	if (_fp_met == NULL) {
-		ULIB_WARNING("cannot open metric file %s", met);
-		return false;
-	}
+	return _met.open(met, met_interval) == 0;
+}
 
-	return true;
+bool engine::set_trace(const char *file, const trace_options &opts)
+{
+	if (file == NULL)
+		return false;
+	return _trace.open(file, opts) == 0;
 }
 
 pool &engine::add_pool(const std::string &ns, double mto, double fto,
-		       double weight, int minmap, int minred, pool::sched_mode sched)
+		       double weight, int minmap, int minred, pool::sched_mode sched,
+		       pool *parent)
 {
         _pools.push_back(pool(ns, mto, fto, weight, minmap, minred, sched));
-        return _pools.back();
+	pool &p = _pools.back();
+	p.set_parent(parent);
+	if (parent == NULL)
+		_roots.push_back(&p);
+        return p;
 }
 
 void engine::run_map(td_ref *t)
@@ -80,6 +84,9 @@ void engine::run_map(td_ref *t)
 
 	// add to running set
 	running_maps->insert(t);
+	start_usage(t, task::TASK_TYPE_MAP);
+	if (_trace.is_open())
+		_trace.start_task(t);
 
 	// add finish event
 	add_event(new ev_finish_map(t));
@@ -92,6 +99,9 @@ void engine::run_reduce(td_ref *t)
 
 	// add to running set
 	running_reduces->insert(t);
+	start_usage(t, task::TASK_TYPE_REDUCE);
+	if (_trace.is_open())
+		_trace.start_task(t);
 
 	// add finish event
 	add_event(new ev_finish_reduce(t));
@@ -101,11 +111,15 @@ void engine::finish_map(td_ref *t)
 {
 	t->gettask()->ftime = time_now;
 	t->getjob()->ftime = time_now;
+	if (--t->getjob()->nleft == 0)
+		finish_job(t->getpool(), t->getjob());
 	running_maps->erase(t);
+	stop_usage(t, task::TASK_TYPE_MAP, false);
+	if (_trace.is_open())
+		_trace.stop_task(t, time_now, false);
 	--t->getjob()->fs_ctx_map.alloc;
 	--t->getjob()->fs_ctx_map.demand;
-	--t->getpool()->fs_ctx_map.alloc;
-	--t->getpool()->fs_ctx_map.demand;
+	select->release_map(t);
 	update_map_fairshares(); // since demand has changed, update fair shares
 	t->getpool()->map_transit_n2s(this);
 	// needed for half fair share starvation
@@ -117,11 +131,15 @@ void engine::finish_reduce(td_ref *t)
 {
 	t->gettask()->ftime = time_now;
 	t->getjob()->ftime = time_now;
+	if (--t->getjob()->nleft == 0)
+		finish_job(t->getpool(), t->getjob());
 	running_reduces->erase(t);
+	stop_usage(t, task::TASK_TYPE_REDUCE, false);
+	if (_trace.is_open())
+		_trace.stop_task(t, time_now, false);
 	--t->getjob()->fs_ctx_reduce.alloc;
 	--t->getjob()->fs_ctx_reduce.demand;
-	--t->getpool()->fs_ctx_reduce.alloc;
-	--t->getpool()->fs_ctx_reduce.demand;
+	select->release_reduce(t);
 	update_reduce_fairshares(); // since demand has changed, update fair shares
 	t->getpool()->reduce_transit_n2s(this);
 	// needed for half fair share starvation
@@ -129,6 +147,74 @@ void engine::finish_reduce(td_ref *t)
 	sem_reduce->post(this);
 }
 
+void engine::finish_job(pool *p, job *j)
+{
+	double response = j->ftime - j->ctime;
+	double ideal = j->ideal_ftime - j->ctime;
+	double slowdown = ideal > 0? response / ideal: 1.0;
+
+	if (_bound && !_stopped && _bound->job_done(*p, *j, time_now))
+		_stopped = true;
+	for (; p; p = p->parent) {
+		p->response_times.add(response);
+		p->slowdowns.add(slowdown);
+	}
+}
+
+// Drop the events and the allocations of a stopped run
+void engine::discard_run()
+{
+	for (eventheap_type::iterator it = _eventheap.begin();
+	     it != _eventheap.end(); ++it)
+		delete *it;
+	_eventheap.clear();
+	sem_map->reset(_nmap);
+	sem_reduce->reset(_nreduce);
+	running_maps->clear();
+	running_reduces->clear();
+
+	for (pool_container_type::iterator pit = _pools.begin();
+	     pit != _pools.end(); ++pit) {
+		fs_context *ctx[] = { &pit->fs_ctx_map, &pit->fs_ctx_reduce };
+		for (int k = 0; k < 2; ++k) {
+			ctx[k]->demand = 0;
+			ctx[k]->alloc = 0;
+			ctx[k]->fairshare = 0;
+		}
+		pit->map_last_at_ms = -1;
+		pit->map_last_at_hf = -1;
+		pit->reduce_last_at_ms = -1;
+		pit->reduce_last_at_hf = -1;
+		for (pool::job_container_type::iterator jit = pit->jobs.begin();
+		     jit != pit->jobs.end(); ++jit) {
+			fs_context *jctx[] = { &jit->fs_ctx_map, &jit->fs_ctx_reduce };
+			for (int k = 0; k < 2; ++k) {
+				jctx[k]->demand = 0;
+				jctx[k]->alloc = 0;
+				jctx[k]->fairshare = 0;
+			}
+		}
+	}
+}
+
+// Account a task attempt in the cluster and its pools
+void engine::start_usage(td_ref *t, task::task_type type)
+{
+	_usage[type].start(time_now);
+	for (pool *p = t->getpool(); p; p = p->parent)
+		(type == task::TASK_TYPE_MAP? p->map_usage: p->reduce_usage).start(time_now);
+}
+
+void engine::stop_usage(td_ref *t, task::task_type type, bool preempted)
+{
+	double stime = t->gettask()->stime;
+
+	_usage[type].stop(stime, time_now, preempted);
+	for (pool *p = t->getpool(); p; p = p->parent)
+		(type == task::TASK_TYPE_MAP? p->map_usage: p->reduce_usage).stop(
+			stime, time_now, preempted);
+}
+
 void engine::add_event(event *ev)
 {
 	_eventheap.push_back(ev);
@@ -138,6 +224,7 @@ void engine::add_event(event *ev)
 
 void engine::preempt_maps(int num)
 {
+	PROFILE_SCOPE(PROF_PREEMPT_MAPS);
         int n = 0;
         int m = num;
 	running_maps->snap();  // take a snapshop of current running tasks
@@ -151,10 +238,12 @@ void engine::preempt_maps(int num)
 			((td_ref *)it.key())->set_flag(task::TASK_FLAG_PREEMPTED);
 			--((td_ref *)it.key())->getjob()->fs_ctx_map.alloc;
 			--((td_ref *)it.key())->getjob()->fs_ctx_map.demand;
-			--((td_ref *)it.key())->getpool()->fs_ctx_map.alloc;
-			--((td_ref *)it.key())->getpool()->fs_ctx_map.demand;
+			select->release_map(it.key());
 			// must be added back into the scheduler
 			select->add_preempted_map(it.key());
+			stop_usage(it.key(), task::TASK_TYPE_MAP, true);
+			if (_trace.is_open())
+				_trace.stop_task(it.key(), time_now, true);
                         running_maps->erase((it++).key());
 		} else
 			++it;
@@ -168,11 +257,14 @@ void engine::preempt_maps(int num)
 		sem_map->post(this);
 	}
 
-	NOTICE(time_now, "%d of %d maps have been preempted", n, num);
+	if (_trace.is_open())
+		_trace.preempt(task::TASK_TYPE_MAP, time_now, num, n);
+	NOTICE(LOG_PREEMPT, time_now, "%d of %d maps have been preempted", n, num);
 }
 
 void engine::preempt_reduces(int num)
 {
+	PROFILE_SCOPE(PROF_PREEMPT_REDUCES);
         int n = 0;
         int m = num;
 	running_reduces->snap();  // take a snapshop of current running tasks
@@ -186,10 +278,12 @@ void engine::preempt_reduces(int num)
 			((td_ref *)it.key())->set_flag(task::TASK_FLAG_PREEMPTED);
 			--((td_ref *)it.key())->getjob()->fs_ctx_reduce.alloc;
 			--((td_ref *)it.key())->getjob()->fs_ctx_reduce.demand;
-			--((td_ref *)it.key())->getpool()->fs_ctx_reduce.alloc;
-			--((td_ref *)it.key())->getpool()->fs_ctx_reduce.demand;
+			select->release_reduce(it.key());
 			// must be added back into the scheduler
 			select->add_preempted_reduce(it.key());
+			stop_usage(it.key(), task::TASK_TYPE_REDUCE, true);
+			if (_trace.is_open())
+				_trace.stop_task(it.key(), time_now, true);
                         running_reduces->erase((it++).key());
 		} else
 			++it;
@@ -203,7 +297,9 @@ void engine::preempt_reduces(int num)
 		sem_reduce->post(this);
 	}
 
-	NOTICE(time_now, "%d of %d reduces have been preempted", n, num);
+	if (_trace.is_open())
+		_trace.preempt(task::TASK_TYPE_REDUCE, time_now, num, n);
+	NOTICE(LOG_PREEMPT, time_now, "%d of %d reduces have been preempted", n, num);
 }
 
 void engine::submit_tasks()
@@ -214,6 +310,42 @@ void engine::submit_tasks()
 		add_event(new ev_create_reduce(select));
 }
 
+// Count the tasks each job has to run, and the time the job would
+// finish if none of them waited for a slot
+void engine::track_jobs(const workload_view *view)
+{
+	for (int type = 0; type < task::TASK_TYPE_NUM; ++type)
+		_usage[type].clear(_usage_series);
+	for (pool_container_type::iterator pit = _pools.begin();
+	     pit != _pools.end(); ++pit) {
+		pit->response_times.clear();
+		pit->slowdowns.clear();
+		pit->map_usage.clear(_usage_series);
+		pit->reduce_usage.clear(_usage_series);
+		for (pool::job_container_type::iterator jit = pit->jobs.begin();
+		     jit != pit->jobs.end(); ++jit) {
+			jit->nleft = 0;
+			jit->ideal_ftime = jit->ctime;
+			for (int type = 0; !view && type < task::TASK_TYPE_NUM; ++type) {
+				const job::task_container_type &tasks = jit->tasks[type];
+				jit->nleft += tasks.size();
+				for (size_t k = 0; k < tasks.size(); ++k)
+					jit->ideal_ftime = std::max(jit->ideal_ftime,
+								    tasks[k].ctime + tasks[k].ptime);
+			}
+		}
+	}
+	for (size_t i = 0; view && i < view->parts.size(); ++i) {
+		const workload_view::part &part = view->parts[i];
+		for (const wi_task *t = part.tasks; t != part.tasks_end; ++t) {
+			job &j = part.p->jobs[t->job];
+			const task &tk = part.task_at(*t);
+			++j.nleft;
+			j.ideal_ftime = std::max(j.ideal_ftime, tk.ctime + tk.ptime);
+		}
+	}
+}
+
 double engine::map_progress() const
 {
 	if (select == NULL)
@@ -234,69 +366,199 @@ double engine::reduce_progress() const
 	return select->reduces_popped() / total;
 }
 
-void engine::process()
+// Publish a snapshot for introspection, @nev events processed
+void engine::publish_state(size_t nev)
+{
+	is_engine *s = introspect_begin_engine();
+	if (s == NULL)
+		return;
+
+	double wall = introspect_clock();
+	// the previous snapshot may be of an earlier run
+	if (nev > s->events && wall > s->wall)
+		s->events_per_sec = (nev - s->events) / (wall - s->wall);
+	else
+		s->events_per_sec = 0;
+	s->wall = wall;
+	s->time = time_now;
+	s->events = nev;
+	s->heap = _eventheap.size();
+	s->running_maps = running_maps->size();
+	s->running_reduces = running_reduces->size();
+	s->waiting_maps = sem_map->size();
+	s->waiting_reduces = sem_reduce->size();
+	s->map_progress = map_progress();
+	s->reduce_progress = reduce_progress();
+	s->npools = 0;
+	s->pools_omitted = 0;
+	for (pool_container_type::const_iterator it = _pools.begin();
+	     it != _pools.end(); ++it) {
+		if (s->npools == INTROSPECT_MAX_POOLS) {
+			++s->pools_omitted;
+			continue;
+		}
+		is_pool &p = s->pools[s->npools++];
+		strncpy(p.name, it->name.c_str(), sizeof(p.name));
+		p.map.alloc = it->fs_ctx_map.alloc;
+		p.map.demand = it->fs_ctx_map.demand;
+		p.map.fairshare = it->fs_ctx_map.fairshare;
+		p.reduce.alloc = it->fs_ctx_reduce.alloc;
+		p.reduce.demand = it->fs_ctx_reduce.demand;
+		p.reduce.fairshare = it->fs_ctx_reduce.fairshare;
+	}
+	introspect_end_engine();
+}
+
+void engine::process(const workload_view *view)
 {
 	// Initially fair shares are zero due to zero demand, and
 	// nobody is starved due to zero demands
 
+	// pool settings may have changed since the last run
+	for (pool_container_type::iterator it = _pools.begin();
+	     it != _pools.end(); ++it) {
+		it->map_children_total = -1;
+		it->reduce_children_total = -1;
+	}
+
+	track_jobs(view);
+	_stopped = false;
+	if (_bound)
+		_bound->start(_pools);
+	PROFILE_RESET();
+
 	// create a task selector on pools
 	delete select;  // delete an existing selector
-	select = new selector(_pools.begin(), _pools.end());
+	select = new selector(_pools.begin(), _pools.end(), view);
 
-	// add task creation events
+	// add task creation events, events allocate on behalf of the
+	// engine unless a subsystem takes over
+	PROFILE_ALLOC_SCOPE(ALLOC_EVENTS);
         submit_tasks();
 
-	metric met("", _fp_met);
+	// the recorder closes itself if it cannot start
+	if (_met.is_open() && _eventheap.size())
+		_met.start(_pools, (*_eventheap.begin())->gettime());
+	if (_trace.is_open() && _eventheap.size() &&
+	    _trace.start(_pools, (*_eventheap.begin())->gettime()))
+		ULIB_WARNING("the run is not traced");
 	size_t nev = 0;
         // process events
-	while (_eventheap.size()) {
+	while (_eventheap.size() && !_stopped) {
 		event *ev = *_eventheap.begin();
+		// all events up to the sample time have been processed
+		if (_met.is_open() && _met.due(ev->gettime()))
+			_met.sample(_pools, ev->gettime());
+		if (_trace.is_open() && _trace.due(ev->gettime()))
+			_trace.sample(ev->gettime());
 		heap_pop_to_rear_inclass(&*_eventheap.begin(), &*_eventheap.end());
 		_eventheap.pop_back();
 		if ((*ev)(this))  // delete the event if it is done
 			delete ev;
 		// sample processing progress
-		if (nev % PROGRESS_WINSIZE == 0 || _eventheap.size() == 0)
-			show_progress(map_progress(), reduce_progress());
-		// sample metrics
-		if (_fp_met && (nev % _met_win == 0 || _eventheap.size() == 0)) {
-			for (pool_container_type::const_iterator it = _pools.begin();
-			     it != _pools.end(); ++it) {
-				char key[64];
-				snprintf(key, sizeof(key), "%lf", time_now);
-				metric root = met[key];
-				it->print_metrics(root[it->name]);
-			}
+		if (nev % PROGRESS_WINSIZE == 0 || _eventheap.size() == 0) {
+			if (_progress)
+				show_progress(map_progress(), reduce_progress());
+			if (_state && introspect_enabled())
+				publish_state(nev + 1);
 		}
 		++nev;
+		PROFILE_SAMPLE(time_now, _eventheap.size(), sem_map->size(),
+			       sem_reduce->size(), running_maps->size(),
+			       running_reduces->size());
+	}
+	// the final states
+	if (_met.is_open() && nev) {
+		_met.record(_pools, time_now);
+		if (_met.flush())
+			ULIB_WARNING("failed to write metrics");
 	}
+	if (_trace.is_open() && nev)
+		_trace.finish(time_now);
+	if (_stopped)
+		discard_run();
 
-	if (nev)
+	log_flush();
+	if (_progress && nev)
 		fprintf(stderr, "\n");
+	PROFILE_REPORT(stderr);
 }
 
 void engine::scale_minshares()
 {
-	map_fs_itr<pool_container_type> map_begin(_pools.begin());
-	map_fs_itr<pool_container_type> map_end(_pools.end());
-	reduce_fs_itr<pool_container_type> red_begin(_pools.begin());
-	reduce_fs_itr<pool_container_type> red_end(_pools.end());
+	map_fs_ptr_itr<pool_group_type> map_begin(_roots.begin());
+	map_fs_ptr_itr<pool_group_type> map_end(_roots.end());
+	reduce_fs_ptr_itr<pool_group_type> red_begin(_roots.begin());
+	reduce_fs_ptr_itr<pool_group_type> red_end(_roots.end());
 	Tempo::scale_minshares(map_begin, map_end, _nmap);
 	Tempo::scale_minshares(red_begin, red_end, _nreduce);
+
+	// parents precede their children in _pools
+	for (pool_container_type::iterator it = _pools.begin();
+	     it != _pools.end(); ++it) {
+		if (it->is_leaf())
+			continue;
+		map_fs_ptr_itr<pool_group_type> cmap_begin(it->children.begin());
+		map_fs_ptr_itr<pool_group_type> cmap_end(it->children.end());
+		reduce_fs_ptr_itr<pool_group_type> cred_begin(it->children.begin());
+		reduce_fs_ptr_itr<pool_group_type> cred_end(it->children.end());
+		Tempo::scale_minshares(cmap_begin, cmap_end, it->fs_ctx_map.minshare);
+		Tempo::scale_minshares(cred_begin, cred_end, it->fs_ctx_reduce.minshare);
+	}
+}
+
+void engine::set_slots(int nmaps, int nreduces)
+{
+	_nmap = nmaps;
+	_nreduce = nreduces;
+	sem_map->reset(nmaps);
+	sem_reduce->reset(nreduces);
+}
+
+void engine::update_map_fairshares(pool_group_type &group, double total)
+{
+	map_fs_ptr_itr<pool_group_type> begin(group.begin());
+	map_fs_ptr_itr<pool_group_type> end(group.end());
+	compute_fairshares(begin, end, total);
+
+	// a child group only changes with its parent's share or demands
+	for (pool_group_type::iterator it = group.begin(); it != group.end(); ++it) {
+		pool *p = *it;
+		if (p->is_leaf() || p->map_children_total == p->fs_ctx_map.fairshare)
+			continue;
+		p->map_children_total = p->fs_ctx_map.fairshare;
+		update_map_fairshares(p->children, p->fs_ctx_map.fairshare);
+	}
+}
+
+void engine::update_reduce_fairshares(pool_group_type &group, double total)
+{
+	reduce_fs_ptr_itr<pool_group_type> begin(group.begin());
+	reduce_fs_ptr_itr<pool_group_type> end(group.end());
+	compute_fairshares(begin, end, total);
+
+	// a child group only changes with its parent's share or demands
+	for (pool_group_type::iterator it = group.begin(); it != group.end(); ++it) {
+		pool *p = *it;
+		if (p->is_leaf() || p->reduce_children_total == p->fs_ctx_reduce.fairshare)
+			continue;
+		p->reduce_children_total = p->fs_ctx_reduce.fairshare;
+		update_reduce_fairshares(p->children, p->fs_ctx_reduce.fairshare);
+	}
 }
 
 void engine::update_map_fairshares()
 {
-	map_fs_itr<pool_container_type> begin(_pools.begin());
-	map_fs_itr<pool_container_type> end(_pools.end());
-	compute_fairshares(begin, end, _nmap);
+	PROFILE_SCOPE(PROF_FAIRSHARES);
+	PROFILE_ALLOC_SCOPE(ALLOC_FSCHED);
+	update_map_fairshares(_roots, _nmap);
 }
 
 void engine::update_reduce_fairshares()
 {
-	reduce_fs_itr<pool_container_type> begin(_pools.begin());
-	reduce_fs_itr<pool_container_type> end(_pools.end());
-	compute_fairshares(begin, end, _nreduce);
+	PROFILE_SCOPE(PROF_FAIRSHARES);
+	PROFILE_ALLOC_SCOPE(ALLOC_FSCHED);
+	update_reduce_fairshares(_roots, _nreduce);
 }
 
 }
@@ -0,0 +1,182 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <ulib/hash_func.h>
+#include <ulib/util_log.h>
+#include "helper.hpp"
+#include "eval_cache.hpp"
+
+#define EVAL_CACHE_MAGIC "# Tempo evaluation cache"
+
+namespace Tempo {
+
+eval_cache::eval_cache()
+	: _fp(NULL), _hits(0), _misses(0)
+{
+}
+
+eval_cache::~eval_cache()
+{
+	close();
+}
+
+void eval_cache::close()
+{
+	if (_fp)
+		fclose(_fp);
+	_fp = NULL;
+}
+
+uint64_t eval_cache::key_of(const std::vector<double> &x)
+{
+	return hash_fast64(&x[0], x.size() * sizeof(double), 0xbeefdeedfeedbeefull);
+}
+
+void eval_cache::copy(const gsl_vector *v, std::vector<double> *out)
+{
+	out->resize(v->size);
+	for (size_t i = 0; i < v->size; ++i)
+		(*out)[i] = gsl_vector_get(v, i);
+}
+
+// Parse "x1 x2 ...\ty1 y2 ..." into @x and @y
+// Returns true if the line is complete.
+static bool parse_entry(char *line, std::vector<double> *x, std::vector<double> *y)
+{
+	char *tab = strchr(line, '\t');
+	if (tab == NULL || strchr(tab, '\n') == NULL)
+		return false;
+	*tab = '\0';
+	std::vector<double> *out[] = { x, y };
+	char *s[] = { line, tab + 1 };
+	for (int k = 0; k < 2; ++k) {
+		char *end;
+		for (double v = strtod(s[k], &end); end != s[k]; v = strtod(s[k], &end)) {
+			out[k]->push_back(v);
+			s[k] = end;
+		}
+		if (*s[k] != '\0' && *s[k] != '\n')
+			return false;
+	}
+	return x->size() && y->size();
+}
+
+int eval_cache::open(const char *file, uint64_t context)
+{
+	char head[64];
+
+	close();
+	snprintf(head, sizeof(head), "%s %016lx\n", EVAL_CACHE_MAGIC, context);
+
+	FILE *fp = fopen(file, "r");
+	if (fp) {
+		char *line = NULL;
+		size_t cap = 0;
+		bool same = getline(&line, &cap, fp) > 0 && strcmp(line, head) == 0;
+		while (same && getline(&line, &cap, fp) > 0) {
+			entry e;
+			if (parse_entry(line, &e.x, &e.y))
+				add(e);
+		}
+		free(line);
+		fclose(fp);
+		if (same) {
+			_fp = fopen(file, "a");
+			if (_fp == NULL) {
+				ULIB_WARNING("cannot open %s for appending", file);
+				return -1;
+			}
+			return 0;
+		}
+		ULIB_WARNING("%s was saved for other settings, starting over", file);
+	}
+
+	_fp = fopen(file, "w");
+	if (_fp == NULL || fputs(head, _fp) == EOF) {
+		ULIB_WARNING("cannot open %s for writing", file);
+		close();
+		return -1;
+	}
+	return 0;
+}
+
+void eval_cache::add(const entry &e)
+{
+	uint64_t key = key_of(e.x);
+	// keep the first of colliding vectors
+	if (_index.find(key) != _index.end())
+		return;
+	_index[key] = _entries.size();
+	_entries.push_back(e);
+}
+
+bool eval_cache::lookup(const gsl_vector *x, gsl_vector *y)
+{
+	std::vector<double> v;
+
+	copy(x, &v);
+	ulib::open_hash_map<uint64_t, size_t>::iterator it = _index.find(key_of(v));
+	if (it != _index.end()) {
+		const entry &e = _entries[it.value()];
+		if (e.x == v && e.y.size() == y->size) {
+			for (size_t i = 0; i < y->size; ++i)
+				gsl_vector_set(y, i, e.y[i]);
+			++_hits;
+			return true;
+		}
+	}
+	++_misses;
+	return false;
+}
+
+void eval_cache::insert(const gsl_vector *x, const gsl_vector *y)
+{
+	entry e;
+
+	copy(x, &e.x);
+	copy(y, &e.y);
+	size_t n = _entries.size();
+	add(e);
+	if (_fp && _entries.size() > n)
+		append(e);
+}
+
+// Append an entry in a line of shortest round-trip decimals
+void eval_cache::append(const entry &e)
+{
+	char buf[32];
+	std::string line;
+
+	for (size_t i = 0; i < e.x.size(); ++i) {
+		if (i)
+			line.push_back(' ');
+		line.append(buf, format_double(e.x[i], buf));
+	}
+	line.push_back('\t');
+	for (size_t i = 0; i < e.y.size(); ++i) {
+		if (i)
+			line.push_back(' ');
+		line.append(buf, format_double(e.y[i], buf));
+	}
+	line.push_back('\n');
+	if (fwrite(line.data(), 1, line.size(), _fp) != line.size() || fflush(_fp)) {
+		ULIB_WARNING("failed to save an evaluation, no longer saving");
+		close();
+	}
+}
+
+}
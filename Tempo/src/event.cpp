@@ -16,6 +16,7 @@
 #include "common.hpp"
 #include "event.hpp"
 #include "engine.hpp"
+#include "profile.hpp"
 
 namespace Tempo
 {
@@ -29,11 +30,13 @@ ev_create_map::ev_create_map(selector *sel)
 
 bool ev_create_map::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_CREATE_MAP);
+
 	if (_time > eng->time_now)  // possibly woke from sleep
 		eng->time_now = _time;
 
 	// creation event is asynchronous, thus time is job tracker time
-        DEBUG(eng->time_now, "ev_create_map executed");
+        DEBUG(LOG_EVENT, eng->time_now, "ev_create_map executed");
 
 	// update demands
 	selector::changes_type changes;
@@ -49,16 +52,16 @@ bool ev_create_map::operator()(engine *eng)
 
 	// acquire resources
 	if (!eng->sem_map->wait(this)) {
-		DEBUG(eng->time_now, "map creation suspended due to lack of slot");
+		DEBUG(LOG_EVENT, eng->time_now, "map creation suspended due to lack of slot");
 		return false;
 	} else {
-		DEBUG(eng->time_now, "map creation acquired a slot");
+		DEBUG(LOG_EVENT, eng->time_now, "map creation acquired a slot");
 	}
 
 	// run the map
 	td_ref *t = _sel->pop_map();
 	if (t == NULL) {
-		FATAL(eng->time_now, "popped out a NULL task");
+		FATAL(LOG_SELECT, eng->time_now, "popped out a NULL task");
 		return true;
 	}
 
@@ -73,7 +76,7 @@ bool ev_create_map::operator()(engine *eng)
 	if (_sel->has_map())
 		eng->add_event(new ev_create_map(_sel));
 	else {
-		DEBUG(eng->time_now, "no more map creation");
+		DEBUG(LOG_EVENT, eng->time_now, "no more map creation");
 	}
 
 	return true;
@@ -88,11 +91,13 @@ ev_create_reduce::ev_create_reduce(selector *sel)
 
 bool ev_create_reduce::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_CREATE_REDUCE);
+
 	if (_time > eng->time_now)  // possibly woke from sleep
 		eng->time_now = _time;
 
 	// creation event is asynchronous, thus time is job tracker time
-        DEBUG(eng->time_now, "ev_create_reduce executed");
+        DEBUG(LOG_EVENT, eng->time_now, "ev_create_reduce executed");
 
 	// update demands
 	selector::changes_type changes;
@@ -108,16 +113,16 @@ bool ev_create_reduce::operator()(engine *eng)
 
 	// acquire resources
 	if (!eng->sem_reduce->wait(this)) {
-		DEBUG(eng->time_now, "reduce creation suspended due to lack of slot");
+		DEBUG(LOG_EVENT, eng->time_now, "reduce creation suspended due to lack of slot");
 		return false;
 	} else {
-		DEBUG(eng->time_now, "reduce creation acquired a slot");
+		DEBUG(LOG_EVENT, eng->time_now, "reduce creation acquired a slot");
 	}
 
 	// run the reduce
 	td_ref *t = _sel->pop_reduce();
 	if (t == NULL) {
-		FATAL(eng->time_now, "popped out a NULL task");
+		FATAL(LOG_SELECT, eng->time_now, "popped out a NULL task");
 		return true;
 	}
 
@@ -132,7 +137,7 @@ bool ev_create_reduce::operator()(engine *eng)
 	if (_sel->has_reduce())
 		eng->add_event(new ev_create_reduce(_sel));
 	else {
-		DEBUG(eng->time_now, "no more reduce creation");
+		DEBUG(LOG_EVENT, eng->time_now, "no more reduce creation");
 	}
 
 	return true;
@@ -146,13 +151,15 @@ ev_finish_map::ev_finish_map(td_ref *t)
 
 bool ev_finish_map::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_FINISH_MAP);
+
 	// Only effective if the task has not been preempted
 	if (double_equal(_ref->gettask()->stime + _ref->gettask()->ptime, _time) &&
 	    !_ref->test_flag(task::TASK_FLAG_PREEMPTED)) {
 		eng->time_now = _time;
 		eng->finish_map(_ref);
 	}
-	DEBUG(eng->time_now, "ev_finish_map executed");
+	DEBUG(LOG_EVENT, eng->time_now, "ev_finish_map executed");
 
 	return true;
 }
@@ -165,13 +172,15 @@ ev_finish_reduce::ev_finish_reduce(td_ref *t)
 
 bool ev_finish_reduce::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_FINISH_REDUCE);
+
 	// Only effective if the task has not been preempted and not already finished
 	if (double_equal(_ref->gettask()->stime + _ref->gettask()->ptime, _time) &&
 	    !_ref->test_flag(task::TASK_FLAG_PREEMPTED)) {
 		eng->time_now = _time;
 		eng->finish_reduce(_ref);
 	}
-	DEBUG(eng->time_now, "ev_finish_reduce executed");
+	DEBUG(LOG_EVENT, eng->time_now, "ev_finish_reduce executed");
 
 	return true;
 }
@@ -184,18 +193,20 @@ ev_preempt_map::ev_preempt_map(pool *p, double deadline)
 
 bool ev_preempt_map::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_PREEMPT_MAP);
+
 	eng->time_now = _time;
 
-	DEBUG(eng->time_now, "ev_preempt_map executed");
+	DEBUG(LOG_EVENT, eng->time_now, "ev_preempt_map executed");
 
 	int ms = _pool->starved_for_map_minshare(_time);
 	int hf = _pool->starved_for_map_halffairshare(_time);
 
 	if (ms > hf) {
-		NOTICE(eng->time_now, "need to preempt %d maps due to min share", ms);
+		NOTICE(LOG_PREEMPT, eng->time_now, "need to preempt %d maps due to min share", ms);
 		eng->preempt_maps(ms);
 	} else if (hf > 0) {
-		NOTICE(eng->time_now, "need to preempt %d maps due to half fair share", hf);
+		NOTICE(LOG_PREEMPT, eng->time_now, "need to preempt %d maps due to half fair share", hf);
 		eng->preempt_maps(hf);
 	}
 
@@ -210,18 +221,20 @@ ev_preempt_reduce::ev_preempt_reduce(pool *p, double deadline)
 
 bool ev_preempt_reduce::operator()(engine *eng)
 {
+	PROFILE_SCOPE(PROF_EV_PREEMPT_REDUCE);
+
 	eng->time_now = _time;
 
-	DEBUG(eng->time_now, "ev_preempt_reduce executed");
+	DEBUG(LOG_EVENT, eng->time_now, "ev_preempt_reduce executed");
 
 	int ms = _pool->starved_for_reduce_minshare(_time);
 	int hf = _pool->starved_for_reduce_halffairshare(_time);
 
 	if (ms > hf) {
-		NOTICE(eng->time_now, "need to preempt %d reduces due to min share", ms);
+		NOTICE(LOG_PREEMPT, eng->time_now, "need to preempt %d reduces due to min share", ms);
 		eng->preempt_reduces(ms);
 	} else if (hf > 0) {
-		NOTICE(eng->time_now, "need to preempt %d reduces due to half fair share", hf);
+		NOTICE(LOG_PREEMPT, eng->time_now, "need to preempt %d reduces due to half fair share", hf);
 		eng->preempt_reduces(hf);
 	}
 
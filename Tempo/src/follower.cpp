@@ -0,0 +1,301 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <ctime>
+#include <fcntl.h>
+#include <poll.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/inotify.h>
+#include <ulib/util_log.h>
+#include "follower.hpp"
+
+// bytes read from the followed file at a time
+#define FOLLOW_BLOCK   (4 << 20)
+
+// polling interval if inotify is not available
+#define FOLLOW_POLL_MS 10
+
+namespace Tempo {
+
+workload_follower::workload_follower(workload_format fmt,
+				     job_tracker::pool_container_type *pools)
+	: _app(fmt, pools), _dir(false), _fd(-1), _fino(0), _off(0), _ifd(-1)
+{
+}
+
+workload_follower::~workload_follower()
+{
+	close();
+}
+
+void workload_follower::close()
+{
+	if (_fd != -1)
+		::close(_fd);
+	if (_ifd != -1)
+		::close(_ifd);
+	_fd = -1;
+	_ifd = -1;
+	_path.clear();
+	_file.clear();
+	_partial.clear();
+	_off = 0;
+}
+
+int workload_follower::open(const char *path)
+{
+	close();
+
+	struct stat st;
+	_path = path;
+	_dir = stat(path, &st) == 0 && S_ISDIR(st.st_mode);
+
+	// the directory is watched for both modes, which also reports
+	// files being created and renamed
+	std::string watch = _path;
+	if (!_dir) {
+		size_t slash = _path.rfind('/');
+		if (slash == std::string::npos)
+			watch = ".";
+		else
+			watch = slash? _path.substr(0, slash): "/";
+	}
+	if (stat(watch.c_str(), &st) || !S_ISDIR(st.st_mode)) {
+		ULIB_WARNING("cannot follow %s, %s is not a directory", path, watch.c_str());
+		close();
+		return -1;
+	}
+	_ifd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+	if (_ifd != -1 &&
+	    inotify_add_watch(_ifd, watch.c_str(), IN_MODIFY | IN_CLOSE_WRITE |
+			      IN_CREATE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) == -1) {
+		::close(_ifd);
+		_ifd = -1;
+	}
+	if (_ifd == -1)
+		ULIB_WARNING("cannot watch %s, polling for changes", watch.c_str());
+
+	return 0;
+}
+
+// Finds the file to read after the current one
+// Returns false if there is none yet.
+bool workload_follower::next_file(std::string *file) const
+{
+	struct stat st;
+
+	if (!_dir) {
+		// the name refers to a new file once the current one
+		// has been rotated away
+		if (stat(_path.c_str(), &st))
+			return false;
+		if (_fd != -1 && st.st_ino == _fino)
+			return false;
+		*file = _path;
+		return true;
+	}
+
+	DIR *d = opendir(_path.c_str());
+	if (d == NULL)
+		return false;
+	std::string cur = _file.size()? _file.substr(_path.size() + 1): "";
+	std::string best;
+	struct dirent *e;
+	while ((e = readdir(d)) != NULL) {
+		if (e->d_name[0] == '.' || (cur.size() && cur >= e->d_name) ||
+		    (best.size() && best <= e->d_name))
+			continue;
+		std::string f = _path + "/" + e->d_name;
+		if (stat(f.c_str(), &st) == 0 && S_ISREG(st.st_mode))
+			best = e->d_name;
+	}
+	closedir(d);
+	if (best.empty())
+		return false;
+	*file = _path + "/" + best;
+	return true;
+}
+
+bool workload_follower::open_next()
+{
+	std::string file;
+
+	if (!next_file(&file))
+		return false;
+	int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	struct stat st;
+	if (fd == -1 || fstat(fd, &st)) {
+		if (fd != -1)
+			::close(fd);
+		return false;
+	}
+	_fd = fd;
+	_fino = st.st_ino;
+	_file = file;
+	_off = 0;
+	_partial.clear();
+	return true;
+}
+
+// Import the whole lines appended to the current file
+// Returns the number of imported tasks, -1 on error.
+long workload_follower::read_appended()
+{
+	long total = 0;
+
+	for (;;) {
+		struct stat st;
+		if (fstat(_fd, &st)) {
+			ULIB_WARNING("cannot stat %s", _file.c_str());
+			return -1;
+		}
+		if (st.st_size < _off) {
+			ULIB_WARNING("%s has been truncated, reading it again", _file.c_str());
+			_off = 0;
+			_partial.clear();
+		}
+		if (st.st_size == _off)
+			break;
+
+		size_t keep = _partial.size();
+		size_t len = st.st_size - _off;
+		if (len > FOLLOW_BLOCK)
+			len = FOLLOW_BLOCK;
+		_partial.resize(keep + len);
+		ssize_t n = pread(_fd, &_partial[keep], len, _off);
+		if (n <= 0) {
+			_partial.resize(keep);
+			if (n < 0 && errno == EINTR)
+				continue;
+			if (n < 0) {
+				ULIB_WARNING("cannot read %s", _file.c_str());
+				return -1;
+			}
+			break;
+		}
+		_partial.resize(keep + n);
+		_off += n;
+
+		// import up to the last newline, keep the rest
+		const char *data = &_partial[0];
+		const char *nl = (const char *)memrchr(data + keep, '\n', n);
+		if (nl == NULL)
+			continue;
+		size_t used = nl + 1 - data;
+		long m = _app.append(_file.c_str(), data, used);
+		_partial.erase(_partial.begin(), _partial.begin() + used);
+		if (m < 0)
+			return -1;
+		total += m;
+	}
+
+	return total;
+}
+
+// Import the rest of the current file, including a last line without
+// a newline, and close it
+// Returns the number of imported tasks, -1 on error.
+long workload_follower::finish_file()
+{
+	long total = read_appended();
+	if (total >= 0 && _partial.size()) {
+		long m = _app.append(_file.c_str(), &_partial[0], _partial.size());
+		total = m < 0? -1: total + m;
+	}
+	_partial.clear();
+	::close(_fd);
+	_fd = -1;
+	return total;
+}
+
+// Read the current file and move on to the next ones
+long workload_follower::update()
+{
+	long total = 0;
+	std::string file;
+
+	for (;;) {
+		if (_fd == -1 && !open_next())
+			break;
+		long n = read_appended();
+		if (n < 0)
+			return -1;
+		total += n;
+		if (!next_file(&file))
+			break;
+		// the writer has moved on, take what is left
+		if ((n = finish_file()) < 0)
+			return -1;
+		total += n;
+	}
+
+	return total;
+}
+
+void workload_follower::wait(int timeout_ms)
+{
+	if (_ifd == -1) {
+		if (timeout_ms < 0 || timeout_ms > FOLLOW_POLL_MS)
+			timeout_ms = FOLLOW_POLL_MS;
+		usleep(timeout_ms * 1000);
+		return;
+	}
+
+	struct pollfd pfd;
+	pfd.fd = _ifd;
+	pfd.events = POLLIN;
+	if (::poll(&pfd, 1, timeout_ms) > 0) {
+		// the events only wake us up, what changed is checked
+		// by reading
+		char buf[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+		while (read(_ifd, buf, sizeof(buf)) > 0)
+			;
+	}
+}
+
+static long elapsed_ms(const struct timespec &since)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (now.tv_sec - since.tv_sec) * 1000 +
+		(now.tv_nsec - since.tv_nsec) / 1000000;
+}
+
+long workload_follower::poll(int timeout_ms)
+{
+	if (_path.empty())
+		return -1;
+
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+	for (;;) {
+		long n = update();
+		if (n != 0)
+			return n;
+		int left = -1;
+		if (timeout_ms >= 0) {
+			long spent = elapsed_ms(start);
+			if (spent >= timeout_ms)
+				return 0;
+			left = timeout_ms - spent;
+		}
+		wait(left);
+	}
+}
+
+}
@@ -13,6 +13,8 @@
  */
 
 #include <cstdio>
+#include <cstdlib>
+#include <cmath>
 #include <stdint.h>
 #include <cstring>
 #include <vector>
@@ -23,7 +25,10 @@
 #include <ulib/util_log.h>
 #include "job.hpp"
 #include "pool.hpp"
+#include "selector.hpp"
 #include "helper.hpp"
+#include "importer.hpp"
+#include "workload_file.hpp"
 
 namespace Tempo {
 
@@ -31,9 +36,10 @@ void print_pool_settings(const job_tracker::pool_container_type &pools)
 {
 	for (job_tracker::pool_container_type::const_iterator it = pools.begin();
 	     it != pools.end(); ++it) {
-		printf("Pool name = %s\tid = %016lx\tnjobs = %zu\tsched = %s\n",
+		printf("Pool name = %s\tid = %016lx\tnjobs = %zu\tsched = %s\tparent = %s\n",
 		       it->name.c_str(), it->id, it->jobs.size(),
-		       it->sched == pool::SCHED_FAIR? "FAIR": "FCFS");
+		       selector::get_policy(it->sched)->name,
+		       it->parent? it->parent->name.c_str(): "-");
 		printf("\tw = %lf\tm = %lf\td = %d\tmt = %lf\tft = %lf\n",
 		       it->fs_ctx_map.weight, it->fs_ctx_map.minshare, it->fs_ctx_map.demand,
 		       it->ms_timeout, it->hf_timeout);
@@ -67,23 +73,10 @@ void show_progress(double map, double reduce)
 		(int)(map * 100), mbar,	(int)(reduce * 100), rbar);
 }
 
-double compute_utilization(
-	const job_tracker::pool_container_type &pools,
-	task::task_type type, int nslots)
+// Effective utilization from the start (positive) and finish
+// (negative) times of tasks
+static double utilization_of(std::vector<ut_pt> &points, int nslots)
 {
-	std::vector<ut_pt> points;
-
-	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
-	     pit != pools.end(); ++pit) {
-		for (pool::job_container_type::const_iterator jit = pit->jobs.begin();
-		     jit != pit->jobs.end(); ++jit) {
-			for (job::task_container_type::const_iterator tit = jit->tasks[type].begin();
-			     tit != jit->tasks[type].end(); ++tit) {
-				points.push_back(tit->stime);
-				points.push_back(-tit->ftime);
-			}
-		}
-	}
 	if (points.size() == 0) {
 		ULIB_DEBUG("no task, use default utilization 0");
 		return 0;
@@ -123,6 +116,26 @@ double compute_utilization(
 	return util / (last - first) / nslots;
 }
 
+double compute_utilization(
+	const job_tracker::pool_container_type &pools,
+	task::task_type type, int nslots)
+{
+	std::vector<ut_pt> points;
+
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		for (pool::job_container_type::const_iterator jit = pit->jobs.begin();
+		     jit != pit->jobs.end(); ++jit) {
+			for (job::task_container_type::const_iterator tit = jit->tasks[type].begin();
+			     tit != jit->tasks[type].end(); ++tit) {
+				points.push_back(tit->stime);
+				points.push_back(-tit->ftime);
+			}
+		}
+	}
+	return utilization_of(points, nslots);
+}
+
 double compute_utilization(const pool &p, task::task_type type, int nslots)
 {
 	std::vector<ut_pt> points;
@@ -135,238 +148,138 @@ double compute_utilization(const pool &p, task::task_type type, int nslots)
 			points.push_back(-tit->ftime);
 		}
 	}
-	if (points.size() == 0) {
-		ULIB_DEBUG("no task, use default utilization 0");
-		return 0;
-	}
-	if (points.size() & 1) {
-		ULIB_FATAL("expect even number of points, got %zu", points.size());
-		return -1;
-	}
-	heap_init_ut(&*points.begin(), &*points.end());
-
-	double first = points.begin()->time;
-	double last  = first < 0? -first: first;
-	double util  = 0;
-	int    in    = first < 0? -1: 1;
-	heap_pop_to_rear_ut(&*points.begin(), &*points.end());
-	points.pop_back();
-	do {
-		double t = points.begin()->time;
-		double s = t < 0? -t: t;
-		if ((in < 0 || in > nslots) && !double_equal(s, last))
-			ULIB_FATAL("used slots(%d) is illegal between %f and %f", in, last, s);
-		util += in * (s - last);
-		if (t < 0)
-			--in;
-		else
-			++in;
-		last = s;
-		heap_pop_to_rear_ut(&*points.begin(), &*points.end());
-		points.pop_back();
-	} while (points.size());
-
-	if (in) {
-		ULIB_FATAL("used slots(%d) should be zero in the end", in);
-		return -1;
-	}
-
-	return util / (last - first) / nslots;
+	return utilization_of(points, nslots);
 }
 
 int import_workload(const char *file, job_tracker::pool_container_type *pools)
 {
-	// Sample line:
-	// modeling job_201405200258_257255:HIGH task_201405200258_257255_m_021770
-	// MAP 1403620325026 1403620325033 1403620344772
-
-	FILE *fp = fopen(file, "r");
-	if (fp == NULL) {
-		ULIB_WARNING("cannot open %s for reading", file);
-		return -1;
-	}
-
-	ulib::open_hash_map<uint64_t, pool *> pmap;
-	ulib::open_hash_map<uint64_t, job  *> jmap;
-
-	for (job_tracker::pool_container_type::iterator pit = pools->begin();
-	     pit != pools->end(); ++pit)
-		pmap[pit->id] = &*pit;
-
-	int ret = -1;
-	while (!ferror(fp) && !feof(fp)) {
-		char pstr[1024];
-		char jstr[1024];
-		char prio[16];
-		char tstr[1024];
-		char type[16];
-		double ctime, stime, ftime;
-		if (fscanf(fp, "%[^\t]\t%[^:]:%[^\t]\t%[^\t]\t%[^\t]\t%lf\t%lf\t%lf\n",
-			   pstr, jstr, prio, tstr, type, &ctime, &stime, &ftime) != 8) {
-			ULIB_WARNING("Error encounterred while parsing a line");
-			goto done;
-		}
-		uint64_t pid = pool::id_from_str(pstr);
-		pool *p = pmap[pid];
-		if (p == NULL) {
-			ULIB_FATAL("pool %s has not been configured", pstr);
-			goto done;
-		}
-		uint64_t jid = job::id_from_str(jstr);
-		job *j = jmap[jid];
-		if (j == NULL) {
-			job nj;
-			nj.id = jid;
-			nj.ctime = ctime;
-			nj.ftime = -1;
-			nj.fs_ctx_map.uid = jid;
-			nj.fs_ctx_reduce.uid = jid;
-			j = &p->add_job(nj);
-			jmap[jid] = j;
-		} else if (j->ctime > ctime)
-			j->ctime = ctime;
-		double jw;
-		if (strcmp("NORMAL", prio) == 0)
-			jw = 1.0;
-		else if (strcmp("HIGH", prio) == 0)
-			jw = 2.0;
-		else if (strcmp("VERY_HIGH", prio) == 0)
-			jw = 4.0;
-		else {
-			ULIB_WARNING("job priority unrecognized:%s", prio);
-			goto done;
-		}
-		j->fs_ctx_map.weight = jw;
-		j->fs_ctx_reduce.weight = jw;
-		task t;
-		t.id = task::id_from_str(tstr);
-		t.ctime = ctime;
-		t.stime = stime;
-		t.ftime = ftime;
-		t.ptime = ftime - stime;
-		t.type = strcmp("MAP", type) == 0? task::TASK_TYPE_MAP: task::TASK_TYPE_REDUCE;
-		j->tasks[t.type].push_back(t);
-	}
-
-	ret = 0;
-done:
-	fclose(fp);
-	return ret;
+	if (workload_file::is_binary(file))
+		return import_binary_workload(file, pools);
+	if (is_dataset_table(file))
+		return import_dataset(file, pools);
+	return import_text_workload(file, WORKLOAD_STIME_FTIME, pools);
 }
 
 // Support ptime instead of stime and ftime
 int import_workload1(const char *file, job_tracker::pool_container_type *pools)
 {
-	// Sample line:
-	// modeling job_201405200258_257255:HIGH task_201405200258_257255_m_021770
-	// MAP 1403620325026 1024
+	if (workload_file::is_binary(file))
+		return import_binary_workload(file, pools);
+	if (is_dataset_table(file))
+		return import_dataset1(file, pools);
+	return import_text_workload(file, WORKLOAD_PTIME, pools);
+}
 
-	FILE *fp = fopen(file, "r");
-	if (fp == NULL) {
-		ULIB_WARNING("cannot open %s for reading", file);
-		return -1;
-	}
+int import_dataset(const char *file, job_tracker::pool_container_type *pools)
+{
+	return import_text_workload(file, WORKLOAD_DATASET, pools);
+}
 
-	ulib::open_hash_map<uint64_t, pool *> pmap;
-	ulib::open_hash_map<uint64_t, job  *> jmap;
+int import_dataset1(const char *file, job_tracker::pool_container_type *pools)
+{
+	return import_text_workload(file, WORKLOAD_DATASET_PTIME, pools);
+}
 
-	for (job_tracker::pool_container_type::iterator pit = pools->begin();
-	     pit != pools->end(); ++pit)
-		pmap[pit->id] = &*pit;
+const char *name_or_id(const char *name, uint64_t id, char *buf)
+{
+	if (name)
+		return name;
+	snprintf(buf, 17, "%016lx", id);
+	return buf;
+}
 
-	int ret = -1;
-	while (!ferror(fp) && !feof(fp)) {
-		char pstr[1024];
-		char jstr[1024];
-		char prio[16];
-		char tstr[1024];
-		char type[16];
-		double ctime, ptime;
-		if (fscanf(fp, "%[^\t]\t%[^:]:%[^\t]\t%[^\t]\t%[^\t]\t%lf\t%lf\n",
-			   pstr, jstr, prio, tstr, type, &ctime, &ptime) != 7) {
-			ULIB_WARNING("Error encounterred while parsing a line");
-			goto done;
-		}
-		uint64_t pid = pool::id_from_str(pstr);
-		pool *p = pmap[pid];
-		if (p == NULL) {
-			ULIB_FATAL("pool %s has not been configured", pstr);
-			goto done;
-		}
-		uint64_t jid = job::id_from_str(jstr);
-		job *j = jmap[jid];
-		if (j == NULL) {
-			job nj;
-			nj.id = jid;
-			nj.ctime = ctime;
-			nj.ftime = -1;
-			nj.fs_ctx_map.uid = jid;
-			nj.fs_ctx_reduce.uid = jid;
-			j = &p->add_job(nj);
-			jmap[jid] = j;
-		} else if (j->ctime > ctime)
-			j->ctime = ctime;
-		double jw;
-		if (strcmp("NORMAL", prio) == 0)
-			jw = 1.0;
-		else if (strcmp("HIGH", prio) == 0)
-			jw = 2.0;
-		else if (strcmp("VERY_HIGH", prio) == 0)
-			jw = 4.0;
-		else {
-			ULIB_WARNING("job priority unrecognized:%s", prio);
-			goto done;
-		}
-		j->fs_ctx_map.weight = jw;
-		j->fs_ctx_reduce.weight = jw;
-		task t;
-		t.id = task::id_from_str(tstr);
-		t.ctime = ctime;
-		t.stime = -1;
-		t.ftime = -1;
-		t.ptime = ptime;
-		t.type = strcmp("MAP", type) == 0? task::TASK_TYPE_MAP: task::TASK_TYPE_REDUCE;
-		j->tasks[t.type].push_back(t);
-	}
+// Write the decimal digits of @m to @buf, returns the end
+static char *put_digits(uint64_t m, char *buf)
+{
+	char tmp[20];
+	int n = 0;
 
-	ret = 0;
-done:
-	fclose(fp);
-	return ret;
+	do {
+		tmp[n++] = '0' + m % 10;
+		m /= 10;
+	} while (m);
+	while (n)
+		*buf++ = tmp[--n];
+	return buf;
 }
 
-int export_schedule(const char *file, const job_tracker::pool_container_type &pools)
+static const uint64_t ipow10[] = {
+	1ull, 10ull, 100ull, 1000ull, 10000ull, 100000ull, 1000000ull,
+	10000000ull, 100000000ull, 1000000000ull, 10000000000ull,
+	100000000000ull, 1000000000000ull, 10000000000000ull,
+	100000000000000ull, 1000000000000000ull, 10000000000000000ull,
+	100000000000000000ull, 1000000000000000000ull, 10000000000000000000ull
+};
+
+// Write m / 10^d in plain notation without trailing zeros
+static size_t put_fraction(bool neg, uint64_t m, int d, char *buf)
 {
-	FILE *fp = fopen(file, "w");
-	if (fp == NULL) {
-		ULIB_WARNING("cannot open %s for writing", file);
-		return -1;
+	char *p = buf;
+
+	if (neg)
+		*p++ = '-';
+	p = put_digits(m / ipow10[d], p);
+	uint64_t frac = m % ipow10[d];
+	if (frac) {
+		*p++ = '.';
+		for (int k = d - 1; frac; --k) {
+			*p++ = '0' + frac / ipow10[k];
+			frac %= ipow10[k];
+		}
 	}
+	*p = '\0';
+	return p - buf;
+}
 
-	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
-	     pit != pools.end(); ++pit) {
-		for (pool::job_container_type::const_iterator jit = pit->jobs.begin();
-		     jit != pit->jobs.end(); ++jit) {
-			for (job::task_container_type::const_iterator tit = jit->tasks[task::TASK_TYPE_MAP].begin();
-			     tit != jit->tasks[task::TASK_TYPE_MAP].end(); ++tit) {
-				// pool job task type ctime ptime stime ftime
-				fprintf(fp, "%s\t%016lx:%lf\t%016lx\t%d\t%f\t%f\t%f\t%f\n",
-					pit->name.c_str(), jit->id, jit->fs_ctx_map.weight, tit->id,
-					task::TASK_TYPE_MAP, tit->ctime, tit->ptime, tit->stime, tit->ftime);
-			}
-			for (job::task_container_type::const_iterator tit = jit->tasks[task::TASK_TYPE_REDUCE].begin();
-			     tit != jit->tasks[task::TASK_TYPE_REDUCE].end(); ++tit) {
-				// pool job task type ctime ptime stime ftime
-				fprintf(fp, "%s\t%016lx:%lf\t%016lx\t%d\t%f\t%f\t%f\t%f\n",
-					pit->name.c_str(), jit->id, jit->fs_ctx_reduce.weight, tit->id,
-					task::TASK_TYPE_REDUCE, tit->ctime, tit->ptime, tit->stime, tit->ftime);
+size_t format_double(double v, char *buf)
+{
+	static const double pow10[] = {
+		1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9,
+		1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19
+	};
+	double a = v < 0? -v: v;
+
+	// Fast path: the fraction m / 10^d with the fewest digits that
+	// reads back as @a. Both m < 2^53 and 10^d are exact, so the
+	// division rounds the same way strtod() does. The rounded product
+	// may be one off the nearest m, so the neighbors are tried too.
+	if (a == 0 || (a >= 1e-3 && a < 1e15)) {
+		for (int d = 0; d < (int)(sizeof(pow10)/sizeof(pow10[0])); ++d) {
+			double s = a * pow10[d];
+			if (s >= 9007199254740992.0)
+				break;
+			uint64_t m = (uint64_t)(s + 0.5);
+			if ((double)m / pow10[d] == a) {
+				// near 2^53 two fractions may read back,
+				// take the nearer one by the exact product
+				// s + err
+				uint64_t n = s > m? m + 1: m - 1;
+				if (m >= (1ull << 51) && (double)n / pow10[d] == a) {
+					double err = fma(a, pow10[d], -s);
+					double delta = (s - m) + err;
+					if (delta > 0.5 || delta < -0.5)
+						m = n;
+				}
+				return put_fraction(v < 0, m, d, buf);
 			}
+			if (m && (double)(m - 1) / pow10[d] == a)
+				return put_fraction(v < 0, m - 1, d, buf);
+			if ((double)(m + 1) / pow10[d] == a)
+				return put_fraction(v < 0, m + 1, d, buf);
+			// no 16 digits read back, 17 always do
+			if (m >= ipow10[15])
+				return snprintf(buf, 32, "%.17g", v);
 		}
 	}
 
-	fclose(fp);
-
-	return 0;
+	// slow path for very large, very small and non-finite values
+	int n = 0;
+	for (int prec = 15; prec <= 17; ++prec) {
+		n = snprintf(buf, 32, "%.*g", prec, v);
+		if (strtod(buf, NULL) == v)
+			break;
+	}
+	return n;
 }
 
 }
@@ -54,13 +54,37 @@ void print_pool_settings(const job_tracker::pool_container_type &pools);
 
 // Import from workload generated by the parser, where each line is in the format:
 // POOL"\t"JOB:PRIORITY"\t"TASK"\t"<MAP|REDUCE>"\t"CTIME"\t"STIME"\t"FTIME
+// Binary workloads converted with convert_text_workload() and dataset
+// tables are also accepted.
 int import_workload(const char *file, job_tracker::pool_container_type *pools);
 
 // Import from workload generated by the parser, where each line is in the format:
 // POOL"\t"JOB:PRIORITY"\t"TASK"\t"<MAP|REDUCE>"\t"CTIME"\t"PTIME
+// Binary workloads converted with convert_text_workload() and dataset
+// tables are also accepted.
 int import_workload1(const char *file, job_tracker::pool_container_type *pools);
 
-int export_schedule(const char *file, const job_tracker::pool_container_type &pools);
+// Import the dataset table of the extractor directly, skipping loader.awk
+// Attempts without start or finish times are left out, as loader.awk
+// does, and so are attempts whose status is not SUCCESS, which
+// loader.awk keeps. Times are converted to seconds exactly rather than
+// rounded to milliseconds as loader.awk prints them.
+int import_dataset(const char *file, job_tracker::pool_container_type *pools);
+
+// Same as import_dataset(), but only keep the processing times as
+// import_workload1() does
+int import_dataset1(const char *file, job_tracker::pool_container_type *pools);
+
+// Returns @name, or @id in hex if @name is NULL
+// @buf must hold at least 17 characters.
+const char *name_or_id(const char *name, uint64_t id, char *buf);
+
+// Format @v with the fewest digits that read back as @v, e.g. 1.5
+// rather than 1.500000, in plain notation where it is short and %g
+// notation otherwise
+// @buf must hold at least 32 characters. Returns the length, the
+// string is NUL-terminated.
+size_t format_double(double v, char *buf);
 
 }
 
@@ -0,0 +1,91 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cmath>
+#include <cstring>
+#include "histogram.hpp"
+
+namespace Tempo {
+
+void histogram::clear()
+{
+	_count = 0;
+	_sum = 0;
+	_min = 0;
+	_max = 0;
+	memset(_buckets, 0, sizeof(_buckets));
+}
+
+size_t histogram::bucket_of(double v)
+{
+	if (!(v >= ldexp(1.0, HIST_MIN_EXP)))
+		return 0;
+	int e;
+	double f = frexp(v, &e);  // v = f * 2^e, f in [0.5, 1)
+	if (e - 1 >= HIST_MAX_EXP)
+		return HIST_NBUCKETS - 1;
+	return (e - 1 - HIST_MIN_EXP) * HIST_SUB_BUCKETS +
+		(size_t)((f * 2 - 1) * HIST_SUB_BUCKETS);
+}
+
+void histogram::add(double v)
+{
+	if (_count == 0 || v < _min)
+		_min = v;
+	if (_count == 0 || v > _max)
+		_max = v;
+	++_count;
+	_sum += v;
+	++_buckets[bucket_of(v)];
+}
+
+void histogram::merge(const histogram &other)
+{
+	if (other._count == 0)
+		return;
+	if (_count == 0 || other._min < _min)
+		_min = other._min;
+	if (_count == 0 || other._max > _max)
+		_max = other._max;
+	_count += other._count;
+	_sum += other._sum;
+	for (size_t i = 0; i < HIST_NBUCKETS; ++i)
+		_buckets[i] += other._buckets[i];
+}
+
+double histogram::quantile(double q) const
+{
+	if (_count == 0)
+		return 0;
+	uint64_t rank = (uint64_t)ceil(q * _count);
+	if (rank == 0)
+		rank = 1;
+	if (rank >= _count)
+		return _max;
+
+	size_t i = 0;
+	for (uint64_t seen = _buckets[0]; seen < rank; seen += _buckets[++i])
+		;
+	// middle of the bucket, within the observed range
+	double lo = ldexp(1.0 + (double)(i % HIST_SUB_BUCKETS) / HIST_SUB_BUCKETS,
+			  (int)(i / HIST_SUB_BUCKETS) + HIST_MIN_EXP);
+	double v = lo * (1 + 0.5 / (HIST_SUB_BUCKETS + i % HIST_SUB_BUCKETS));
+	if (v < _min)
+		return _min;
+	if (v > _max)
+		return _max;
+	return v;
+}
+
+}
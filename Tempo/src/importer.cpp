@@ -0,0 +1,1290 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <climits>
+#include <vector>
+#include <deque>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+#include <ulib/hash_open.h>
+#include <ulib/util_log.h>
+#include "importer.hpp"
+#include "workload_file.hpp"
+#include "profile.hpp"
+
+namespace Tempo {
+
+// chunks smaller than this are not worth a thread
+#define IMPORT_MIN_CHUNK (1 << 20)
+
+// columns of the dataset table
+#define DATASET_COLUMNS  16
+
+// decompressed block size of gzip inputs
+#define IMPORT_GZ_BLOCK  (4 << 20)
+
+// blocks in flight per parsing thread
+#define IMPORT_GZ_QUEUE  2
+
+typedef ulib::open_hash_map<uint64_t, pool *> pool_index_type;
+
+// a job as seen within one chunk
+struct chunk_job {
+	uint64_t id;
+	const char *name; // job name in the chunk text
+	uint32_t name_len;
+	pool    *owner;   // pool of the first line of the job
+	double   ctime;   // earliest task creation time
+	double   weight;  // weight given by the last line
+};
+
+// a task and the index of its job in the chunk
+struct chunk_task {
+	size_t jidx;
+	task   t;
+	const char *name; // task name in the chunk text
+	uint32_t name_len;
+};
+
+// parsing state and result of one chunk
+// Names in jobs and tasks point into the chunk text and are only
+// valid while it is, or into the names of the chunk once detached.
+struct chunk_ctx {
+	const char *begin;
+	const char *end;
+	workload_format fmt;
+	const pool_index_type *pmap;
+	std::vector<chunk_job>  jobs;   // in order of first appearance
+	std::vector<chunk_task> tasks;  // in file order
+	size_t nlines;  // lines before the current one
+	int    ret;
+	char   err[256];
+	string_table names;  // copies of the names once the text is gone
+};
+
+// chunks in file order, elements never move once added
+typedef std::deque<chunk_ctx> chunk_list;
+
+// exact powers of ten for the fast number path
+static const double g_pow10[] = {
+	1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+	1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+// Returns the position of @delim on the current line, NULL if absent
+static inline const char *scan_field(const char *p, const char *end, char delim)
+{
+	for (; p < end; ++p) {
+		if (*p == delim)
+			return p;
+		if (*p == '\n')
+			return NULL;
+	}
+	return NULL;
+}
+
+// Parse a number the way strtod() does
+// Decimals with at most 15 significant digits and no exponent are
+// converted with a single rounding, which gives the same result as
+// strtod(); anything else is handed to strtod().
+// Returns the position after the number, NULL if there is none.
+static const char *scan_double(const char *s, const char *end, double *v)
+{
+	while (s < end && *s == ' ')
+		++s;
+
+	const char *p = s;
+	bool neg = false;
+	if (p < end && (*p == '-' || *p == '+'))
+		neg = *p++ == '-';
+
+	uint64_t m = 0;
+	int ndigits = 0;
+	int nfrac = 0;
+	for (; p < end && *p >= '0' && *p <= '9'; ++p, ++ndigits)
+		m = m * 10 + (*p - '0');
+	if (p < end && *p == '.') {
+		for (++p; p < end && *p >= '0' && *p <= '9'; ++p, ++ndigits, ++nfrac)
+			m = m * 10 + (*p - '0');
+	}
+	if (ndigits > 0 && ndigits <= 15 &&
+	    !(p < end && (*p == 'e' || *p == 'E' || *p == 'x' || *p == 'X'))) {
+		double d = (double)m;
+		if (nfrac)
+			d /= g_pow10[nfrac];
+		*v = neg? -d: d;
+		return p;
+	}
+
+	// slow path
+	char buf[64];
+	size_t len = 0;
+	for (p = s; p < end && len < sizeof(buf) - 1 &&
+		     *p != '\t' && *p != '\n'; ++p)
+		buf[len++] = *p;
+	buf[len] = '\0';
+	char *stop;
+	*v = strtod(buf, &stop);
+	if (stop == buf)
+		return NULL;
+	return s + (stop - buf);
+}
+
+static int parse_priority(const char *p, size_t len, double *w)
+{
+	if (len == 6 && memcmp(p, "NORMAL", 6) == 0)
+		*w = 1.0;
+	else if (len == 4 && memcmp(p, "HIGH", 4) == 0)
+		*w = 2.0;
+	else if (len == 9 && memcmp(p, "VERY_HIGH", 9) == 0)
+		*w = 4.0;
+	else
+		return -1;
+	return 0;
+}
+
+// fields of one workload line
+struct line_fields {
+	const char *pool;
+	size_t      pool_len;
+	const char *job;
+	size_t      job_len;
+	const char *prio;
+	size_t      prio_len;
+	const char *task;
+	size_t      task_len;
+	bool        reduce;
+	double      ctime;
+	double      stime;  // -1 if not given
+	double      ftime;  // -1 if not given
+	double      ptime;
+};
+
+// Returns the position after the white spaces ending a line, NULL if
+// anything else follows
+static const char *scan_eol(const char *q, const char *end)
+{
+	while (q < end && (*q == ' ' || *q == '\t' || *q == '\r'))
+		++q;
+	return q < end && *q != '\n'? NULL: q;
+}
+
+// Scan a line of the WORKLOAD_STIME_FTIME or WORKLOAD_PTIME format
+// Returns the end of the line, NULL on error.
+static const char *scan_workload_line(chunk_ctx *ctx, const char *p, line_fields *lf)
+{
+	const char *end = ctx->end;
+	const char *f1 = scan_field(p, end, '\t');
+	const char *f2 = f1? scan_field(f1 + 1, end, ':'): NULL;
+	const char *f3 = f2? scan_field(f2 + 1, end, '\t'): NULL;
+	const char *f4 = f3? scan_field(f3 + 1, end, '\t'): NULL;
+	const char *f5 = f4? scan_field(f4 + 1, end, '\t'): NULL;
+	if (f5 == NULL) {
+		snprintf(ctx->err, sizeof(ctx->err), "missing fields");
+		return NULL;
+	}
+	double t1, t2 = 0;
+	const char *q = scan_double(f5 + 1, end, &lf->ctime);
+	if (q && q < end && *q == '\t')
+		q = scan_double(q + 1, end, &t1);
+	else
+		q = NULL;
+	if (q && ctx->fmt == WORKLOAD_STIME_FTIME) {
+		if (q < end && *q == '\t')
+			q = scan_double(q + 1, end, &t2);
+		else
+			q = NULL;
+	}
+	if (q == NULL) {
+		snprintf(ctx->err, sizeof(ctx->err), "malformed time fields");
+		return NULL;
+	}
+	if ((q = scan_eol(q, end)) == NULL) {
+		snprintf(ctx->err, sizeof(ctx->err), "trailing characters");
+		return NULL;
+	}
+
+	lf->pool = p;
+	lf->pool_len = f1 - p;
+	lf->job = f1 + 1;
+	lf->job_len = f2 - f1 - 1;
+	lf->prio = f2 + 1;
+	lf->prio_len = f3 - f2 - 1;
+	lf->task = f3 + 1;
+	lf->task_len = f4 - f3 - 1;
+	lf->reduce = !(f5 - f4 - 1 == 3 && memcmp(f4 + 1, "MAP", 3) == 0);
+	if (ctx->fmt == WORKLOAD_STIME_FTIME) {
+		lf->stime = t1;
+		lf->ftime = t2;
+		lf->ptime = t2 - t1;
+	} else {
+		lf->stime = -1;
+		lf->ftime = -1;
+		lf->ptime = t1;
+	}
+	return q;
+}
+
+// Scan a row of the WORKLOAD_DATASET and WORKLOAD_DATASET_PTIME formats
+// Attempts that did not succeed or lack a start or finish time are
+// skipped by setting *skip.
+// Returns the end of the line, NULL on error.
+static const char *scan_dataset_line(chunk_ctx *ctx, const char *p,
+				     line_fields *lf, bool *skip)
+{
+	const char *end = ctx->end;
+	const char *f[DATASET_COLUMNS];  // the tab ending each column
+
+	f[0] = scan_field(p, end, '\t');
+	for (int i = 1; i < DATASET_COLUMNS - 1 && f[i - 1]; ++i)
+		f[i] = scan_field(f[i - 1] + 1, end, '\t');
+	if (f[DATASET_COLUMNS - 2] == NULL) {
+		snprintf(ctx->err, sizeof(ctx->err), "missing columns");
+		return NULL;
+	}
+	// the status ends the line
+	const char *status = f[DATASET_COLUMNS - 2] + 1;
+	const char *q = status;
+	while (q < end && *q != '\n' && *q != '\t' && *q != ' ' && *q != '\r')
+		++q;
+	size_t status_len = q - status;
+	if ((q = scan_eol(q, end)) == NULL) {
+		snprintf(ctx->err, sizeof(ctx->err), "trailing characters");
+		return NULL;
+	}
+
+	// times are in milliseconds, an empty time counts as zero
+	double launch = 0, start = 0, finish = 0;
+	if ((f[6] - f[5] > 1 && scan_double(f[5] + 1, f[6], &launch) == NULL) ||
+	    (f[13] - f[12] > 1 && scan_double(f[12] + 1, f[13], &start) == NULL) ||
+	    (f[14] - f[13] > 1 && scan_double(f[13] + 1, f[14], &finish) == NULL)) {
+		snprintf(ctx->err, sizeof(ctx->err), "malformed time columns");
+		return NULL;
+	}
+	*skip = start == 0 || finish == 0 ||
+		!(status_len == 7 && memcmp(status, "SUCCESS", 7) == 0);
+	if (*skip)
+		return q;
+
+	lf->job = p;
+	lf->job_len = f[0] - p;
+	lf->pool = f[0] + 1;
+	lf->pool_len = f[1] - f[0] - 1;
+	lf->prio = f[1] + 1;
+	lf->prio_len = f[2] - f[1] - 1;
+	lf->task = f[10] + 1;
+	lf->task_len = f[11] - f[10] - 1;
+	lf->reduce = f[12] - f[11] - 1 == 6 && memcmp(f[11] + 1, "REDUCE", 6) == 0;
+	lf->ctime = launch / 1000;
+	if (ctx->fmt == WORKLOAD_DATASET) {
+		lf->stime = start / 1000;
+		lf->ftime = finish / 1000;
+		lf->ptime = lf->ftime - lf->stime;
+	} else {
+		lf->stime = -1;
+		lf->ftime = -1;
+		lf->ptime = (finish - start) / 1000;
+	}
+	return q;
+}
+
+static void *parse_chunk(void *arg)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_IMPORT);
+	chunk_ctx *ctx = (chunk_ctx *)arg;
+	ulib::open_hash_map<uint64_t, size_t> jmap;
+	const char *end = ctx->end;
+	const char *pname = NULL;  // pool name of the previous line
+	size_t plen = 0;
+	pool  *last_pool = NULL;
+	size_t last_jidx = (size_t)-1;
+	line_fields lf;
+
+	ctx->ret = -1;
+	ctx->nlines = 0;
+	for (const char *p = ctx->begin; p < end; ) {
+		// skip blank lines and leading white spaces
+		if (*p == '\n') {
+			++ctx->nlines;
+			++p;
+			continue;
+		}
+		if (*p == ' ' || *p == '\t' || *p == '\r') {
+			++p;
+			continue;
+		}
+
+		const char *q;
+		if (ctx->fmt == WORKLOAD_DATASET || ctx->fmt == WORKLOAD_DATASET_PTIME) {
+			bool skip;
+			q = scan_dataset_line(ctx, p, &lf, &skip);
+			if (q && skip) {
+				p = q;
+				continue;
+			}
+		} else
+			q = scan_workload_line(ctx, p, &lf);
+		if (q == NULL)
+			return NULL;
+
+		// consecutive lines mostly share the pool and the job
+		if (pname == NULL || plen != lf.pool_len || memcmp(pname, lf.pool, plen)) {
+			pool_index_type::const_iterator pit =
+				ctx->pmap->find(pool::id_from_str(lf.pool, lf.pool_len));
+			if (pit == ctx->pmap->end()) {
+				snprintf(ctx->err, sizeof(ctx->err),
+					 "pool %.*s has not been configured",
+					 (int)lf.pool_len, lf.pool);
+				return NULL;
+			}
+			if (pit.value()->name.size() != lf.pool_len ||
+			    memcmp(pit.value()->name.data(), lf.pool, lf.pool_len)) {
+				snprintf(ctx->err, sizeof(ctx->err),
+					 "pool %.*s collides with pool %s",
+					 (int)lf.pool_len, lf.pool, pit.value()->name.c_str());
+				return NULL;
+			}
+			if (!pit.value()->is_leaf()) {
+				snprintf(ctx->err, sizeof(ctx->err),
+					 "pool %.*s has child pools, jobs must go to a leaf pool",
+					 (int)lf.pool_len, lf.pool);
+				return NULL;
+			}
+			pname = lf.pool;
+			plen = lf.pool_len;
+			last_pool = pit.value();
+		}
+		double jw;
+		if (parse_priority(lf.prio, lf.prio_len, &jw)) {
+			snprintf(ctx->err, sizeof(ctx->err), "job priority unrecognized:%.*s",
+				 (int)lf.prio_len, lf.prio);
+			return NULL;
+		}
+		// the name is only hashed when the job changes
+		if (last_jidx == (size_t)-1 || ctx->jobs[last_jidx].name_len != lf.job_len ||
+		    memcmp(ctx->jobs[last_jidx].name, lf.job, lf.job_len)) {
+			uint64_t jid = job::id_from_str(lf.job, lf.job_len);
+			ulib::open_hash_map<uint64_t, size_t>::iterator jit = jmap.find(jid);
+			if (jit == jmap.end()) {
+				chunk_job cj;
+				cj.id = jid;
+				cj.name = lf.job;
+				cj.name_len = lf.job_len;
+				cj.owner = last_pool;
+				cj.ctime = lf.ctime;
+				ctx->jobs.push_back(cj);
+				jit = jmap.insert(jid, ctx->jobs.size() - 1);
+			} else {
+				const chunk_job &cj = ctx->jobs[jit.value()];
+				if (cj.name_len != lf.job_len || memcmp(cj.name, lf.job, lf.job_len)) {
+					snprintf(ctx->err, sizeof(ctx->err),
+						 "job %.*s collides with job %.*s",
+						 (int)lf.job_len, lf.job, (int)cj.name_len, cj.name);
+					return NULL;
+				}
+			}
+			last_jidx = jit.value();
+		}
+		chunk_job &cj = ctx->jobs[last_jidx];
+		if (cj.ctime > lf.ctime)
+			cj.ctime = lf.ctime;
+		cj.weight = jw;
+
+		chunk_task ct;
+		ct.jidx = last_jidx;
+		ct.t.id = task::id_from_str(lf.task, lf.task_len);
+		ct.name = lf.task;
+		ct.name_len = lf.task_len;
+		ct.t.ctime = lf.ctime;
+		ct.t.stime = lf.stime;
+		ct.t.ftime = lf.ftime;
+		ct.t.ptime = lf.ptime;
+		ct.t.type = lf.reduce? task::TASK_TYPE_REDUCE: task::TASK_TYPE_MAP;
+		ctx->tasks.push_back(ct);
+
+		p = q;
+	}
+
+	ctx->ret = 0;
+	return NULL;
+}
+
+struct job_loc {
+	pool  *owner;
+	size_t idx;  // index in owner->jobs
+};
+
+typedef ulib::open_hash_map<uint64_t, job_loc> job_index_type;
+
+// Move the parsed chunks into the pools, in file order
+// Names are interned into the pools as jobs are created. Jobs in
+// @jobs_index are continued and new jobs are added to it.
+// Returns 0 on success, -1 if two job names share an id.
+static int merge_chunks(chunk_list &ctxs, job_index_type *jobs_index)
+{
+	job_index_type &jmap = *jobs_index;
+	std::vector< std::vector<job_loc> > locs(ctxs.size());
+
+	// create all jobs first, so that job addresses stay stable
+	for (size_t c = 0; c < ctxs.size(); ++c) {
+		std::vector<chunk_job> &jobs = ctxs[c].jobs;
+		locs[c].resize(jobs.size());
+		for (size_t k = 0; k < jobs.size(); ++k) {
+			job_index_type::iterator it = jmap.find(jobs[k].id);
+			if (it == jmap.end()) {
+				job nj;
+				nj.id = jobs[k].id;
+				nj.ctime = jobs[k].ctime;
+				nj.ftime = -1;
+				nj.fs_ctx_map.uid = jobs[k].id;
+				nj.fs_ctx_reduce.uid = jobs[k].id;
+				nj.name = jobs[k].owner->names.add(jobs[k].name, jobs[k].name_len);
+				jobs[k].owner->add_job(nj);
+				job_loc loc;
+				loc.owner = jobs[k].owner;
+				loc.idx = jobs[k].owner->jobs.size() - 1;
+				it = jmap.insert(jobs[k].id, loc);
+			}
+			job &j = it.value().owner->jobs[it.value().idx];
+			if (!it.value().owner->names.equal(j.name, jobs[k].name, jobs[k].name_len)) {
+				ULIB_WARNING("job %.*s collides with job %s",
+					     (int)jobs[k].name_len, jobs[k].name,
+					     it.value().owner->name_of(j));
+				return -1;
+			}
+			if (j.ctime > jobs[k].ctime)
+				j.ctime = jobs[k].ctime;
+			// later lines override the weight
+			j.fs_ctx_map.weight = jobs[k].weight;
+			j.fs_ctx_reduce.weight = jobs[k].weight;
+			locs[c][k] = it.value();
+		}
+	}
+
+	for (size_t c = 0; c < ctxs.size(); ++c) {
+		std::vector<chunk_task> &tasks = ctxs[c].tasks;
+		for (size_t i = 0; i < tasks.size(); ++i) {
+			const job_loc &loc = locs[c][tasks[i].jidx];
+			task &t = tasks[i].t;
+			t.name = loc.owner->names.add(tasks[i].name, tasks[i].name_len);
+			loc.owner->jobs[loc.idx].tasks[t.type].push_back(t);
+		}
+		std::vector<chunk_task>().swap(tasks);
+		string_table().swap(ctxs[c].names);
+	}
+
+	return 0;
+}
+
+// Map a whole file, returns NULL on failure
+static const char *map_file(const char *file, size_t *size)
+{
+	int fd = open(file, O_RDONLY);
+	if (fd == -1) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return NULL;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || st.st_size == 0) {
+		ULIB_WARNING("cannot read %s or it is empty", file);
+		close(fd);
+		return NULL;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (data == MAP_FAILED) {
+		ULIB_WARNING("cannot map %s", file);
+		return NULL;
+	}
+	*size = st.st_size;
+	return (const char *)data;
+}
+
+// Report the first chunk that failed to parse, the chunks start at
+// line @first_line of @file
+// Returns 0 if all chunks were parsed, -1 otherwise.
+static int check_chunks(const char *file, const chunk_list &ctxs,
+			size_t first_line = 0)
+{
+	size_t line = first_line;
+	for (size_t i = 0; i < ctxs.size(); ++i) {
+		const chunk_ctx &ctx = ctxs[i];
+		if (ctx.ret) {
+			ULIB_WARNING("Error encounterred while parsing line %zu of %s: %s",
+				     line + ctx.nlines + 1, file, ctx.err);
+			return -1;
+		}
+		line += ctx.nlines;
+	}
+
+	return 0;
+}
+
+// Parse a mapped text workload into newline-aligned chunks
+// Returns 0 on success, -1 otherwise.
+static int parse_text(const char *file, const char *data, size_t size,
+		      workload_format fmt, const pool_index_type *pmap,
+		      int nthreads, chunk_list *ctxs, size_t first_line = 0)
+{
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+	if ((size_t)nthreads > size / IMPORT_MIN_CHUNK + 1)
+		nthreads = size / IMPORT_MIN_CHUNK + 1;
+
+	// split into newline-aligned chunks
+	ctxs->resize(nthreads);
+	const char *pos = data;
+	for (int i = 0; i < nthreads; ++i) {
+		const char *cend = data + size;
+		if (i < nthreads - 1) {
+			cend = data + size / nthreads * (i + 1);
+			if (cend < pos)
+				cend = pos;
+			const char *nl = (const char *)memchr(cend, '\n', data + size - cend);
+			cend = nl? nl + 1: data + size;
+		}
+		chunk_ctx &ctx = (*ctxs)[i];
+		ctx.begin = pos;
+		ctx.end = cend;
+		ctx.fmt = fmt;
+		ctx.pmap = pmap;
+		ctx.err[0] = '\0';
+		pos = cend;
+	}
+
+	// the calling thread takes the first chunk
+	std::vector<pthread_t> tids(nthreads);
+	std::vector<bool> started(nthreads, false);
+	for (int i = 1; i < nthreads; ++i)
+		started[i] = pthread_create(&tids[i], NULL, parse_chunk, &(*ctxs)[i]) == 0;
+	parse_chunk(&(*ctxs)[0]);
+	for (int i = 1; i < nthreads; ++i) {
+		if (started[i])
+			pthread_join(tids[i], NULL);
+		else
+			parse_chunk(&(*ctxs)[i]);
+	}
+
+	return check_chunks(file, *ctxs, first_line);
+}
+
+// Returns true if @file starts with the gzip magic
+static bool is_gzip(const char *file)
+{
+	unsigned char magic[2];
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+		return false;
+	bool ret = fread(magic, sizeof(magic), 1, fp) == 1 &&
+		magic[0] == 0x1f && magic[1] == 0x8b;
+	fclose(fp);
+	return ret;
+}
+
+// Returns true and reports the error if decompression failed, which
+// includes a truncated stream
+static bool gz_failed(const char *file, gzFile gz)
+{
+	int err;
+	const char *msg = gzerror(gz, &err);
+	if (err == Z_OK)
+		return false;
+	ULIB_WARNING("cannot decompress %s: %s", file, msg);
+	return true;
+}
+
+// a decompressed run of whole lines and the chunk to parse it into
+struct text_block {
+	char      *data;  // malloc'ed, freed once parsed
+	size_t     len;
+	chunk_ctx *ctx;
+};
+
+// Bounded FIFO between the decompressing and the parsing threads
+class block_queue
+{
+public:
+	block_queue(size_t cap)
+		: _cap(cap), _closed(false), _aborted(false)
+	{
+		pthread_mutex_init(&_lock, NULL);
+		pthread_cond_init(&_not_empty, NULL);
+		pthread_cond_init(&_not_full, NULL);
+	}
+
+	~block_queue()
+	{
+		pthread_cond_destroy(&_not_full);
+		pthread_cond_destroy(&_not_empty);
+		pthread_mutex_destroy(&_lock);
+	}
+
+	// Blocks while the queue is full
+	// Returns false if the consumers gave up, the block is not queued.
+	bool push(const text_block &b)
+	{
+		pthread_mutex_lock(&_lock);
+		while (_blocks.size() >= _cap && !_aborted)
+			pthread_cond_wait(&_not_full, &_lock);
+		bool ok = !_aborted;
+		if (ok) {
+			_blocks.push_back(b);
+			pthread_cond_signal(&_not_empty);
+		}
+		pthread_mutex_unlock(&_lock);
+		return ok;
+	}
+
+	// Blocks while the queue is empty and open
+	// Returns false once the queue is closed and drained.
+	bool pop(text_block *b)
+	{
+		pthread_mutex_lock(&_lock);
+		while (_blocks.empty() && !_closed)
+			pthread_cond_wait(&_not_empty, &_lock);
+		bool ok = !_blocks.empty();
+		if (ok) {
+			*b = _blocks.front();
+			_blocks.pop_front();
+			pthread_cond_signal(&_not_full);
+		}
+		pthread_mutex_unlock(&_lock);
+		return ok;
+	}
+
+	// no more blocks will be pushed
+	void close()
+	{
+		pthread_mutex_lock(&_lock);
+		_closed = true;
+		pthread_cond_broadcast(&_not_empty);
+		pthread_mutex_unlock(&_lock);
+	}
+
+	// stop the producer, queued blocks are still handed out
+	void abort()
+	{
+		pthread_mutex_lock(&_lock);
+		_aborted = true;
+		pthread_cond_broadcast(&_not_full);
+		pthread_mutex_unlock(&_lock);
+	}
+
+private:
+	pthread_mutex_t _lock;
+	pthread_cond_t  _not_empty;
+	pthread_cond_t  _not_full;
+	std::deque<text_block> _blocks;
+	size_t _cap;
+	bool   _closed;
+	bool   _aborted;
+};
+
+// Copy the names of a parsed chunk out of its text
+static void detach_names(chunk_ctx *ctx)
+{
+	size_t n = 0;
+	for (size_t i = 0; i < ctx->jobs.size(); ++i)
+		n += ctx->jobs[i].name_len + 1;
+	for (size_t i = 0; i < ctx->tasks.size(); ++i)
+		n += ctx->tasks[i].name_len + 1;
+	// the arena is not reallocated after this
+	ctx->names.reserve(ctx->names.size() + n);
+	for (size_t i = 0; i < ctx->jobs.size(); ++i) {
+		chunk_job &cj = ctx->jobs[i];
+		cj.name = ctx->names.str(ctx->names.add(cj.name, cj.name_len));
+	}
+	for (size_t i = 0; i < ctx->tasks.size(); ++i) {
+		chunk_task &ct = ctx->tasks[i];
+		ct.name = ctx->names.str(ctx->names.add(ct.name, ct.name_len));
+	}
+}
+
+static void parse_block(const text_block &b)
+{
+	b.ctx->begin = b.data;
+	b.ctx->end = b.data + b.len;
+	parse_chunk(b.ctx);
+	if (b.ctx->ret == 0)
+		detach_names(b.ctx);
+	free(b.data);
+}
+
+static void *parse_blocks(void *arg)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_IMPORT);
+	block_queue *q = (block_queue *)arg;
+	text_block b;
+
+	while (q->pop(&b)) {
+		parse_block(b);
+		// chunks before the failed one are still parsed to
+		// locate the error
+		if (b.ctx->ret)
+			q->abort();
+	}
+	return NULL;
+}
+
+// Read the whole gzip file into memory, returns NULL on failure
+static char *read_gzip(const char *file, size_t *size)
+{
+	gzFile gz = gzopen(file, "rb");
+	if (gz == NULL) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return NULL;
+	}
+	size_t cap = IMPORT_GZ_BLOCK;
+	size_t len = 0;
+	char *buf = (char *)malloc(cap);
+	for (;;) {
+		if (buf && len == cap)
+			buf = (char *)realloc(buf, cap *= 2);
+		if (buf == NULL) {
+			ULIB_WARNING("out of memory while decompressing %s", file);
+			gzclose(gz);
+			return NULL;
+		}
+		int n = gzread(gz, buf + len, cap - len > INT_MAX? INT_MAX: cap - len);
+		if (n <= 0 && gz_failed(file, gz)) {
+			gzclose(gz);
+			free(buf);
+			return NULL;
+		}
+		if (n == 0)
+			break;
+		len += n;
+	}
+	gzclose(gz);
+	if (len == 0) {
+		ULIB_WARNING("cannot read %s or it is empty", file);
+		free(buf);
+		return NULL;
+	}
+	*size = len;
+	return buf;
+}
+
+// Stream a gzip text workload through the parsing threads
+// The calling thread decompresses the file into blocks of whole lines,
+// which are queued to nthreads parsing threads, so decompression and
+// parsing overlap. Each block becomes a chunk, in file order.
+// Returns 0 on success, -1 otherwise.
+static int parse_gzip(const char *file, workload_format fmt,
+		      const pool_index_type *pmap, int nthreads,
+		      chunk_list *ctxs)
+{
+	gzFile gz = gzopen(file, "rb");
+	if (gz == NULL) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return -1;
+	}
+	gzbuffer(gz, 1 << 18);
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+
+	block_queue q(nthreads * IMPORT_GZ_QUEUE);
+	std::vector<pthread_t> tids(nthreads);
+	int nstarted = 0;
+	for (int i = 0; i < nthreads; ++i)
+		if (pthread_create(&tids[nstarted], NULL, parse_blocks, &q) == 0)
+			++nstarted;
+
+	int ret = 0;
+	size_t total = 0;
+	size_t cap = IMPORT_GZ_BLOCK;
+	size_t len = 0;   // bytes in buf, the tail is a partial line
+	char *buf = (char *)malloc(cap);
+	for (;;) {
+		if (buf && len == cap)
+			buf = (char *)realloc(buf, cap *= 2);  // a very long line
+		if (buf == NULL) {
+			ULIB_WARNING("out of memory while decompressing %s", file);
+			ret = -1;
+			break;
+		}
+		int n = gzread(gz, buf + len, cap - len > INT_MAX? INT_MAX: cap - len);
+		if (n <= 0 && gz_failed(file, gz)) {
+			ret = -1;
+			break;
+		}
+		total += n;
+		len += n;
+		// cut after the last newline, or take the rest at the end
+		size_t cut = len;
+		if (n > 0) {
+			while (cut > 0 && buf[cut - 1] != '\n')
+				--cut;
+			if (cut == 0)
+				continue;
+		} else if (len == 0)
+			break;
+
+		char *next = NULL;
+		size_t rest = len - cut;
+		if (n > 0) {
+			size_t ncap = rest < IMPORT_GZ_BLOCK / 2? IMPORT_GZ_BLOCK: rest * 2;
+			next = (char *)malloc(ncap);
+			if (next == NULL) {
+				ULIB_WARNING("out of memory while decompressing %s", file);
+				ret = -1;
+				break;
+			}
+			memcpy(next, buf + cut, rest);
+			cap = ncap;
+		}
+
+		ctxs->push_back(chunk_ctx());
+		chunk_ctx &ctx = ctxs->back();
+		ctx.fmt = fmt;
+		ctx.pmap = pmap;
+		ctx.ret = -1;
+		ctx.nlines = 0;
+		ctx.err[0] = '\0';
+		text_block b;
+		b.data = buf;
+		b.len = cut;
+		b.ctx = &ctx;
+		buf = next;
+		len = rest;
+		if (nstarted == 0)
+			parse_block(b);
+		else if (!q.push(b)) {
+			// a parser failed, drop the rest of the file
+			ctxs->pop_back();
+			free(b.data);
+			break;
+		}
+		if (n == 0 || (nstarted == 0 && ctx.ret))
+			break;
+	}
+	free(buf);
+	gzclose(gz);
+
+	q.close();
+	for (int i = 0; i < nstarted; ++i)
+		pthread_join(tids[i], NULL);
+
+	if (ret)
+		return ret;
+	if (total == 0) {
+		ULIB_WARNING("cannot read %s or it is empty", file);
+		return -1;
+	}
+	return check_chunks(file, *ctxs);
+}
+
+bool is_dataset_table(const char *file)
+{
+	char line[4096];
+	gzFile gz = gzopen(file, "rb");  // reads plain files as well
+	if (gz == NULL)
+		return false;
+	int ntabs = 0;
+	if (gzgets(gz, line, sizeof(line))) {
+		for (const char *p = line; *p && *p != '\n'; ++p)
+			ntabs += *p == '\t';
+	}
+	gzclose(gz);
+	return ntabs == DATASET_COLUMNS - 1;
+}
+
+int import_text_workload(const char *file, workload_format fmt,
+			 job_tracker::pool_container_type *pools,
+			 int nthreads)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_IMPORT);
+	pool_index_type pmap;
+	for (job_tracker::pool_container_type::iterator pit = pools->begin();
+	     pit != pools->end(); ++pit)
+		pmap[pit->id] = &*pit;
+
+	chunk_list ctxs;
+	job_index_type jmap;
+	int ret;
+	if (is_gzip(file)) {
+		ret = parse_gzip(file, fmt, &pmap, nthreads, &ctxs);
+		if (ret == 0)
+			ret = merge_chunks(ctxs, &jmap);
+	} else {
+		size_t size;
+		const char *data = map_file(file, &size);
+		if (data == NULL)
+			return -1;
+		ret = parse_text(file, data, size, fmt, &pmap, nthreads, &ctxs);
+		// names are copied from the mapped file while merging
+		if (ret == 0)
+			ret = merge_chunks(ctxs, &jmap);
+		munmap((void *)data, size);
+	}
+
+	return ret;
+}
+
+struct workload_appender::state {
+	workload_format fmt;
+	int             nthreads;
+	pool_index_type pmap;
+	job_index_type  jmap;
+	size_t          nlines;  // lines imported so far
+};
+
+workload_appender::workload_appender(workload_format fmt,
+				     job_tracker::pool_container_type *pools,
+				     int nthreads)
+	: _st(new state)
+{
+	_st->fmt = fmt;
+	_st->nthreads = nthreads;
+	_st->nlines = 0;
+	for (job_tracker::pool_container_type::iterator pit = pools->begin();
+	     pit != pools->end(); ++pit) {
+		_st->pmap[pit->id] = &*pit;
+		for (size_t k = 0; k < pit->jobs.size(); ++k) {
+			job_loc loc;
+			loc.owner = &*pit;
+			loc.idx = k;
+			_st->jmap[pit->jobs[k].id] = loc;
+		}
+	}
+}
+
+workload_appender::~workload_appender()
+{
+	delete _st;
+}
+
+long workload_appender::append(const char *src, const char *data, size_t size)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_IMPORT);
+	chunk_list ctxs;
+
+	if (size == 0)
+		return 0;
+	if (parse_text(src, data, size, _st->fmt, &_st->pmap, _st->nthreads,
+		       &ctxs, _st->nlines))
+		return -1;
+	long ntasks = 0;
+	for (size_t i = 0; i < ctxs.size(); ++i) {
+		ntasks += ctxs[i].tasks.size();
+		_st->nlines += ctxs[i].nlines;
+	}
+	if (merge_chunks(ctxs, &_st->jmap))
+		return -1;
+
+	return ntasks;
+}
+
+static void release_text(const char *data, size_t size, bool gzip)
+{
+	if (gzip)
+		free((void *)data);
+	else
+		munmap((void *)data, size);
+}
+
+// Create a pool for every pool name in the workload, in order of
+// first appearance
+static void collect_pools(const char *data, size_t size, workload_format fmt,
+			  job_tracker::pool_container_type *pools)
+{
+	ulib::open_hash_set<uint64_t> seen;
+	const char *end = data + size;
+	const char *prev = NULL;
+	size_t plen = 0;
+
+	for (const char *p = data; p < end; ) {
+		if (*p == '\n' || *p == ' ' || *p == '\t' || *p == '\r') {
+			++p;
+			continue;
+		}
+		// the pool is the second column of the dataset table
+		const char *name = p;
+		if (fmt == WORKLOAD_DATASET || fmt == WORKLOAD_DATASET_PTIME) {
+			const char *tab = scan_field(p, end, '\t');
+			name = tab? tab + 1: NULL;
+		}
+		const char *tab = name? scan_field(name, end, '\t'): NULL;
+		if (tab && (prev == NULL || plen != (size_t)(tab - name) ||
+			    memcmp(prev, name, plen))) {
+			uint64_t id = pool::id_from_str(name, tab - name);
+			if (!seen.contain(id)) {
+				seen.insert(id);
+				pools->push_back(pool(std::string(name, tab - name), -1, -1, 1, 0, 0,
+						      pool::SCHED_FAIR));
+			}
+			prev = name;
+			plen = tab - name;
+		}
+		const char *nl = (const char *)memchr(p, '\n', end - p);
+		p = nl? nl + 1: end;
+	}
+}
+
+// a job of the converted workload
+struct conv_job {
+	const chunk_job *first;  // first appearance, holding the name
+	double ctime;
+	double weight;
+	std::vector<const chunk_task *> tasks[task::TASK_TYPE_NUM];
+};
+
+// Sequential writer of 8-byte aligned sections
+struct section_writer {
+	FILE    *fp;
+	uint64_t pos;
+	bool     ok;
+
+	section_writer(FILE *f) : fp(f), pos(0), ok(true) { }
+
+	void write(const void *buf, size_t len)
+	{
+		if (ok && len && fwrite(buf, len, 1, fp) != 1)
+			ok = false;
+		pos += len;
+	}
+
+	// pad to the next section, returns its offset
+	uint64_t align()
+	{
+		static const char zeros[8] = { 0 };
+		write(zeros, (8 - pos % 8) % 8);
+		return pos;
+	}
+};
+
+int convert_text_workload(const char *file, workload_format fmt,
+			  const char *out, int nthreads)
+{
+	// names are kept until written, so gzip inputs are decompressed
+	// in full instead of streamed
+	size_t size;
+	bool gzip = is_gzip(file);
+	const char *data = gzip? read_gzip(file, &size): map_file(file, &size);
+	if (data == NULL)
+		return -1;
+
+	job_tracker::pool_container_type pools;
+	collect_pools(data, size, fmt, &pools);
+	pool_index_type pmap;
+	ulib::open_hash_map<uint64_t, size_t> pidx;
+	size_t npools = 0;
+	for (job_tracker::pool_container_type::iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		pmap[pit->id] = &*pit;
+		pidx[pit->id] = npools++;
+	}
+
+	chunk_list ctxs;
+	if (parse_text(file, data, size, fmt, &pmap, nthreads, &ctxs)) {
+		release_text(data, size, gzip);
+		return -1;
+	}
+
+	// merge jobs across chunks as import_text_workload() does
+	std::vector<conv_job> jobs;
+	std::vector< std::vector<size_t> > pool_jobs(pools.size());
+	ulib::open_hash_map<uint64_t, size_t> jmap;
+	std::vector< std::vector<size_t> > locs(ctxs.size());
+	for (size_t c = 0; c < ctxs.size(); ++c) {
+		const std::vector<chunk_job> &cjobs = ctxs[c].jobs;
+		locs[c].resize(cjobs.size());
+		for (size_t k = 0; k < cjobs.size(); ++k) {
+			ulib::open_hash_map<uint64_t, size_t>::iterator it = jmap.find(cjobs[k].id);
+			if (it == jmap.end()) {
+				conv_job cj;
+				cj.first = &cjobs[k];
+				cj.ctime = cjobs[k].ctime;
+				cj.weight = cjobs[k].weight;
+				jobs.push_back(cj);
+				pool_jobs[pidx[cjobs[k].owner->id]].push_back(jobs.size() - 1);
+				it = jmap.insert(cjobs[k].id, jobs.size() - 1);
+			}
+			conv_job &cj = jobs[it.value()];
+			if (cj.first->name_len != cjobs[k].name_len ||
+			    memcmp(cj.first->name, cjobs[k].name, cjobs[k].name_len)) {
+				ULIB_WARNING("job %.*s collides with job %.*s",
+					     (int)cjobs[k].name_len, cjobs[k].name,
+					     (int)cj.first->name_len, cj.first->name);
+				release_text(data, size, gzip);
+				return -1;
+			}
+			if (cj.ctime > cjobs[k].ctime)
+				cj.ctime = cjobs[k].ctime;
+			cj.weight = cjobs[k].weight;
+			locs[c][k] = it.value();
+		}
+	}
+	size_t ntasks = 0;
+	for (size_t c = 0; c < ctxs.size(); ++c) {
+		const std::vector<chunk_task> &tasks = ctxs[c].tasks;
+		for (size_t i = 0; i < tasks.size(); ++i)
+			jobs[locs[c][tasks[i].jidx]].tasks[tasks[i].t.type].push_back(&tasks[i]);
+		ntasks += tasks.size();
+	}
+
+	// tasks grouped by job, jobs grouped by pool
+	std::vector<size_t> job_order;
+	std::vector<const chunk_task *> task_order;
+	job_order.reserve(jobs.size());
+	task_order.reserve(ntasks);
+	for (size_t i = 0; i < pool_jobs.size(); ++i) {
+		for (size_t k = 0; k < pool_jobs[i].size(); ++k) {
+			conv_job &cj = jobs[pool_jobs[i][k]];
+			job_order.push_back(pool_jobs[i][k]);
+			task_order.insert(task_order.end(),
+					  cj.tasks[task::TASK_TYPE_MAP].begin(),
+					  cj.tasks[task::TASK_TYPE_MAP].end());
+			task_order.insert(task_order.end(),
+					  cj.tasks[task::TASK_TYPE_REDUCE].begin(),
+					  cj.tasks[task::TASK_TYPE_REDUCE].end());
+		}
+	}
+
+	FILE *fp = fopen(out, "w");
+	if (fp == NULL) {
+		ULIB_WARNING("cannot open %s for writing", out);
+		release_text(data, size, gzip);
+		return -1;
+	}
+
+	wl_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, WORKLOAD_MAGIC, sizeof(h.magic));
+	h.version = WORKLOAD_VERSION;
+	h.flags = fmt == WORKLOAD_STIME_FTIME || fmt == WORKLOAD_DATASET?
+		wl_header::WL_FLAG_TIMES: 0;
+	h.npools = pools.size();
+	h.njobs = jobs.size();
+	h.ntasks = ntasks;
+
+	section_writer w(fp);
+	w.write(&h, sizeof(h));
+
+	// string table: pool, job and task names in directory order
+	h.strtab_off = w.align();
+	std::vector<uint64_t> pool_names;
+	for (job_tracker::pool_container_type::iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		pool_names.push_back(w.pos - h.strtab_off);
+		w.write(pit->name.c_str(), pit->name.size() + 1);
+	}
+	std::vector<uint64_t> job_names;
+	for (size_t i = 0; i < job_order.size(); ++i) {
+		const chunk_job *cj = jobs[job_order[i]].first;
+		job_names.push_back(w.pos - h.strtab_off);
+		w.write(cj->name, cj->name_len);
+		w.write("", 1);
+	}
+	uint64_t task_names = w.pos - h.strtab_off;
+	for (size_t i = 0; i < task_order.size(); ++i) {
+		w.write(task_order[i]->name, task_order[i]->name_len);
+		w.write("", 1);
+	}
+	h.strtab_size = w.pos - h.strtab_off;
+
+	h.pools_off = w.align();
+	size_t first = 0;
+	size_t i = 0;
+	for (job_tracker::pool_container_type::iterator pit = pools.begin();
+	     pit != pools.end(); ++pit, ++i) {
+		wl_pool wp;
+		wp.name = pool_names[i];
+		wp.id = pit->id;
+		wp.first_job = first;
+		wp.njobs = pool_jobs[i].size();
+		first += wp.njobs;
+		w.write(&wp, sizeof(wp));
+	}
+
+	h.jobs_off = w.align();
+	first = 0;
+	for (i = 0; i < job_order.size(); ++i) {
+		const conv_job &cj = jobs[job_order[i]];
+		wl_job wj;
+		wj.name = job_names[i];
+		wj.id = cj.first->id;
+		wj.ctime = cj.ctime;
+		wj.weight = cj.weight;
+		wj.first_task = first;
+		wj.nmaps = cj.tasks[task::TASK_TYPE_MAP].size();
+		wj.nreduces = cj.tasks[task::TASK_TYPE_REDUCE].size();
+		first += wj.nmaps + wj.nreduces;
+		w.write(&wj, sizeof(wj));
+	}
+
+	h.task_id_off = w.align();
+	for (i = 0; i < task_order.size(); ++i)
+		w.write(&task_order[i]->t.id, sizeof(uint64_t));
+	h.task_name_off = w.align();
+	for (i = 0; i < task_order.size(); ++i) {
+		w.write(&task_names, sizeof(uint64_t));
+		task_names += task_order[i]->name_len + 1;
+	}
+	h.ctime_off = w.align();
+	for (i = 0; i < task_order.size(); ++i)
+		w.write(&task_order[i]->t.ctime, sizeof(double));
+	h.ptime_off = w.align();
+	for (i = 0; i < task_order.size(); ++i)
+		w.write(&task_order[i]->t.ptime, sizeof(double));
+	if (h.flags & wl_header::WL_FLAG_TIMES) {
+		h.stime_off = w.align();
+		for (i = 0; i < task_order.size(); ++i)
+			w.write(&task_order[i]->t.stime, sizeof(double));
+		h.ftime_off = w.align();
+		for (i = 0; i < task_order.size(); ++i)
+			w.write(&task_order[i]->t.ftime, sizeof(double));
+	}
+	h.type_off = w.align();
+	for (i = 0; i < task_order.size(); ++i) {
+		uint8_t type = task_order[i]->t.type;
+		w.write(&type, sizeof(type));
+	}
+	h.job_index_off = w.align();
+	for (i = 0; i < job_order.size(); ++i) {
+		const conv_job &cj = jobs[job_order[i]];
+		uint32_t idx = i;
+		size_t n = cj.tasks[task::TASK_TYPE_MAP].size() +
+			cj.tasks[task::TASK_TYPE_REDUCE].size();
+		for (size_t k = 0; k < n; ++k)
+			w.write(&idx, sizeof(idx));
+	}
+
+	// fill in the section offsets
+	if (fseek(fp, 0, SEEK_SET) || fwrite(&h, sizeof(h), 1, fp) != 1)
+		w.ok = false;
+	if (fclose(fp))
+		w.ok = false;
+	release_text(data, size, gzip);
+	if (!w.ok) {
+		ULIB_WARNING("failed to write %s", out);
+		return -1;
+	}
+
+	return 0;
+}
+
+}
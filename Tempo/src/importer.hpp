@@ -0,0 +1,87 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_IMPORTER_H
+#define _COLOSSAL_IMPORTER_H
+
+#include "pool.hpp"
+#include "job_tracker.hpp"
+
+namespace Tempo {
+
+// Layouts of text workload lines
+enum workload_format {
+	// POOL"\t"JOB:PRIORITY"\t"TASK"\t"<MAP|REDUCE>"\t"CTIME"\t"STIME"\t"FTIME
+	WORKLOAD_STIME_FTIME,
+	// POOL"\t"JOB:PRIORITY"\t"TASK"\t"<MAP|REDUCE>"\t"CTIME"\t"PTIME
+	WORKLOAD_PTIME,
+	// the 16-column dataset table of script/extractor, times in ms
+	// Only successful attempts with start and finish times are
+	// imported; CTIME is the job launch time. The two formats read
+	// like WORKLOAD_STIME_FTIME and WORKLOAD_PTIME on the output of
+	// loader.awk, except that loader.awk also keeps the attempts
+	// whose status is not SUCCESS and rounds times to milliseconds.
+	WORKLOAD_DATASET,
+	WORKLOAD_DATASET_PTIME
+};
+
+// Returns true if the first line of @file, which may be gzip-compressed,
+// has the columns of the dataset table
+bool is_dataset_table(const char *file);
+
+// Import a text workload into the configured pools
+// The file is memory-mapped and split into newline-aligned chunks,
+// which are parsed in parallel and merged in file order, so the
+// resulting jobs and tasks are ordered as in the file. A gzip file is
+// decompressed by the calling thread and streamed in blocks to the
+// parsing threads instead.
+// nthreads: number of parsing threads, <= 0 to use all online CPUs
+// Returns 0 on success, -1 otherwise.
+int import_text_workload(const char *file, workload_format fmt,
+			 job_tracker::pool_container_type *pools,
+			 int nthreads = 0);
+
+// Incremental import of text workload lines into the configured pools
+// Lines of a job seen in an earlier call, or already in the pools when
+// the appender was created, add to that job.
+class workload_appender
+{
+public:
+	workload_appender(workload_format fmt, job_tracker::pool_container_type *pools,
+			  int nthreads = 0);
+	~workload_appender();
+
+	// Import the lines in [data, data + size), which must end with a
+	// whole line; @src names the input in error messages
+	// Returns the number of imported tasks, or -1 on error.
+	long append(const char *src, const char *data, size_t size);
+
+private:
+	workload_appender(const workload_appender &);
+	workload_appender &operator=(const workload_appender &);
+
+	struct state;
+	state *_st;
+};
+
+// Convert a text workload to the binary format of workload_file.hpp
+// Every pool in the workload is converted, configured or not. The
+// input may be gzip-compressed.
+// Returns 0 on success, -1 otherwise.
+int convert_text_workload(const char *file, workload_format fmt,
+			  const char *out, int nthreads = 0);
+
+}
+
+#endif
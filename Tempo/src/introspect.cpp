@@ -0,0 +1,262 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <time.h>
+#include <errno.h>
+#include <poll.h>
+#include <sched.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <ulib/util_log.h>
+#include "introspect.hpp"
+
+// milliseconds between checks for a stop request
+#define INTROSPECT_POLL_MS 100
+
+namespace Tempo {
+
+volatile bool introspect_on;
+
+// A snapshot under a seqlock: the sequence is odd while a writer is
+// updating the data, and writers exclude each other with a try-lock
+template<typename T>
+struct seq_board {
+	volatile uint32_t seq;
+	volatile int      lock;
+	T                 data;
+};
+
+static seq_board<is_engine>    engine_board;
+static seq_board<is_optimizer> optimizer_board;
+
+static int         listen_fd = -1;
+static std::string sock_path;
+static pthread_t   server_tid;
+static volatile bool stopping;
+
+template<typename T>
+static T *begin_update(seq_board<T> *b)
+{
+	if (__sync_lock_test_and_set(&b->lock, 1))
+		return NULL;
+	++b->seq;
+	__sync_synchronize();
+	return &b->data;
+}
+
+template<typename T>
+static void end_update(seq_board<T> *b)
+{
+	__sync_synchronize();
+	++b->seq;
+	__sync_lock_release(&b->lock);
+}
+
+// Copy a consistent snapshot, returns false if none is published
+template<typename T>
+static bool read_board(const seq_board<T> &b, T *out)
+{
+	for (;;) {
+		uint32_t s = b.seq;
+		if (s == 0)
+			return false;
+		if (s & 1) {
+			sched_yield();
+			continue;
+		}
+		__sync_synchronize();
+		memcpy(out, (const void *)&b.data, sizeof(T));
+		__sync_synchronize();
+		if (b.seq == s)
+			return true;
+	}
+}
+
+double introspect_clock()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+is_engine *introspect_begin_engine()
+{
+	return begin_update(&engine_board);
+}
+
+void introspect_end_engine()
+{
+	end_update(&engine_board);
+}
+
+void introspect_optimizer(const is_optimizer &opt)
+{
+	is_optimizer *o = begin_update(&optimizer_board);
+	if (o) {
+		*o = opt;
+		end_update(&optimizer_board);
+	}
+}
+
+static void append(std::string *s, const char *fmt, ...)
+	__attribute__((format(printf, 2, 3)));
+
+static void append(std::string *s, const char *fmt, ...)
+{
+	char buf[256];
+	va_list ap;
+
+	va_start(ap, fmt);
+	int n = vsnprintf(buf, sizeof(buf), fmt, ap);
+	va_end(ap);
+	if (n > 0)
+		s->append(buf, (size_t)n < sizeof(buf)? n: sizeof(buf) - 1);
+}
+
+// One KEY"\t"VALUE line per state, and for each pool:
+// pool"\t"NAME"\t"map"\t"ALLOC"\t"DEMAND"\t"FAIRSHARE"\t"reduce"\t"...
+static void report(std::string *s)
+{
+	static is_engine eng;  // too large for the stack of the server
+	is_optimizer opt;
+
+	if (read_board(engine_board, &eng)) {
+		append(s, "time\t%f\n", eng.time);
+		append(s, "events\t%llu\n", (unsigned long long)eng.events);
+		append(s, "events_per_sec\t%.0f\n", eng.events_per_sec);
+		append(s, "age\t%.3f\n", introspect_clock() - eng.wall);
+		append(s, "heap\t%llu\n", (unsigned long long)eng.heap);
+		append(s, "running_maps\t%u\n", eng.running_maps);
+		append(s, "running_reduces\t%u\n", eng.running_reduces);
+		append(s, "waiting_maps\t%u\n", eng.waiting_maps);
+		append(s, "waiting_reduces\t%u\n", eng.waiting_reduces);
+		append(s, "map_progress\t%.4f\n", eng.map_progress);
+		append(s, "reduce_progress\t%.4f\n", eng.reduce_progress);
+		for (uint32_t i = 0; i < eng.npools && i < INTROSPECT_MAX_POOLS; ++i) {
+			const is_pool &p = eng.pools[i];
+			append(s, "pool\t%.*s\tmap\t%d\t%d\t%f\treduce\t%d\t%d\t%f\n",
+			       INTROSPECT_NAME_SIZE, p.name,
+			       p.map.alloc, p.map.demand, p.map.fairshare,
+			       p.reduce.alloc, p.reduce.demand, p.reduce.fairshare);
+		}
+		if (eng.pools_omitted)
+			append(s, "pools_omitted\t%u\n", eng.pools_omitted);
+	}
+	if (read_board(optimizer_board, &opt)) {
+		append(s, "iteration\t%d/%d\n", opt.iteration, opt.niter);
+		append(s, "evaluations\t%llu\n", (unsigned long long)opt.evaluations);
+		append(s, "objective\t%g\n", opt.objective);
+		append(s, "best_objective\t%g\n", opt.best);
+	}
+}
+
+static void *serve(void *)
+{
+	std::string s;
+
+	while (!stopping) {
+		struct pollfd pfd;
+		pfd.fd = listen_fd;
+		pfd.events = POLLIN;
+		if (poll(&pfd, 1, INTROSPECT_POLL_MS) <= 0)
+			continue;
+		int fd = accept(listen_fd, NULL, NULL);
+		if (fd == -1)
+			continue;
+		s.clear();
+		report(&s);
+		for (size_t off = 0; off < s.size(); ) {
+			ssize_t n = send(fd, s.data() + off, s.size() - off, MSG_NOSIGNAL);
+			if (n <= 0 && errno != EINTR)
+				break;
+			if (n > 0)
+				off += n;
+		}
+		::close(fd);
+	}
+	return NULL;
+}
+
+int introspect_open(const char *path)
+{
+	static bool registered;
+	struct sockaddr_un addr;
+	struct stat st;
+
+	introspect_close();
+	if (strlen(path) >= sizeof(addr.sun_path)) {
+		ULIB_WARNING("socket path %s is too long", path);
+		return -1;
+	}
+	// only a stale socket is replaced, never another file
+	if (lstat(path, &st) == 0) {
+		if (!S_ISSOCK(st.st_mode)) {
+			ULIB_WARNING("%s exists and is not a socket", path);
+			return -1;
+		}
+		unlink(path);
+	}
+	listen_fd = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (listen_fd == -1) {
+		ULIB_WARNING("cannot create a socket");
+		return -1;
+	}
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	if (bind(listen_fd, (struct sockaddr *)&addr, sizeof(addr)) ||
+	    listen(listen_fd, 8)) {
+		ULIB_WARNING("cannot listen on %s", path);
+		::close(listen_fd);
+		listen_fd = -1;
+		return -1;
+	}
+	sock_path = path;
+	stopping = false;
+	if (pthread_create(&server_tid, NULL, serve, NULL)) {
+		ULIB_WARNING("cannot start the introspection thread");
+		::close(listen_fd);
+		listen_fd = -1;
+		unlink(path);
+		return -1;
+	}
+	if (!registered) {
+		atexit(introspect_close);
+		registered = true;
+	}
+	introspect_on = true;
+	return 0;
+}
+
+void introspect_close()
+{
+	if (listen_fd == -1)
+		return;
+	introspect_on = false;
+	stopping = true;
+	pthread_join(server_tid, NULL);
+	::close(listen_fd);
+	listen_fd = -1;
+	unlink(sock_path.c_str());
+}
+
+}
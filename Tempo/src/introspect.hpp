@@ -0,0 +1,98 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_INTROSPECT_H
+#define _COLOSSAL_INTROSPECT_H
+
+#include <stdint.h>
+
+// Live introspection of a running simulation
+//
+// Once opened, a side thread serves the latest snapshots of the
+// engine and optimizer states on a Unix domain socket, one text
+// report per connection, e.g. "nc -U PATH". Writers publish under a
+// seqlock: they never wait for a reader, and a writer that finds
+// another one publishing skips its snapshot.
+
+namespace Tempo {
+
+#define INTROSPECT_MAX_POOLS 256
+#define INTROSPECT_NAME_SIZE 48
+
+struct is_share {
+	int32_t alloc;
+	int32_t demand;
+	double  fairshare;
+};
+
+struct is_pool {
+	char     name[INTROSPECT_NAME_SIZE];  // truncated
+	is_share map;
+	is_share reduce;
+};
+
+struct is_engine {
+	double   wall;             // monotonic wall time of the snapshot
+	double   time;             // simulated time
+	uint64_t events;           // events processed in the run
+	double   events_per_sec;   // since the previous snapshot
+	uint64_t heap;             // pending events
+	uint32_t running_maps;
+	uint32_t running_reduces;
+	uint32_t waiting_maps;     // creations waiting for a slot
+	uint32_t waiting_reduces;
+	double   map_progress;
+	double   reduce_progress;
+	uint32_t npools;
+	uint32_t pools_omitted;    // pools beyond INTROSPECT_MAX_POOLS
+	is_pool  pools[INTROSPECT_MAX_POOLS];
+};
+
+struct is_optimizer {
+	int32_t  iteration;
+	int32_t  niter;
+	uint64_t evaluations;
+	double   objective;        // of the current decision variables
+	double   best;             // lowest objective so far
+};
+
+extern volatile bool introspect_on;
+
+inline bool introspect_enabled()
+{
+	return introspect_on;
+}
+
+// Serve the snapshots on the socket @path, replacing a stale socket
+// Returns 0 on success, -1 otherwise, e.g. if @path is another file.
+int introspect_open(const char *path);
+
+// Stop serving and remove the socket
+void introspect_close();
+
+// Fill the returned engine snapshot and publish it with
+// introspect_end_engine(), the previous snapshot is kept in it
+// Returns NULL if another thread is publishing.
+is_engine *introspect_begin_engine();
+void introspect_end_engine();
+
+// Publish the optimizer state
+void introspect_optimizer(const is_optimizer &opt);
+
+// Wall time in seconds for is_engine::wall
+double introspect_clock();
+
+}
+
+#endif
@@ -41,4 +41,9 @@ uint64_t job::id_from_str(const char *str)
 	return hash_fast64(str, strlen(str), 0xfeedbeefdeedbeefull);
 }
 
+uint64_t job::id_from_str(const char *str, size_t len)
+{
+	return hash_fast64(str, len, 0xfeedbeefdeedbeefull);
+}
+
 }
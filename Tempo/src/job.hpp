@@ -33,8 +33,15 @@ struct job
 	fs_context fs_ctx_map;
 	fs_context fs_ctx_reduce;
         task_container_type tasks[task::TASK_TYPE_NUM];
+	size_t     name;  // offset in the names of the pool, 0 if unnamed
+	// set by the engine for the tasks of a run
+	uint32_t   nleft;        // tasks yet to finish
+	double     ideal_ftime;  // finish time on an idle cluster
+
+	job() : name(0), nleft(0), ideal_ftime(0) { }
 
 	static uint64_t id_from_str(const char *str);
+	static uint64_t id_from_str(const char *str, size_t len);
 
         std::string to_str(const char *prefix = "") const;
 };
@@ -27,21 +27,83 @@ job_tracker::~job_tracker()
 	delete _eng;
 }
 
-bool job_tracker::set_metrics(const char * met, int met_win)
+bool job_tracker::set_metrics(const char * met, double met_interval)
 {
-	return _eng->set_metrics(met, met_win);
+	return _eng->set_metrics(met, met_interval);
+}
+
+const slot_usage &job_tracker::usage(task::task_type type) const
+{
+	return _eng->usage(type);
+}
+
+void job_tracker::keep_usage_series(bool keep)
+{
+	_eng->keep_usage_series(keep);
+}
+
+void job_tracker::report_progress(bool on)
+{
+	_eng->report_progress(on);
+}
+
+void job_tracker::report_state(bool on)
+{
+	_eng->report_state(on);
+}
+
+bool job_tracker::set_trace(const char *file, const trace_options &opts)
+{
+	return _eng->set_trace(file, opts);
+}
+
+void job_tracker::set_bound(run_bound *b)
+{
+	_eng->set_bound(b);
+}
+
+bool job_tracker::stopped() const
+{
+	return _eng->stopped();
 }
 
 pool & job_tracker::add_pool(const std::string &ns, double mto, double fto,
 			     double weight, int minmap, int minred,
-			     pool::sched_mode sched)
+			     pool::sched_mode sched, pool *parent)
 {
-	return _eng->add_pool(ns, mto, fto, weight, minmap, minred, sched);
+	return _eng->add_pool(ns, mto, fto, weight, minmap, minred, sched, parent);
 }
 
-void job_tracker::process()
+void job_tracker::keep_observed()
 {
-	_eng->process();
+	task::task_type order[] = { task::TASK_TYPE_MAP, task::TASK_TYPE_REDUCE };
+	pool_container_type &pools = _eng->getpools();
+
+	for (pool_container_type::iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		size_t ntasks = 0;
+		for (size_t j = 0; j < pit->jobs.size(); ++j)
+			ntasks += pit->jobs[j].tasks[task::TASK_TYPE_MAP].size() +
+				pit->jobs[j].tasks[task::TASK_TYPE_REDUCE].size();
+		pit->observed_stimes.clear();
+		pit->observed_ftimes.clear();
+		pit->observed_stimes.reserve(ntasks);
+		pit->observed_ftimes.reserve(ntasks);
+		for (size_t j = 0; j < pit->jobs.size(); ++j) {
+			for (int o = 0; o < task::TASK_TYPE_NUM; ++o) {
+				const job::task_container_type &tasks = pit->jobs[j].tasks[order[o]];
+				for (size_t k = 0; k < tasks.size(); ++k) {
+					pit->observed_stimes.push_back(tasks[k].stime);
+					pit->observed_ftimes.push_back(tasks[k].ftime);
+				}
+			}
+		}
+	}
+}
+
+void job_tracker::process(const workload_view *view)
+{
+	_eng->process(view);
 }
 
 void job_tracker::reset_time(double now)
@@ -54,6 +116,11 @@ void job_tracker::scale_minshares()
 	_eng->scale_minshares();
 }
 
+void job_tracker::set_slots(int nmaps, int nreduces)
+{
+	_eng->set_slots(nmaps, nreduces);
+}
+
 size_t job_tracker::running_maps() const
 {
 	return _eng->running_maps->size();
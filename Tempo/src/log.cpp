@@ -0,0 +1,296 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <strings.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include "log.hpp"
+
+// records the ring holds, a power of two
+#define LOG_RING_SIZE (1 << 14)
+
+namespace Tempo {
+
+#ifdef NDEBUG
+volatile unsigned log_masks[LOG_NLEVELS] = { 0, LOG_ALL, LOG_ALL, LOG_ALL };
+#else
+volatile unsigned log_masks[LOG_NLEVELS] = { LOG_ALL, LOG_ALL, LOG_ALL, LOG_ALL };
+#endif
+
+struct log_record {
+	volatile uint64_t seq;  // the position it holds + 1 when written
+	double      time;
+	const char *fmt;
+	int         level;
+	int         nargs;
+	log_arg     args[LOG_MAX_ARGS];
+};
+
+// Bounded multi-producer ring with one consumer: a producer claims a
+// position by advancing the tail and publishes the record by setting
+// its sequence number; the consumer frees the slot for the next round
+// by advancing the sequence number by the ring size. Producers drain
+// the ring themselves if the log thread cannot start, the lock keeps
+// one consumer at a time.
+static log_record       ring[LOG_RING_SIZE];
+static volatile uint64_t ring_tail;     // next position to claim
+static volatile uint64_t ring_head;     // next position to read
+static volatile uint64_t ring_flushed;  // positions before are written out
+static volatile bool     ring_stop;
+static pthread_mutex_t   drain_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_once_t    drain_once = PTHREAD_ONCE_INIT;
+static pthread_t         drain_tid;
+static bool              drain_started;
+
+static const char *level_tags[LOG_NLEVELS] = { "[D]", "[I]", "[W]", "[E]" };
+static const char *level_names[LOG_NLEVELS] = { "debug", "notice", "warning", "fatal" };
+
+void log_set_level(log_level level, unsigned categories)
+{
+	for (int i = 0; i < LOG_NLEVELS; ++i)
+		log_masks[i] = i >= level? categories: 0;
+}
+
+bool log_parse_level(const char *name, log_level *level)
+{
+	for (int i = 0; i < LOG_NLEVELS; ++i) {
+		if (strcasecmp(name, level_names[i]) == 0) {
+			*level = (log_level)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+bool log_parse_categories(const char *names, unsigned *categories)
+{
+	static const char *cat_names[] = { "event", "preempt", "select", "all" };
+	static const unsigned cat_bits[] = { LOG_EVENT, LOG_PREEMPT, LOG_SELECT, LOG_ALL };
+	unsigned mask = 0;
+
+	while (*names) {
+		size_t len = strcspn(names, ",");
+		size_t i = 0;
+		for (; i < sizeof(cat_names) / sizeof(cat_names[0]); ++i) {
+			if (strlen(cat_names[i]) == len &&
+			    strncasecmp(names, cat_names[i], len) == 0)
+				break;
+		}
+		if (i == sizeof(cat_names) / sizeof(cat_names[0]))
+			return false;
+		mask |= cat_bits[i];
+		names += len;
+		if (*names == ',')
+			++names;
+	}
+	*categories = mask;
+	return true;
+}
+
+// Format one conversion of @spec, of which the length modifiers are
+// replaced to match the stored argument
+static void format_arg(std::string *out, const char *spec, size_t len,
+		       const log_arg *arg)
+{
+	char f[32];
+	char buf[128];
+	size_t n = 0;
+
+	// flags, width and precision
+	for (size_t i = 0; i + 1 < len && n < sizeof(f) - 4; ++i) {
+		if (!strchr("hlLqjzt", spec[i]))
+			f[n++] = spec[i];
+	}
+	char conv = spec[len - 1];
+	if (arg == NULL) {
+		out->append(spec, len);
+		return;
+	}
+	if (strchr("diouxXc", conv)) {
+		if (conv != 'c') {
+			f[n++] = 'l';
+			f[n++] = 'l';
+		}
+		f[n++] = conv;
+		f[n] = '\0';
+		long long v = arg->type == log_arg::DOUBLE? (long long)arg->d: arg->i;
+		snprintf(buf, sizeof(buf), f, conv == 'c'? (int)v: v);
+	} else if (strchr("eEfFgGaA", conv)) {
+		f[n++] = conv;
+		f[n] = '\0';
+		double v = arg->type == log_arg::DOUBLE? arg->d:
+			arg->type == log_arg::UINT? (double)arg->u: (double)arg->i;
+		snprintf(buf, sizeof(buf), f, v);
+	} else if (conv == 's' && arg->type == log_arg::STR) {
+		f[n++] = conv;
+		f[n] = '\0';
+		snprintf(buf, sizeof(buf), f, arg->s? arg->s: "(null)");
+	} else {
+		out->append(spec, len);
+		return;
+	}
+	out->append(buf);
+}
+
+static void format_record(std::string *out, const log_record &r)
+{
+	char buf[64];
+	int narg = 0;
+
+	snprintf(buf, sizeof(buf), "%s @%f\t", level_tags[r.level], r.time);
+	out->append(buf);
+	for (const char *p = r.fmt; *p; ) {
+		if (*p != '%') {
+			const char *q = strchr(p, '%');
+			size_t len = q? (size_t)(q - p): strlen(p);
+			out->append(p, len);
+			p += len;
+			continue;
+		}
+		if (p[1] == '%') {
+			out->push_back('%');
+			p += 2;
+			continue;
+		}
+		size_t len = 1 + strspn(p + 1, "#0- +'.0123456789hlLqjzt");
+		if (p[len] == '\0') {
+			out->append(p);
+			break;
+		}
+		++len;
+		format_arg(out, p, len, narg < r.nargs? &r.args[narg]: NULL);
+		++narg;
+		p += len;
+	}
+	out->push_back('\n');
+}
+
+// Write out the published records, returns the number written
+static size_t drain()
+{
+	std::string out[2];  // stdout and stderr
+	size_t n = 0;
+
+	pthread_mutex_lock(&drain_lock);
+	for (;;) {
+		log_record &r = ring[ring_head % LOG_RING_SIZE];
+		if (r.seq != ring_head + 1)
+			break;
+		__sync_synchronize();
+		format_record(&out[r.level >= LOG_LEVEL_WARNING], r);
+		__sync_synchronize();
+		r.seq = ring_head + LOG_RING_SIZE;
+		ring_head = ring_head + 1;
+		++n;
+	}
+	// stdout keeps its buffering as with printf()
+	if (out[0].size())
+		fwrite(out[0].data(), 1, out[0].size(), stdout);
+	if (out[1].size()) {
+		fwrite(out[1].data(), 1, out[1].size(), stderr);
+		fflush(stderr);
+	}
+	__sync_synchronize();
+	ring_flushed = ring_head;
+	pthread_mutex_unlock(&drain_lock);
+	return n;
+}
+
+static void *drain_thread(void *)
+{
+	for (;;) {
+		bool stop = ring_stop;
+		if (drain() == 0) {
+			if (stop)
+				break;
+			usleep(1000);
+		}
+	}
+	return NULL;
+}
+
+static void stop_draining()
+{
+	ring_stop = true;
+	pthread_join(drain_tid, NULL);
+}
+
+static void start_draining()
+{
+	for (uint64_t i = 0; i < LOG_RING_SIZE; ++i)
+		ring[i].seq = i;
+	__sync_synchronize();
+	if (pthread_create(&drain_tid, NULL, drain_thread, NULL)) {
+		fprintf(stderr, "[E] cannot start the log thread, logging synchronously\n");
+		return;
+	}
+	drain_started = true;
+	atexit(stop_draining);
+}
+
+void log_write(log_level level, double time, const char *fmt,
+	       int nargs, const log_arg *args)
+{
+	pthread_once(&drain_once, start_draining);
+
+	uint64_t pos = ring_tail;
+	log_record *r;
+	for (;;) {
+		r = &ring[pos % LOG_RING_SIZE];
+		int64_t dif = (int64_t)(r->seq - pos);
+		if (dif == 0) {
+			if (__sync_bool_compare_and_swap(&ring_tail, pos, pos + 1))
+				break;
+			pos = ring_tail;
+		} else if (dif < 0) {
+			// full, wait for the consumer
+			if (!drain_started) {
+				drain();
+			} else
+				sched_yield();
+			pos = ring_tail;
+		} else
+			pos = ring_tail;
+	}
+	r->time = time;
+	r->fmt = fmt;
+	r->level = level;
+	r->nargs = nargs < LOG_MAX_ARGS? nargs: LOG_MAX_ARGS;
+	for (int i = 0; i < r->nargs; ++i)
+		r->args[i] = args[i];
+	__sync_synchronize();
+	r->seq = pos + 1;
+
+	if (level >= LOG_LEVEL_WARNING)
+		log_flush();
+}
+
+void log_flush()
+{
+	uint64_t tail = ring_tail;
+
+	if (!drain_started) {
+		drain();
+		return;
+	}
+	while ((int64_t)(ring_flushed - tail) < 0)
+		sched_yield();
+}
+
+}
@@ -15,22 +15,135 @@
 #ifndef _COLOSSAL_LOG_H
 #define _COLOSSAL_LOG_H
 
-#include <cstdio>
+#include <cstddef>
+#include <stdint.h>
 
-#ifdef NDEBUG
-#define DEBUG(time, fmt, ...)
-#else
-#define DEBUG(time, fmt, ...)						\
-	fprintf(stdout, "[D] @%f\t" fmt "\n", time, ##__VA_ARGS__)
-#endif
+// Asynchronous simulation log
+//
+// A record keeps the simulation time, the format string and up to
+// LOG_MAX_ARGS numeric or string arguments. It is put into a lock-free
+// ring and formatted by a background thread, in the form
+// "[I] @TIME\tMESSAGE". Debug and notice records go to stdout,
+// warnings and errors to stderr; the latter two are flushed before
+// the macro returns. Formats must be literals, and string arguments
+// must stay valid until log_flush().
+//
+// Levels and categories are selected at runtime. A disabled record
+// costs one load and test, its arguments are not evaluated.
+
+namespace Tempo {
+
+enum log_level {
+	LOG_LEVEL_DEBUG,
+	LOG_LEVEL_NOTICE,
+	LOG_LEVEL_WARNING,
+	LOG_LEVEL_FATAL,
+	LOG_NLEVELS
+};
+
+enum log_category {
+	LOG_EVENT   = 1,  // event handling and slot acquisition
+	LOG_PREEMPT = 2,  // preemption decisions
+	LOG_SELECT  = 4,  // task selection
+	LOG_ALL     = 7
+};
+
+#define LOG_MAX_ARGS 4
+
+// categories enabled at each level
+extern volatile unsigned log_masks[LOG_NLEVELS];
+
+inline bool log_enabled(log_level level, unsigned cat)
+{
+	return log_masks[level] & cat;
+}
+
+// Log records of @level and above in @categories, categories of the
+// lower levels are disabled. The default is LOG_LEVEL_NOTICE for all
+// categories, LOG_LEVEL_DEBUG without NDEBUG.
+void log_set_level(log_level level, unsigned categories = LOG_ALL);
+
+// Parse a level (debug, notice, warning or fatal) or a comma-separated
+// list of categories (event, preempt, select or all), ignoring case
+// Returns false if a name is unknown.
+bool log_parse_level(const char *name, log_level *level);
+bool log_parse_categories(const char *names, unsigned *categories);
+
+// Wait until the records logged so far are handed to stdio
+void log_flush();
+
+// An argument of a record
+struct log_arg {
+	enum { INT, UINT, DOUBLE, STR } type;
+	union {
+		int64_t     i;
+		uint64_t    u;
+		double      d;
+		const char *s;
+	};
+
+	log_arg() : type(INT), i(0) { }
+	log_arg(int v) : type(INT), i(v) { }
+	log_arg(long v) : type(INT), i(v) { }
+	log_arg(long long v) : type(INT), i(v) { }
+	log_arg(unsigned v) : type(UINT), u(v) { }
+	log_arg(unsigned long v) : type(UINT), u(v) { }
+	log_arg(unsigned long long v) : type(UINT), u(v) { }
+	log_arg(double v) : type(DOUBLE), d(v) { }
+	log_arg(const char *v) : type(STR), s(v) { }
+};
+
+void log_write(log_level level, double time, const char *fmt,
+	       int nargs, const log_arg *args);
+
+inline void log_write(log_level level, double time, const char *fmt)
+{
+	log_write(level, time, fmt, 0, NULL);
+}
+
+inline void log_write(log_level level, double time, const char *fmt,
+		      const log_arg &a1)
+{
+	log_write(level, time, fmt, 1, &a1);
+}
+
+inline void log_write(log_level level, double time, const char *fmt,
+		      const log_arg &a1, const log_arg &a2)
+{
+	log_arg args[] = { a1, a2 };
+	log_write(level, time, fmt, 2, args);
+}
+
+inline void log_write(log_level level, double time, const char *fmt,
+		      const log_arg &a1, const log_arg &a2, const log_arg &a3)
+{
+	log_arg args[] = { a1, a2, a3 };
+	log_write(level, time, fmt, 3, args);
+}
+
+inline void log_write(log_level level, double time, const char *fmt,
+		      const log_arg &a1, const log_arg &a2, const log_arg &a3,
+		      const log_arg &a4)
+{
+	log_arg args[] = { a1, a2, a3, a4 };
+	log_write(level, time, fmt, 4, args);
+}
 
-#define NOTICE(time, fmt, ...)						\
-	fprintf(stdout, "[I] @%f\t" fmt "\n", time, ##__VA_ARGS__)
+}
 
-#define WARNING(time, fmt, ...)						\
-	fprintf(stderr, "[W] @%f\t" fmt "\n", time, ##__VA_ARGS__)
+#define TEMPO_LOG(level, cat, time, fmt, ...)				\
+	do {								\
+		if (Tempo::log_enabled(level, cat))			\
+			Tempo::log_write(level, time, fmt, ##__VA_ARGS__); \
+	} while (0)
 
-#define FATAL(time, fmt, ...)						\
-	fprintf(stderr, "[E] @%f\t" fmt "\n", time, ##__VA_ARGS__)
+#define DEBUG(cat, time, fmt, ...)					\
+	TEMPO_LOG(Tempo::LOG_LEVEL_DEBUG, cat, time, fmt, ##__VA_ARGS__)
+#define NOTICE(cat, time, fmt, ...)					\
+	TEMPO_LOG(Tempo::LOG_LEVEL_NOTICE, cat, time, fmt, ##__VA_ARGS__)
+#define WARNING(cat, time, fmt, ...)					\
+	TEMPO_LOG(Tempo::LOG_LEVEL_WARNING, cat, time, fmt, ##__VA_ARGS__)
+#define FATAL(cat, time, fmt, ...)					\
+	TEMPO_LOG(Tempo::LOG_LEVEL_FATAL, cat, time, fmt, ##__VA_ARGS__)
 
 #endif
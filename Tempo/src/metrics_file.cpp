@@ -0,0 +1,284 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ulib/util_log.h>
+#include "metrics_file.hpp"
+#include "profile.hpp"
+
+// records buffered before writing
+#define METRICS_BLOCK_RECORDS 8192
+
+namespace Tempo {
+
+metrics_recorder::metrics_recorder()
+	: _fp(NULL), _interval(0), _origin(0), _next(0), _started(false)
+{
+}
+
+metrics_recorder::~metrics_recorder()
+{
+	close();
+}
+
+int metrics_recorder::open(const char *file, double interval)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_METRICS);
+	close();
+	_fp = fopen(file, "w");
+	if (_fp == NULL) {
+		ULIB_WARNING("cannot open metric file %s", file);
+		return -1;
+	}
+	_interval = interval;
+	_started = false;
+	_buf.reserve(METRICS_BLOCK_RECORDS);
+	return 0;
+}
+
+void metrics_recorder::close()
+{
+	if (_fp == NULL)
+		return;
+	if (flush())
+		ULIB_WARNING("failed to write metrics");
+	fclose(_fp);
+	_fp = NULL;
+}
+
+static bool write_padded(FILE *fp, const void *data, size_t size)
+{
+	static const char zeros[8] = { 0 };
+	size_t pad = (8 - size % 8) % 8;
+	return fwrite(data, 1, size, fp) == size &&
+		fwrite(zeros, 1, pad, fp) == pad;
+}
+
+int metrics_recorder::start(const std::list<pool> &pools, double now)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_METRICS);
+	_origin = now;
+	_next = now;
+	if (_started)
+		return 0;
+
+	std::string strtab;
+	std::vector<uint64_t> names;
+	for (std::list<pool>::const_iterator it = pools.begin(); it != pools.end(); ++it) {
+		names.push_back(strtab.size());
+		strtab.append(it->name.c_str(), it->name.size() + 1);
+	}
+
+	mt_header h;
+	memset(&h, 0, sizeof(h));
+	memcpy(h.magic, METRICS_MAGIC, sizeof(h.magic));
+	h.version = METRICS_VERSION;
+	h.interval = _interval;
+	h.npools = names.size();
+	h.strtab_off = sizeof(h);
+	h.strtab_size = strtab.size();
+	h.pools_off = h.strtab_off + (strtab.size() + 7) / 8 * 8;
+	h.records_off = h.pools_off + names.size() * sizeof(uint64_t);
+	if (fwrite(&h, sizeof(h), 1, _fp) != 1 ||
+	    !write_padded(_fp, strtab.data(), strtab.size()) ||
+	    (names.size() &&
+	     fwrite(&names[0], sizeof(uint64_t), names.size(), _fp) != names.size()) ||
+	    fflush(_fp)) {
+		ULIB_WARNING("failed to write the metrics header, metrics are not recorded");
+		close();
+		return -1;
+	}
+	_started = true;
+	return 0;
+}
+
+static void fill_share(const fs_context &ctx, double last_at_ms, double last_at_hf,
+		       mt_share *s)
+{
+	s->demand = ctx.demand;
+	s->running = ctx.alloc;
+	s->fairshare = ctx.fairshare;
+	s->minshare = ctx.minshare;
+	s->weight = ctx.weight;
+	s->last_at_ms = last_at_ms;
+	s->last_at_hf = last_at_hf;
+}
+
+void metrics_recorder::record(const std::list<pool> &pools, double now)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_METRICS);
+	uint32_t i = 0;
+
+	for (std::list<pool>::const_iterator it = pools.begin(); it != pools.end(); ++it, ++i) {
+		if (_buf.size() == METRICS_BLOCK_RECORDS && flush())
+			ULIB_WARNING("failed to write metrics");
+		mt_record r;
+		r.time = now;
+		r.pool = i;
+		r.reserved = 0;
+		fill_share(it->fs_ctx_map, it->map_last_at_ms, it->map_last_at_hf, &r.map);
+		fill_share(it->fs_ctx_reduce, it->reduce_last_at_ms, it->reduce_last_at_hf,
+			   &r.reduce);
+		_buf.push_back(r);
+	}
+}
+
+void metrics_recorder::sample(const std::list<pool> &pools, double next_event)
+{
+	record(pools, _next);
+	if (!(_interval > 0)) {
+		_next = next_event;
+		return;
+	}
+	// sample times are kept on the grid from the origin
+	double n = ceil((next_event - _origin) / _interval);
+	_next = _origin + n * _interval;
+	if (_next < next_event)
+		_next += _interval;
+}
+
+int metrics_recorder::flush()
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_METRICS);
+	if (_fp == NULL || _buf.empty())
+		return 0;
+	size_t n = fwrite(&_buf[0], sizeof(mt_record), _buf.size(), _fp);
+	bool ok = n == _buf.size();
+	_buf.clear();
+	return ok && fflush(_fp) == 0? 0: -1;
+}
+
+metrics_file::metrics_file()
+	: _data(NULL), _size(0), _hdr(NULL), _strtab(NULL), _pools(NULL),
+	  _records(NULL), _nrecords(0)
+{
+}
+
+metrics_file::~metrics_file()
+{
+	close();
+}
+
+void metrics_file::close()
+{
+	if (_data)
+		munmap((void *)_data, _size);
+	_data = NULL;
+	_size = 0;
+	_hdr = NULL;
+	_strtab = NULL;
+	_pools = NULL;
+	_records = NULL;
+	_nrecords = 0;
+}
+
+int metrics_file::open(const char *file)
+{
+	close();
+
+	int fd = ::open(file, O_RDONLY);
+	if (fd == -1) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(mt_header)) {
+		ULIB_WARNING("%s is not a metrics stream", file);
+		::close(fd);
+		return -1;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		ULIB_WARNING("cannot map %s", file);
+		return -1;
+	}
+	_data = (const char *)data;
+	_size = st.st_size;
+	_hdr = (const mt_header *)_data;
+
+	const mt_header &h = *_hdr;
+	if (memcmp(h.magic, METRICS_MAGIC, sizeof(h.magic)) ||
+	    h.version != METRICS_VERSION ||
+	    h.strtab_off > _size || h.strtab_size > _size - h.strtab_off ||
+	    (h.strtab_size && _data[h.strtab_off + h.strtab_size - 1] != '\0') ||
+	    h.pools_off % 8 || h.pools_off > _size ||
+	    h.npools > (_size - h.pools_off) / sizeof(uint64_t) ||
+	    h.records_off % 8 || h.records_off > _size ||
+	    h.records_off < h.pools_off + h.npools * sizeof(uint64_t)) {
+		ULIB_WARNING("%s is not a valid metrics stream", file);
+		close();
+		return -1;
+	}
+	_strtab = _data + h.strtab_off;
+	_pools = (const uint64_t *)(_data + h.pools_off);
+	_records = (const mt_record *)(_data + h.records_off);
+	_nrecords = (_size - h.records_off) / sizeof(mt_record);
+
+	for (size_t i = 0; i < h.npools; ++i) {
+		if (_pools[i] >= h.strtab_size) {
+			ULIB_WARNING("%s has a corrupted pool directory", file);
+			close();
+			return -1;
+		}
+	}
+	for (size_t i = 0; i < _nrecords; ++i) {
+		if (_records[i].pool >= h.npools) {
+			ULIB_WARNING("%s has a corrupted record %zu", file, i);
+			close();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int metrics_file::write_text(FILE *fp) const
+{
+	for (size_t i = 0; i < _nrecords; ++i) {
+		const mt_record &r = _records[i];
+		const char *name = pool_name(r.pool);
+		const mt_share *s[] = { &r.map, &r.reduce };
+		const char *type[] = { "map", "reduce" };
+		int ret = 0;
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tdemand\t%d\n", r.time, name, type[k], s[k]->demand);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tfairShare\t%lf\n", r.time, name, type[k], s[k]->fairshare);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tlastTimeAtMinShare\t%lf\n", r.time, name, type[k], s[k]->last_at_ms);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tlastTimeAtHalfFairShare\t%lf\n", r.time, name, type[k], s[k]->last_at_hf);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tminShare\t%lf\n", r.time, name, type[k], s[k]->minshare);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\trunningTasks\t%d\n", r.time, name, type[k], s[k]->running);
+		for (int k = 0; k < 2 && ret >= 0; ++k)
+			ret = fprintf(fp, "%lf\t%s\t%s\tweight\t%lf\n", r.time, name, type[k], s[k]->weight);
+		if (ret < 0)
+			return -1;
+	}
+
+	return 0;
+}
+
+}
@@ -24,6 +24,7 @@ namespace Tempo
 
 pool::pool(const std::string &ns, double mto, double fto,
 	   double weight, int minmap, int minred, sched_mode sc)
+	: parent(NULL), map_children_total(-1), reduce_children_total(-1)
 {
 	reinit(ns, mto, fto, weight, minmap, minred, sc);
 }
@@ -46,6 +47,8 @@ void pool::reinit(const std::string &ns, double mto, double fto,
 	fs_ctx_reduce.weight = weight;
 	fs_ctx_map.minshare = minmap;
 	fs_ctx_reduce.minshare = minred;
+	map_children_total = -1;
+	reduce_children_total = -1;
 }
 
 job &pool::add_job(const job &j)
@@ -55,11 +58,31 @@ job &pool::add_job(const job &j)
 	return jobs.back();
 }
 
+int pool::depth() const
+{
+	int d = 0;
+	for (const pool *p = parent; p; p = p->parent)
+		++d;
+	return d;
+}
+
+void pool::set_parent(pool *p)
+{
+	parent = p;
+	if (p)
+		p->children.push_back(this);
+}
+
 uint64_t pool::id_from_str(const char *str)
 {
 	return hash_fast64(str, strlen(str), 0xdeedbeeffeedbeefull);
 }
 
+uint64_t pool::id_from_str(const char *str, size_t len)
+{
+	return hash_fast64(str, len, 0xdeedbeeffeedbeefull);
+}
+
 // returns the number of needed slots if starved for minimum share, 0 otherwise
 int pool::starved_for_map_minshare(double now) const
 {
@@ -185,25 +208,4 @@ std::string pool::to_str() const
 	return s;
 }
 
-void pool::print_metrics(metric met) const
-{
-	metric met_map = met["map"];
-	metric met_red = met["reduce"];
-
-	met_map["demand"].set_value(fs_ctx_map.demand);
-	met_red["demand"].set_value(fs_ctx_reduce.demand);
-	met_map["fairShare"].set_value(fs_ctx_map.fairshare);
-	met_red["fairShare"].set_value(fs_ctx_reduce.fairshare);
-	met_map["lastTimeAtMinShare"].set_value(map_last_at_ms);
-	met_red["lastTimeAtMinShare"].set_value(reduce_last_at_ms);
-	met_map["lastTimeAtHalfFairShare"].set_value(map_last_at_hf);
-	met_red["lastTimeAtHalfFairShare"].set_value(reduce_last_at_hf);
-	met_map["minShare"].set_value(fs_ctx_map.minshare);
-	met_red["minShare"].set_value(fs_ctx_reduce.minshare);
-	met_map["runningTasks"].set_value(fs_ctx_map.alloc);
-	met_red["runningTasks"].set_value(fs_ctx_reduce.alloc);
-	met_map["weight"].set_value(fs_ctx_map.weight);
-	met_red["weight"].set_value(fs_ctx_reduce.weight);
-}
-
 }
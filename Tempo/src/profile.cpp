@@ -0,0 +1,381 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include "profile.hpp"
+
+#ifdef TEMPO_PROFILE
+
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <time.h>
+
+// queue depth samples kept, every other one is dropped when full
+#define PROFILE_NSAMPLES 1024
+
+namespace Tempo {
+
+static const char *timer_names[PROF_NTIMERS] = {
+	"ev_create_map",
+	"ev_create_reduce",
+	"ev_finish_map",
+	"ev_finish_reduce",
+	"ev_preempt_map",
+	"ev_preempt_reduce",
+	"compute_fairshares",
+	"selector::see_maps",
+	"selector::see_reduces",
+	"selector::pop_map",
+	"selector::pop_reduce",
+	"engine::preempt_maps",
+	"engine::preempt_reduces"
+};
+
+struct profile_sample_point {
+	double time;
+	size_t events;
+	size_t maps_waiting;
+	size_t reduces_waiting;
+	size_t maps_running;
+	size_t reduces_running;
+};
+
+// allocation counts at an event count
+struct profile_snapshot {
+	uint64_t events;
+	uint64_t allocs[ALLOC_NSUBSYSTEMS];
+};
+
+struct profile_state {
+	uint64_t calls[PROF_NTIMERS];
+	uint64_t ticks[PROF_NTIMERS];
+	uint64_t start_ticks;
+	double   start_ns;
+	uint64_t events;
+	size_t   stride;     // events between two samples
+	size_t   countdown;  // events until the next sample
+	size_t   nsamples;
+	profile_sample_point samples[PROFILE_NSAMPLES];
+	// taken when the event count reaches a power of two, the
+	// steady-state window starts at the second last one
+	profile_snapshot snap_prev;
+	profile_snapshot snap_cur;
+};
+
+#ifdef TEMPO_PROFILE_ALLOC
+
+static const char *subsystem_names[ALLOC_NSUBSYSTEMS] = {
+	"other",
+	"events",
+	"selector",
+	"fsched",
+	"hlist",
+	"import",
+	"metrics",
+	"trace"
+};
+
+// process-wide, blocks may be freed by another thread
+struct alloc_counts {
+	uint64_t allocs;
+	uint64_t frees;
+	uint64_t bytes;
+	int64_t  live;
+	int64_t  peak;
+};
+
+static alloc_counts alloc_stats[ALLOC_NSUBSYSTEMS];
+
+__thread int profile_alloc_tag;
+
+void profile_alloc_note(alloc_subsystem s, size_t bytes)
+{
+	alloc_counts &c = alloc_stats[s];
+	__sync_fetch_and_add(&c.allocs, 1);
+	__sync_fetch_and_add(&c.bytes, bytes);
+	int64_t live = __sync_add_and_fetch(&c.live, (int64_t)bytes);
+	if (live > c.peak)
+		c.peak = live;
+}
+
+void profile_free_note(alloc_subsystem s, size_t bytes)
+{
+	alloc_counts &c = alloc_stats[s];
+	__sync_fetch_and_add(&c.frees, 1);
+	__sync_fetch_and_sub(&c.live, (int64_t)bytes);
+}
+
+static void take_snapshot(profile_snapshot *snap, uint64_t events)
+{
+	snap->events = events;
+	for (int i = 0; i < ALLOC_NSUBSYSTEMS; ++i)
+		snap->allocs[i] = alloc_stats[i].allocs;
+}
+
+#endif
+
+static __thread profile_state *state;
+
+static double monotonic_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+uint64_t profile_ticks()
+{
+#if defined(__x86_64__) || defined(__i386__)
+	return __builtin_ia32_rdtsc();
+#else
+	return monotonic_ns();
+#endif
+}
+
+static profile_state *get_state()
+{
+	if (state == NULL) {
+		state = new profile_state;
+		profile_reset();
+	}
+	return state;
+}
+
+void profile_reset()
+{
+	profile_state *s = get_state();
+	memset(s->calls, 0, sizeof(s->calls));
+	memset(s->ticks, 0, sizeof(s->ticks));
+	s->events = 0;
+	s->stride = 1;
+	s->countdown = 0;
+	s->nsamples = 0;
+	memset(&s->snap_prev, 0, sizeof(s->snap_prev));
+	memset(&s->snap_cur, 0, sizeof(s->snap_cur));
+#ifdef TEMPO_PROFILE_ALLOC
+	for (int i = 0; i < ALLOC_NSUBSYSTEMS; ++i) {
+		alloc_counts &c = alloc_stats[i];
+		__sync_fetch_and_sub(&c.allocs, c.allocs);
+		__sync_fetch_and_sub(&c.frees, c.frees);
+		__sync_fetch_and_sub(&c.bytes, c.bytes);
+		c.peak = c.live;
+	}
+#endif
+	s->start_ns = monotonic_ns();
+	s->start_ticks = profile_ticks();
+}
+
+void profile_add(profile_timer id, uint64_t ticks)
+{
+	profile_state *s = get_state();
+	++s->calls[id];
+	s->ticks[id] += ticks;
+}
+
+bool profile_sample_due()
+{
+	profile_state *s = get_state();
+	uint64_t n = ++s->events;
+	if ((n & (n - 1)) == 0) {
+		s->snap_prev = s->snap_cur;
+#ifdef TEMPO_PROFILE_ALLOC
+		take_snapshot(&s->snap_cur, s->events);
+#endif
+	}
+	if (s->countdown) {
+		--s->countdown;
+		return false;
+	}
+	s->countdown = s->stride - 1;
+	return true;
+}
+
+void profile_sample(double now, size_t events, size_t maps_waiting,
+		    size_t reduces_waiting, size_t maps_running,
+		    size_t reduces_running)
+{
+	profile_state *s = get_state();
+	if (s->nsamples == PROFILE_NSAMPLES) {
+		// halve the resolution to cover the whole run
+		for (size_t i = 0; i < PROFILE_NSAMPLES / 2; ++i)
+			s->samples[i] = s->samples[2 * i];
+		s->nsamples = PROFILE_NSAMPLES / 2;
+		s->stride *= 2;
+		s->countdown = s->stride - 1;
+	}
+	profile_sample_point &p = s->samples[s->nsamples++];
+	p.time = now;
+	p.events = events;
+	p.maps_waiting = maps_waiting;
+	p.reduces_waiting = reduces_waiting;
+	p.maps_running = maps_running;
+	p.reduces_running = reduces_running;
+}
+
+void profile_report(FILE *fp)
+{
+	profile_state *s = get_state();
+	double ns = monotonic_ns() - s->start_ns;
+	uint64_t ticks = profile_ticks() - s->start_ticks;
+	double ns_per_tick = ticks? ns / ticks: 0;
+
+	fprintf(fp, "Profile of %.3f ms, times include nested calls\n", ns / 1e6);
+	fprintf(fp, "%-24s %12s %12s %10s\n", "timer", "calls", "total(ms)", "avg(us)");
+	for (int i = 0; i < PROF_NTIMERS; ++i) {
+		double t = s->ticks[i] * ns_per_tick;
+		fprintf(fp, "%-24s %12lu %12.3f %10.3f\n", timer_names[i],
+			(unsigned long)s->calls[i], t / 1e6,
+			s->calls[i]? t / 1e3 / s->calls[i]: 0);
+	}
+
+#ifdef TEMPO_PROFILE_ALLOC
+	uint64_t steady = s->events - s->snap_prev.events;
+	fprintf(fp, "Allocations, steady state over the last %lu of %lu events\n",
+		(unsigned long)steady, (unsigned long)s->events);
+	fprintf(fp, "%-10s %12s %12s %14s %14s %14s %14s\n", "subsystem", "allocs",
+		"frees", "bytes", "live", "peak", "steady/event");
+	for (int i = 0; i < ALLOC_NSUBSYSTEMS; ++i) {
+		const alloc_counts &c = alloc_stats[i];
+		uint64_t n = c.allocs - s->snap_prev.allocs[i];
+		fprintf(fp, "%-10s %12lu %12lu %14lu %14ld %14ld %14.3f\n",
+			subsystem_names[i], (unsigned long)c.allocs,
+			(unsigned long)c.frees, (unsigned long)c.bytes,
+			(long)c.live, (long)c.peak, steady? (double)n / steady: 0);
+	}
+#endif
+
+	fprintf(fp, "Queue depths, sampled every %zu events\n", s->stride);
+	fprintf(fp, "%-18s %10s %12s %15s %12s %15s\n", "time", "events",
+		"maps_waiting", "reduces_waiting", "maps_running", "reduces_running");
+	for (size_t i = 0; i < s->nsamples; ++i) {
+		const profile_sample_point &p = s->samples[i];
+		fprintf(fp, "%-18f %10zu %12zu %15zu %12zu %15zu\n", p.time, p.events,
+			p.maps_waiting, p.reduces_waiting, p.maps_running,
+			p.reduces_running);
+	}
+}
+
+#ifdef TEMPO_PROFILE_ALLOC
+
+uint64_t profile_steady_allocs()
+{
+	profile_state *s = get_state();
+	uint64_t n = 0;
+	for (int i = 0; i < ALLOC_NSUBSYSTEMS; ++i)
+		n += alloc_stats[i].allocs - s->snap_prev.allocs[i];
+	return n;
+}
+
+uint64_t profile_steady_events()
+{
+	profile_state *s = get_state();
+	return s->events - s->snap_prev.events;
+}
+
+#endif
+
+}
+
+#ifdef TEMPO_PROFILE_ALLOC
+
+// Each block is preceded by its size and subsystem, keeping the
+// alignment of malloc()
+union alloc_header {
+	struct {
+		size_t size;
+		int    tag;
+	} h;
+	long double align;
+};
+
+static void *tagged_alloc(size_t size)
+{
+	alloc_header *p = (alloc_header *)malloc(sizeof(alloc_header) + size);
+	if (p == NULL)
+		return NULL;
+	p->h.size = size;
+	p->h.tag = Tempo::profile_alloc_tag;
+	Tempo::profile_alloc_note((Tempo::alloc_subsystem)p->h.tag, size);
+	return p + 1;
+}
+
+static void tagged_free(void *ptr)
+{
+	if (ptr == NULL)
+		return;
+	alloc_header *p = (alloc_header *)ptr - 1;
+	Tempo::profile_free_note((Tempo::alloc_subsystem)p->h.tag, p->h.size);
+	free(p);
+}
+
+void *operator new(size_t size) throw(std::bad_alloc)
+{
+	void *p = tagged_alloc(size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new[](size_t size) throw(std::bad_alloc)
+{
+	void *p = tagged_alloc(size);
+	if (p == NULL)
+		throw std::bad_alloc();
+	return p;
+}
+
+void *operator new(size_t size, const std::nothrow_t &) throw()
+{
+	return tagged_alloc(size);
+}
+
+void *operator new[](size_t size, const std::nothrow_t &) throw()
+{
+	return tagged_alloc(size);
+}
+
+void operator delete(void *ptr) throw()
+{
+	tagged_free(ptr);
+}
+
+void operator delete[](void *ptr) throw()
+{
+	tagged_free(ptr);
+}
+
+void operator delete(void *ptr, const std::nothrow_t &) throw()
+{
+	tagged_free(ptr);
+}
+
+void operator delete[](void *ptr, const std::nothrow_t &) throw()
+{
+	tagged_free(ptr);
+}
+
+#endif
+
+#endif
+
+namespace Tempo {
+
+// the setting the library was built with, see profile.hpp
+#ifdef TEMPO_PROFILE_ALLOC
+extern const int library_built_with_TEMPO_PROFILE_ALLOC = 1;
+#else
+extern const int library_built_without_TEMPO_PROFILE_ALLOC = 1;
+#endif
+
+}
@@ -0,0 +1,168 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_PROFILE_H
+#define _COLOSSAL_PROFILE_H
+
+#include <cstddef>
+#include <cstdio>
+#include <stdint.h>
+
+// Instrumentation of the simulation hot paths
+//
+// Built in only with -DTEMPO_PROFILE (make PROFILE=-DTEMPO_PROFILE),
+// otherwise the macros below expand to nothing. Counts and times of
+// the event handlers and of the scheduling steps are kept per thread
+// along with samples of the queue depths, and printed at the end of
+// each engine::process(). Times include nested calls, e.g. the
+// selector steps are part of the event handler that calls them.
+//
+// -DTEMPO_PROFILE_ALLOC also accounts the allocations made through
+// operator new to the innermost subsystem scope they are made in, and
+// implies -DTEMPO_PROFILE. Blocks are charged to the subsystem that
+// allocated them when freed. ulib allocates with malloc and is not
+// seen, except the nodes of hlist which are noted explicitly. The
+// report adds the counts of the run, peak and final live bytes and
+// the allocations per event over the last half or more of the events.
+
+#if defined(TEMPO_PROFILE_ALLOC) && !defined(TEMPO_PROFILE)
+#define TEMPO_PROFILE
+#endif
+
+namespace Tempo {
+
+enum profile_timer {
+	PROF_EV_CREATE_MAP,
+	PROF_EV_CREATE_REDUCE,
+	PROF_EV_FINISH_MAP,
+	PROF_EV_FINISH_REDUCE,
+	PROF_EV_PREEMPT_MAP,
+	PROF_EV_PREEMPT_REDUCE,
+	PROF_FAIRSHARES,
+	PROF_SEE_MAPS,
+	PROF_SEE_REDUCES,
+	PROF_POP_MAP,
+	PROF_POP_REDUCE,
+	PROF_PREEMPT_MAPS,
+	PROF_PREEMPT_REDUCES,
+	PROF_NTIMERS
+};
+
+enum alloc_subsystem {
+	ALLOC_OTHER,
+	ALLOC_EVENTS,
+	ALLOC_SELECTOR,
+	ALLOC_FSCHED,
+	ALLOC_HLIST,
+	ALLOC_IMPORT,
+	ALLOC_METRICS,
+	ALLOC_TRACE,
+	ALLOC_NSUBSYSTEMS
+};
+
+#ifdef TEMPO_PROFILE
+
+uint64_t profile_ticks();
+void profile_add(profile_timer id, uint64_t ticks);
+bool profile_sample_due();
+void profile_sample(double now, size_t events, size_t maps_waiting,
+		    size_t reduces_waiting, size_t maps_running,
+		    size_t reduces_running);
+void profile_reset();
+void profile_report(FILE *fp);
+
+// Times the enclosing scope
+class profile_scope
+{
+public:
+	profile_scope(profile_timer id) : _id(id), _start(profile_ticks()) { }
+	~profile_scope() { profile_add(_id, profile_ticks() - _start); }
+
+private:
+	profile_timer _id;
+	uint64_t      _start;
+};
+
+#define PROFILE_SCOPE(id) profile_scope _profile_scope(id)
+#define PROFILE_SAMPLE(now, events, mwait, rwait, mrun, rrun)		\
+	do {								\
+		if (profile_sample_due())				\
+			profile_sample(now, events, mwait, rwait, mrun, rrun); \
+	} while (0)
+#define PROFILE_RESET()    profile_reset()
+#define PROFILE_REPORT(fp) profile_report(fp)
+
+#else
+
+#define PROFILE_SCOPE(id)
+#define PROFILE_SAMPLE(now, events, mwait, rwait, mrun, rrun)
+#define PROFILE_RESET()
+#define PROFILE_REPORT(fp)
+
+#endif
+
+// hlist notes its nodes inline, so the library and the code using it
+// have to agree on -DTEMPO_PROFILE_ALLOC. Each side references the
+// symbol of its own setting, which the library defines for its own
+// setting only, so that mixing them fails to link.
+#ifdef TEMPO_PROFILE_ALLOC
+extern const int library_built_with_TEMPO_PROFILE_ALLOC;
+static const int *const profile_alloc_check __attribute__((used)) =
+	&library_built_with_TEMPO_PROFILE_ALLOC;
+#else
+extern const int library_built_without_TEMPO_PROFILE_ALLOC;
+static const int *const profile_alloc_check __attribute__((used)) =
+	&library_built_without_TEMPO_PROFILE_ALLOC;
+#endif
+
+#ifdef TEMPO_PROFILE_ALLOC
+
+// subsystem charged for the allocations of the thread
+extern __thread int profile_alloc_tag;
+
+void profile_alloc_note(alloc_subsystem s, size_t bytes);
+void profile_free_note(alloc_subsystem s, size_t bytes);
+
+// Allocations made since the steady-state window of the run started,
+// and the events processed in it, e.g. to check that a benchmark stays
+// within a number of allocations per event, see test/bench_alloc.cpp
+uint64_t profile_steady_allocs();
+uint64_t profile_steady_events();
+
+// Charges the allocations of the enclosing scope to a subsystem
+class alloc_scope
+{
+public:
+	alloc_scope(alloc_subsystem s) : _saved(profile_alloc_tag) { profile_alloc_tag = s; }
+	~alloc_scope() { profile_alloc_tag = _saved; }
+
+private:
+	int _saved;
+};
+
+#define PROFILE_ALLOC_SCOPE(s)       alloc_scope _alloc_scope(s)
+#define PROFILE_ALLOC_NOTE(s, bytes) profile_alloc_note(s, bytes)
+#define PROFILE_FREE_NOTE(s, bytes)  profile_free_note(s, bytes)
+
+#else
+
+#define PROFILE_ALLOC_SCOPE(s)
+#define PROFILE_ALLOC_NOTE(s, bytes)
+#define PROFILE_FREE_NOTE(s, bytes)
+
+#endif
+
+}
+
+#endif
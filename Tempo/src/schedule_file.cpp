@@ -0,0 +1,442 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ulib/util_log.h>
+#include "helper.hpp"
+#include "schedule_file.hpp"
+
+// tasks formatted per chunk, chunks never span pools
+#define SCHEDULE_CHUNK_TASKS 16384
+// chunks a thread may format ahead of the writer
+#define SCHEDULE_WINDOW      4
+// output flushed by write_text() in blocks of this size
+#define SCHEDULE_TEXT_BLOCK  (1 << 20)
+
+namespace Tempo {
+
+// Append a row in the text format
+// @job and @task are NULL for unnamed jobs and tasks.
+static void append_text_row(std::string *out, const sc_row &r, const char *pool,
+			    const char *job, const char *task, bool predicted)
+{
+	char ibuf[17];
+	char buf[8 * 33];
+	char *p;
+
+	out->append(pool);
+	out->push_back('\t');
+	out->append(name_or_id(job, r.job_id, ibuf));
+	p = buf;
+	*p++ = ':';
+	p += format_double(r.weight, p);
+	*p++ = '\t';
+	out->append(buf, p - buf);
+	out->append(name_or_id(task, r.task_id, ibuf));
+	p = buf;
+	*p++ = '\t';
+	p += format_double(r.type, p);
+	*p++ = '\t';
+	p += format_double(r.ctime, p);
+	*p++ = '\t';
+	p += format_double(r.ptime, p);
+	*p++ = '\t';
+	p += format_double(r.stime, p);
+	if (predicted) {
+		*p++ = '\t';
+		p += format_double(r.stime1, p);
+	}
+	*p++ = '\t';
+	p += format_double(r.ftime, p);
+	if (predicted) {
+		*p++ = '\t';
+		p += format_double(r.ftime1, p);
+	}
+	*p++ = '\n';
+	out->append(buf, p - buf);
+}
+
+// a run of jobs of one pool, formatted into its own buffer
+struct export_chunk {
+	const pool *p;
+	bool        observed;  // print the observed times of the pool
+	size_t      first;     // jobs [first, last)
+	size_t      last;
+	size_t      first_task; // index of the first task in the pool
+	uint64_t    pool_off;  // string table offset of the pool name
+	uint64_t    names_off; // string table offset of the pool names
+	std::string out;
+	bool        done;
+};
+
+struct export_ctx {
+	std::vector<export_chunk> chunks;
+	schedule_format fmt;
+	size_t          next;     // next chunk to format
+	size_t          written;  // chunks written so far
+	size_t          window;
+	bool            failed;
+	pthread_mutex_t lock;
+	pthread_cond_t  formatted;
+	pthread_cond_t  consumed;
+};
+
+static void format_chunk(schedule_format fmt, export_chunk *c)
+{
+	const pool &p = *c->p;
+	size_t i = c->first_task;
+	sc_row r;
+
+	memset(&r, 0, sizeof(r));
+	r.pool = c->pool_off;
+	r.stime1 = -1;
+	r.ftime1 = -1;
+	for (size_t j = c->first; j < c->last; ++j) {
+		const job &jb = p.jobs[j];
+		r.job = jb.name? c->names_off + jb.name: 0;
+		r.job_id = jb.id;
+		task::task_type order[] = { task::TASK_TYPE_MAP, task::TASK_TYPE_REDUCE };
+		for (int o = 0; o < task::TASK_TYPE_NUM; ++o) {
+			const job::task_container_type &tasks = jb.tasks[order[o]];
+			r.type = order[o];
+			r.weight = order[o] == task::TASK_TYPE_MAP?
+				jb.fs_ctx_map.weight: jb.fs_ctx_reduce.weight;
+			for (size_t k = 0; k < tasks.size(); ++k, ++i) {
+				const task &t = tasks[k];
+				r.task = t.name? c->names_off + t.name: 0;
+				r.task_id = t.id;
+				r.ctime = t.ctime;
+				r.ptime = t.ptime;
+				if (c->observed) {
+					r.stime = p.observed_stimes[i];
+					r.ftime = p.observed_ftimes[i];
+					r.stime1 = t.stime;
+					r.ftime1 = t.ftime;
+				} else {
+					r.stime = t.stime;
+					r.ftime = t.ftime;
+				}
+				if (fmt == SCHEDULE_BINARY)
+					c->out.append((const char *)&r, sizeof(r));
+				else
+					append_text_row(&c->out, r, p.name.c_str(),
+							p.name_of(jb), p.name_of(t), c->observed);
+			}
+		}
+	}
+}
+
+static void *export_worker(void *arg)
+{
+	export_ctx *ctx = (export_ctx *)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&ctx->lock);
+		while (!ctx->failed && ctx->next < ctx->chunks.size() &&
+		       ctx->next >= ctx->written + ctx->window)
+			pthread_cond_wait(&ctx->consumed, &ctx->lock);
+		if (ctx->failed || ctx->next == ctx->chunks.size()) {
+			pthread_mutex_unlock(&ctx->lock);
+			break;
+		}
+		export_chunk &c = ctx->chunks[ctx->next++];
+		pthread_mutex_unlock(&ctx->lock);
+
+		format_chunk(ctx->fmt, &c);
+
+		pthread_mutex_lock(&ctx->lock);
+		c.done = true;
+		pthread_cond_broadcast(&ctx->formatted);
+		pthread_mutex_unlock(&ctx->lock);
+	}
+	return NULL;
+}
+
+// Split the pools into chunks and lay out the string table
+// Returns the number of rows, or -1 if the observed times are missing.
+static long plan_chunks(const job_tracker::pool_container_type &pools, bool observed,
+			std::vector<export_chunk> *chunks, uint64_t *strtab_size)
+{
+	export_chunk c;
+	long nrows = 0;
+	uint64_t off = 1;  // offset 0 is the empty string
+
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		c.p = &*pit;
+		c.observed = observed;
+		c.pool_off = off;
+		off += pit->name.size() + 1;
+		c.names_off = off;
+		off += pit->names.size();
+		c.done = false;
+		size_t ntasks = 0;
+		size_t ptasks = 0;
+		c.first = 0;
+		c.first_task = 0;
+		for (size_t j = 0; j < pit->jobs.size(); ++j) {
+			const job &jb = pit->jobs[j];
+			ntasks += jb.tasks[task::TASK_TYPE_MAP].size() +
+				jb.tasks[task::TASK_TYPE_REDUCE].size();
+			if (ntasks >= SCHEDULE_CHUNK_TASKS || j + 1 == pit->jobs.size()) {
+				c.last = j + 1;
+				chunks->push_back(c);
+				ptasks += ntasks;
+				ntasks = 0;
+				c.first = j + 1;
+				c.first_task = ptasks;
+			}
+		}
+		if (observed && (pit->observed_stimes.size() != ptasks ||
+				 pit->observed_ftimes.size() != ptasks)) {
+			ULIB_WARNING("observed times of pool %s have not been kept",
+				     pit->name.c_str());
+			return -1;
+		}
+		nrows += ptasks;
+	}
+	*strtab_size = off;
+
+	return nrows;
+}
+
+// Write the string table laid out by plan_chunks()
+static bool write_strtab(FILE *fp, const job_tracker::pool_container_type &pools,
+			 uint64_t size)
+{
+	bool ok = fputc('\0', fp) != EOF;
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end() && ok; ++pit)
+		ok = fwrite(pit->name.c_str(), pit->name.size() + 1, 1, fp) == 1 &&
+			fwrite(pit->names.str(0), pit->names.size(), 1, fp) == 1;
+	// pad the rows to 8 bytes
+	for (uint64_t n = size; n % 8 && ok; ++n)
+		ok = fputc('\0', fp) != EOF;
+	return ok;
+}
+
+static int export_rows(const char *file, const job_tracker::pool_container_type &pools,
+		       bool observed, schedule_format fmt, int nthreads)
+{
+	export_ctx ctx;
+	uint64_t strtab_size;
+
+	long nrows = plan_chunks(pools, observed, &ctx.chunks, &strtab_size);
+	if (nrows < 0)
+		return -1;
+
+	FILE *fp = fopen(file, "wb");
+	if (fp == NULL) {
+		ULIB_WARNING("cannot open %s for writing", file);
+		return -1;
+	}
+
+	bool ok = true;
+	if (fmt == SCHEDULE_BINARY) {
+		sc_header h;
+		memset(&h, 0, sizeof(h));
+		memcpy(h.magic, SCHEDULE_MAGIC, sizeof(h.magic));
+		h.version = SCHEDULE_VERSION;
+		h.flags = observed? sc_header::SC_FLAG_PREDICTED: 0;
+		h.nrows = nrows;
+		h.strtab_off = sizeof(h);
+		h.strtab_size = strtab_size;
+		h.rows_off = (sizeof(h) + strtab_size + 7) / 8 * 8;
+		ok = fwrite(&h, sizeof(h), 1, fp) == 1 &&
+			write_strtab(fp, pools, sizeof(h) + strtab_size);
+	}
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+	if ((size_t)nthreads > ctx.chunks.size())
+		nthreads = ctx.chunks.size();
+
+	ctx.fmt = fmt;
+	ctx.next = 0;
+	ctx.written = 0;
+	ctx.window = SCHEDULE_WINDOW * (nthreads > 0? nthreads: 1);
+	ctx.failed = false;
+	pthread_mutex_init(&ctx.lock, NULL);
+	pthread_cond_init(&ctx.formatted, NULL);
+	pthread_cond_init(&ctx.consumed, NULL);
+
+	// the calling thread writes the chunks in order as they are
+	// formatted, or formats them itself if no thread could start
+	std::vector<pthread_t> tids(nthreads);
+	int nstarted = 0;
+	for (int i = 0; i < nthreads && ok; ++i)
+		if (pthread_create(&tids[nstarted], NULL, export_worker, &ctx) == 0)
+			++nstarted;
+	for (size_t i = 0; i < ctx.chunks.size() && ok; ++i) {
+		export_chunk &c = ctx.chunks[i];
+		if (nstarted) {
+			pthread_mutex_lock(&ctx.lock);
+			while (!c.done)
+				pthread_cond_wait(&ctx.formatted, &ctx.lock);
+			pthread_mutex_unlock(&ctx.lock);
+		} else
+			format_chunk(fmt, &c);
+		ok = fwrite(c.out.data(), 1, c.out.size(), fp) == c.out.size();
+		std::string().swap(c.out);
+
+		pthread_mutex_lock(&ctx.lock);
+		ctx.written = i + 1;
+		ctx.failed = !ok;
+		pthread_cond_broadcast(&ctx.consumed);
+		pthread_mutex_unlock(&ctx.lock);
+	}
+	for (int i = 0; i < nstarted; ++i)
+		pthread_join(tids[i], NULL);
+
+	pthread_cond_destroy(&ctx.consumed);
+	pthread_cond_destroy(&ctx.formatted);
+	pthread_mutex_destroy(&ctx.lock);
+
+	if (fclose(fp))
+		ok = false;
+	if (!ok)
+		ULIB_WARNING("failed to write the schedule to %s", file);
+
+	return ok? 0: -1;
+}
+
+int export_schedule(const char *file, const job_tracker::pool_container_type &pools,
+		    schedule_format fmt, int nthreads)
+{
+	return export_rows(file, pools, false, fmt, nthreads);
+}
+
+int export_comparison(const char *file, const job_tracker::pool_container_type &pools,
+		      schedule_format fmt, int nthreads)
+{
+	return export_rows(file, pools, true, fmt, nthreads);
+}
+
+schedule_file::schedule_file()
+	: _data(NULL), _size(0), _hdr(NULL), _strtab(NULL), _rows(NULL)
+{
+}
+
+schedule_file::~schedule_file()
+{
+	close();
+}
+
+void schedule_file::close()
+{
+	if (_data)
+		munmap((void *)_data, _size);
+	_data = NULL;
+	_size = 0;
+	_hdr = NULL;
+	_strtab = NULL;
+	_rows = NULL;
+}
+
+bool schedule_file::is_binary(const char *file)
+{
+	char magic[sizeof(((sc_header *)0)->magic)];
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+		return false;
+	bool ret = fread(magic, sizeof(magic), 1, fp) == 1 &&
+		memcmp(magic, SCHEDULE_MAGIC, sizeof(magic)) == 0;
+	fclose(fp);
+	return ret;
+}
+
+int schedule_file::open(const char *file)
+{
+	close();
+
+	int fd = ::open(file, O_RDONLY);
+	if (fd == -1) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(sc_header)) {
+		ULIB_WARNING("%s is not a binary schedule", file);
+		::close(fd);
+		return -1;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		ULIB_WARNING("cannot map %s", file);
+		return -1;
+	}
+	_data = (const char *)data;
+	_size = st.st_size;
+	_hdr = (const sc_header *)_data;
+
+	const sc_header &h = *_hdr;
+	if (memcmp(h.magic, SCHEDULE_MAGIC, sizeof(h.magic)) ||
+	    h.version != SCHEDULE_VERSION ||
+	    h.strtab_off > _size || h.strtab_size == 0 ||
+	    h.strtab_size > _size - h.strtab_off ||
+	    _data[h.strtab_off + h.strtab_size - 1] != '\0' ||
+	    h.rows_off % 8 || h.rows_off > _size ||
+	    h.nrows > (_size - h.rows_off) / sizeof(sc_row)) {
+		ULIB_WARNING("%s is not a valid binary schedule", file);
+		close();
+		return -1;
+	}
+	_strtab = _data + h.strtab_off;
+	_rows = (const sc_row *)(_data + h.rows_off);
+
+	for (size_t i = 0; i < h.nrows; ++i) {
+		if (_rows[i].pool >= h.strtab_size || _rows[i].job >= h.strtab_size ||
+		    _rows[i].task >= h.strtab_size) {
+			ULIB_WARNING("%s has a corrupted row %zu", file, i);
+			close();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int schedule_file::write_text(FILE *fp) const
+{
+	std::string out;
+	bool predicted = has_prediction();
+
+	out.reserve(SCHEDULE_TEXT_BLOCK + 4096);
+	for (size_t i = 0; i < row_count(); ++i) {
+		const sc_row &r = _rows[i];
+		append_text_row(&out, r, str(r.pool),
+				r.job? str(r.job): NULL, r.task? str(r.task): NULL,
+				predicted);
+		if (out.size() >= SCHEDULE_TEXT_BLOCK || i + 1 == row_count()) {
+			if (fwrite(out.data(), 1, out.size(), fp) != out.size())
+				return -1;
+			out.clear();
+		}
+	}
+
+	return 0;
+}
+
+}
@@ -13,59 +13,146 @@
  */
 
 #include <cstdio>
+#include <strings.h>
 #include <ulib/util_log.h>
 #include "fsched.hpp"
 #include "selector.hpp"
+#include "profile.hpp"
 
 namespace Tempo {
 
-selector::selector(const pool_itr_type &pb, const pool_itr_type &pe)
-	: _pb(pb), _pe(pe), _maps_popped(0), _reduces_popped(0)
+template<typename P>
+td_ref * selector::job_select(j2t_type *jobs)
 {
-	for (pool_itr_type pit = pb; pit != pe; ++pit) {
+	typedef typename P::iterator itr_type;
+
+	itr_type jbegin(jobs->begin());
+	itr_type jend(jobs->end());
+	fs_select<itr_type> jfs(jbegin, jend);
+	itr_type jchosen = jfs();
+	if (jchosen == jend) {
+		ULIB_FATAL("should have chosen from a non-empty job");
+		return NULL;
+	}
+
+	td_ref *ret = jchosen.itr.value()->front();
+	jchosen.itr.value()->pop();
+
+	// remove inactive job
+	fs_context &ctx = P::side::context(jchosen.itr.key().ptr->getjob());
+	if (ctx.alloc == ctx.demand) {
+		if (jchosen.itr.value()->size())
+			ULIB_FATAL("task set is non-empty while removing the job");
+		delete jchosen.itr.value();
+		// the job set will be freed if its belonging pool is inactive
+		jobs->erase(jchosen.itr);
+	}
+
+	return ret;
+}
+
+// indexed by pool::sched_mode
+const selector::policy_entry selector::_policies[] = {
+	{ "FAIR",
+	  &selector::job_select< fair_policy<map_side> >,
+	  &selector::job_select< fair_policy<reduce_side> > },
+	{ "FCFS",
+	  &selector::job_select< fcfs_policy<map_side> >,
+	  &selector::job_select< fcfs_policy<reduce_side> > }
+};
+
+const selector::policy_entry *selector::get_policy(pool::sched_mode mode)
+{
+	if (mode < 0 || mode >= pool::SCHED_NMODES)
+		return NULL;
+	return &_policies[mode];
+}
+
+bool selector::parse_sched_mode(const char *name, pool::sched_mode *mode)
+{
+	// "fifo" is accepted as an alias of "fcfs"
+	if (strcasecmp(name, "fifo") == 0) {
+		*mode = pool::SCHED_FCFS;
+		return true;
+	}
+	for (int i = 0; i < pool::SCHED_NMODES; ++i) {
+		if (strcasecmp(name, _policies[i].name) == 0) {
+			*mode = (pool::sched_mode)i;
+			return true;
+		}
+	}
+	return false;
+}
+
+template<typename S>
+void selector::add_tasks(pool *p, job *j)
+{
+	job::task_container_type &tasks = j->tasks[S::type];
+	for (job::task_container_type::iterator tit = tasks.begin();
+	     tit != tasks.end(); ++tit) {
+		task_desc *td = new task_desc(&*tit, j, p);
+		S::state(this).refs.push_back(new td_ref(td));
+	}
+}
+
+selector::selector(const pool_itr_type &pb, const pool_itr_type &pe,
+		   const workload_view *view)
+	: _pb(pb), _pe(pe)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	for (size_t i = 0; view && i < view->parts.size(); ++i) {
+		const workload_view::part &part = view->parts[i];
+		for (const wi_task *t = part.tasks; t != part.tasks_end; ++t) {
+			job *j = &part.p->jobs[t->job];
+			task_desc *td = new task_desc(&part.task_at(*t), j, part.p);
+			td_ref *p = new td_ref(td);
+			if (t->type() == task::TASK_TYPE_MAP)
+				_maps.refs.push_back(p);
+			else
+				_reduces.refs.push_back(p);
+		}
+	}
+	for (pool_itr_type pit = pb; !view && pit != pe; ++pit) {
 		for (pool::job_container_type::iterator jit = pit->jobs.begin();
 		     jit != pit->jobs.end(); ++jit) {
-			for (job::task_container_type::iterator tit = jit->tasks[task::TASK_TYPE_MAP].begin();
-			     tit != jit->tasks[task::TASK_TYPE_MAP].end(); ++tit) {
-				task_desc *td = new task_desc(&*tit, &*jit, &*pit);
-				td_ref *p = new td_ref(td);
-				_map_refs.push_back(p);
-			}
-			for (job::task_container_type::iterator tit = jit->tasks[task::TASK_TYPE_REDUCE].begin();
-			     tit != jit->tasks[task::TASK_TYPE_REDUCE].end(); ++tit) {
-				task_desc *td = new task_desc(&*tit, &*jit, &*pit);
-				td_ref *p  = new td_ref(td);
-				_reduce_refs.push_back(p);
-			}
+			add_tasks<map_side>(&*pit, &*jit);
+			add_tasks<reduce_side>(&*pit, &*jit);
 		}
 	}
-	heap_init_inclass(&*_map_refs.begin(), &*_map_refs.end());
-	heap_init_inclass(&*_reduce_refs.begin(), &*_reduce_refs.end());
+	heap_init_inclass(&*_maps.refs.begin(), &*_maps.refs.end());
+	heap_init_inclass(&*_reduces.refs.begin(), &*_reduces.refs.end());
 }
 
-void selector::add_preempted_map(td_ref *ref)
+template<typename S>
+void selector::add_preempted(td_ref *ref)
 {
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	std::vector<td_ref *> &refs = S::state(this).refs;
 	// deep copy to avoid double-free
 	td_ref *p = new td_ref(*ref);
 
-	_map_refs.push_back(p);
-	heap_push_inclass(&*_map_refs.begin(), _map_refs.size() - 1, 0, p);
+	refs.push_back(p);
+	heap_push_inclass(&*refs.begin(), refs.size() - 1, 0, p);
 }
 
-void selector::add_preempted_reduce(td_ref *ref)
+void selector::add_preempted_map(td_ref *ref)
 {
-	// deep copy to avoid double-free
-	td_ref *p = new td_ref(*ref);
+	add_preempted<map_side>(ref);
+}
 
-	_reduce_refs.push_back(p);
-	heap_push_inclass(&*_reduce_refs.begin(), _reduce_refs.size() - 1, 0, p);
+void selector::add_preempted_reduce(td_ref *ref)
+{
+	add_preempted<reduce_side>(ref);
 }
 
-selector::~selector()
+template<typename S>
+void selector::free_side()
 {
+	side_state<S> &st = S::state(this);
+
 	// free remaining refs
-	for (p2j_type::iterator pit = _map_tasks.begin();
-	     pit != _map_tasks.end(); ++pit) {
+	for (p2j_type::iterator pit = st.tasks.begin();
+	     pit != st.tasks.end(); ++pit) {
 		// visit each job in the job hash map
 		for (j2t_type::iterator jit = pit.value()->begin();
 		     jit != pit.value()->end(); ++jit) {
@@ -75,75 +162,128 @@ selector::~selector()
 		// free job hash map
 		delete pit.value();
 	}
-	for (p2j_type::iterator pit = _reduce_tasks.begin();
-	     pit != _reduce_tasks.end(); ++pit) {
-		for (j2t_type::iterator jit = pit.value()->begin();
-		     jit != pit.value()->end(); ++jit)
-			delete jit.value();
-		delete pit.value();
-	}
 	// free task refs
-	for (std::vector<td_ref *>::iterator it = _map_refs.begin();
-	     it != _map_refs.end(); ++it)
-		delete *it;
-	for (std::vector<td_ref *>::iterator it = _reduce_refs.begin();
-	     it != _reduce_refs.end(); ++it)
+	for (std::vector<td_ref *>::iterator it = st.refs.begin();
+	     it != st.refs.end(); ++it)
 		delete *it;
-	for (std::vector<td_ref *>::iterator it = _seen_maps.begin();
-	     it != _seen_maps.end(); ++it)
-		delete *it;
-	for (std::vector<td_ref *>::iterator it = _seen_reduces.begin();
-	     it != _seen_reduces.end(); ++it)
+	for (std::vector<td_ref *>::iterator it = st.seen.begin();
+	     it != st.seen.end(); ++it)
 		delete *it;
+	// free heaps of active child pools
+	for (typename side_state<S>::tree_type::iterator it = st.tree.begin();
+	     it != st.tree.end(); ++it)
+		delete it.value();
 }
 
-void selector::dump_seen_task_tree() const
+selector::~selector()
 {
-	printf("[Begin dumping seen task tree]\n");
-	printf("[MAP] %lu pools\n", _map_tasks.size());
-	for (p2j_type::const_iterator pit = _map_tasks.begin();
-	     pit != _map_tasks.end(); ++pit) {
-		printf("    [POOL] %s has seen %lu jobs, A/D=%d/%d\n",
-		       pit.key().ptr->getpool()->name.c_str(), pit.value()->size(),
-		       pit.key().ptr->getpool()->fs_ctx_map.alloc,
-		       pit.key().ptr->getpool()->fs_ctx_map.demand);
-		// visit each job in the job hash map
-		for (j2t_type::const_iterator jit = pit.value()->begin();
-		     jit != pit.value()->end(); ++jit) {
-			printf("        [JOB] %016lx has %lu tasks, A/D=%d/%d\n",
-			       jit.key().ptr->getjob()->id, jit.value()->size(),
-			       jit.key().ptr->getjob()->fs_ctx_map.alloc,
-			       jit.key().ptr->getjob()->fs_ctx_map.demand);
-		}
+	free_side<map_side>();
+	free_side<reduce_side>();
+}
+
+template<typename S>
+typename selector::side_state<S>::heap_type *selector::heap(pool *p)
+{
+	side_state<S> &st = S::state(this);
+
+	if (p == NULL)
+		return &st.roots;
+	typename side_state<S>::tree_type::iterator it = st.tree.find(p);
+	if (it == st.tree.end())
+		it = st.tree.insert(p, new typename side_state<S>::heap_type);
+	return it.value();
+}
+
+template<typename S>
+void selector::adjust(pool *p, int dalloc, int ddemand)
+{
+	for (; p; p = p->parent) {
+		fs_context &ctx = S::context(p);
+		ctx.alloc += dalloc;
+		ctx.demand += ddemand;
+		// the parent has to redivide its share among the children
+		if (ddemand && p->parent)
+			S::children_total(p->parent) = -1;
+		typename side_state<S>::heap_type *h = heap<S>(p->parent);
+		if (ctx.alloc < ctx.demand) {
+			if (!h->update(p))
+				h->push(p);
+		} else
+			h->erase(p);
+	}
+}
+
+void selector::release_map(td_ref *ref)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	adjust<map_side>(ref->getpool(), -1, -1);
+}
+
+void selector::release_reduce(td_ref *ref)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	adjust<reduce_side>(ref->getpool(), -1, -1);
+}
+
+template<typename S>
+pool *selector::descend()
+{
+	typename side_state<S>::heap_type *h = &S::state(this).roots;
+	for (;;) {
+		if (h->size() == 0)
+			return NULL;
+		pool *p = h->top().ptr;
+		if (p->is_leaf())
+			return p;
+		h = heap<S>(p);
 	}
-	printf("[REDUCE] %lu pools\n", _reduce_tasks.size());
-	for (p2j_type::const_iterator pit = _reduce_tasks.begin();
-	     pit != _reduce_tasks.end(); ++pit) {
+}
+
+template<typename S>
+void selector::dump_seen() const
+{
+	const p2j_type &tasks = S::state(this).tasks;
+
+	for (p2j_type::const_iterator pit = tasks.begin();
+	     pit != tasks.end(); ++pit) {
 		printf("    [POOL] %s has seen %lu jobs, A/D=%d/%d\n",
-		       pit.key().ptr->getpool()->name.c_str(), pit.value()->size(),
-		       pit.key().ptr->getpool()->fs_ctx_reduce.alloc,
-		       pit.key().ptr->getpool()->fs_ctx_reduce.demand);
+		       pit.key().ptr->name.c_str(), pit.value()->size(),
+		       S::context(pit.key().ptr).alloc,
+		       S::context(pit.key().ptr).demand);
+		// visit each job in the job hash map
 		for (j2t_type::const_iterator jit = pit.value()->begin();
 		     jit != pit.value()->end(); ++jit) {
 			printf("        [JOB] %016lx has %lu tasks, A/D=%d/%d\n",
 			       jit.key().ptr->getjob()->id, jit.value()->size(),
-			       jit.key().ptr->getjob()->fs_ctx_reduce.alloc,
-			       jit.key().ptr->getjob()->fs_ctx_reduce.demand);
+			       S::context(jit.key().ptr->getjob()).alloc,
+			       S::context(jit.key().ptr->getjob()).demand);
 		}
 	}
+}
+
+void selector::dump_seen_task_tree() const
+{
+	printf("[Begin dumping seen task tree]\n");
+	printf("[MAP] %lu pools\n", _maps.tasks.size());
+	dump_seen<map_side>();
+	printf("[REDUCE] %lu pools\n", _reduces.tasks.size());
+	dump_seen<reduce_side>();
 	printf("[End dumping seen task tree]\n");
 }
 
-double selector::map_min_ctime() const
+template<typename S>
+double selector::min_ctime() const
 {
-	if (_maps_popped == _seen_maps.size()) {
-		if (!_map_refs.size())
-			return -1; // no more maps
-		return (*_map_refs.begin())->gettask()->ctime;
+	const side_state<S> &st = S::state(this);
+
+	if (st.popped == st.seen.size()) {
+		if (!st.refs.size())
+			return -1; // no more tasks
+		return (*st.refs.begin())->gettask()->ctime;
 	}
 	// search for buffered tasks with the minimum ctime
-	for (std::vector<td_ref *>::const_iterator it = _seen_maps.begin();
-	     it != _seen_maps.end(); ++it) {
+	for (std::vector<td_ref *>::const_iterator it = st.seen.begin();
+	     it != st.seen.end(); ++it) {
 		if (!(*it)->test_flag(task::TASK_FLAG_POPPED))
 			return (*it)->gettask()->ctime;
 	}
@@ -151,37 +291,34 @@ double selector::map_min_ctime() const
 	return -1;
 }
 
+double selector::map_min_ctime() const
+{
+	return min_ctime<map_side>();
+}
+
 double selector::reduce_min_ctime() const
 {
-	if (_reduces_popped == _seen_reduces.size()) {
-		if (!_reduce_refs.size())
-			return -1; // no more reduces
-		return (*_reduce_refs.begin())->gettask()->ctime;
-	}
-	// search for buffered tasks with the minimum ctime
-	for (std::vector<td_ref *>::const_iterator it = _seen_reduces.begin();
-	     it != _seen_reduces.end(); ++it) {
-		if (!(*it)->test_flag(task::TASK_FLAG_POPPED))
-			return (*it)->gettask()->ctime;
-	}
-	ULIB_FATAL("unexpected all popped tasks");
-	return -1;
+	return min_ctime<reduce_side>();
 }
 
-void selector::see_maps(double now, changes_type *changes)
+template<typename S>
+void selector::see(double now, changes_type *changes)
 {
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	side_state<S> &st = S::state(this);
+
 	// move emerged (ctime <= now) tasks to task tree
-	while (_map_refs.size() &&
-	       (*_map_refs.begin())->gettask()->ctime <= now) {  // just seen top
-		td_ref *top = *_map_refs.begin();
-		heap_pop_to_rear_inclass(&*_map_refs.begin(), &*_map_refs.end());
-		_map_refs.pop_back();
-		_seen_maps.push_back(top);
+	while (st.refs.size() &&
+	       (*st.refs.begin())->gettask()->ctime <= now) {  // just seen top
+		td_ref *top = *st.refs.begin();
+		heap_pop_to_rear_inclass(&*st.refs.begin(), &*st.refs.end());
+		st.refs.pop_back();
+		st.seen.push_back(top);
 		// find or create the pool-to-job mapping
-		p2j_type::iterator pit = _map_tasks.find(top);
-		if (pit == _map_tasks.end()) {
+		p2j_type::iterator pit = st.tasks.find(top->getpool());
+		if (pit == st.tasks.end()) {
 			j2t_type *jm = new j2t_type;
-			pit = _map_tasks.insert(top, jm);
+			pit = st.tasks.insert(top->getpool(), jm);
 		}
 		// find or create the job-to-task mapping
 		j2t_type::iterator jit = pit.value()->find(top);
@@ -192,238 +329,83 @@ void selector::see_maps(double now, changes_type *changes)
 		jit.value()->push(top);
 		if (changes)
 			changes->insert(top);
-		++top->getpool()->fs_ctx_map.demand;
-		++top->getjob()->fs_ctx_map.demand;
+		adjust<S>(top->getpool(), 0, 1);
+		++S::context(top->getjob()).demand;
 	}
 }
 
-td_ref * selector::job_select_map_fs(pool_map_fs_itr pchosen)
+void selector::see_maps(double now, changes_type *changes)
 {
-	job_map_fs_itr jbegin(pchosen.itr.value()->begin());
-	job_map_fs_itr jend(pchosen.itr.value()->end());
-	fs_select<job_map_fs_itr> jfs(jbegin, jend);
-	job_map_fs_itr jchosen = jfs();
-	if (jchosen == jend) {
-		ULIB_FATAL("should have chosen from a non-empty job");
-		return NULL;
-	}
-
-	td_ref *ret = jchosen.itr.value()->front();
-	jchosen.itr.value()->pop();
-
-	// remove inactive job
-	job *j = jchosen.itr.key().ptr->getjob();
-	if (j->fs_ctx_map.alloc == j->fs_ctx_map.demand) {
-		if (jchosen.itr.value()->size())
-			ULIB_FATAL("task set is non-empty while removing the job");
-		delete jchosen.itr.value();
-		// the job set will be freed if its belonging pool is inactive
-		pchosen.itr.value()->erase(jchosen.itr);
-	}
-
-	return ret;
+	PROFILE_SCOPE(PROF_SEE_MAPS);
+	see<map_side>(now, changes);
 }
 
-td_ref * selector::job_select_map_fcfs(pool_map_fs_itr pchosen)
+void selector::see_reduces(double now, changes_type *changes)
 {
-	job_map_fcfs_itr jbegin(pchosen.itr.value()->begin());
-	job_map_fcfs_itr jend(pchosen.itr.value()->end());
-	fs_select<job_map_fcfs_itr> jfs(jbegin, jend);
-	job_map_fcfs_itr jchosen = jfs();
-	if (jchosen == jend) {
-		ULIB_FATAL("should have chosen from a non-empty job");
-		return NULL;
-	}
-
-	td_ref *ret = jchosen.itr.value()->front();
-	jchosen.itr.value()->pop();
-
-	// remove inactive job
-	job *j = jchosen.itr.key().ptr->getjob();
-	if (j->fs_ctx_map.alloc == j->fs_ctx_map.demand) {
-		if (jchosen.itr.value()->size())
-			ULIB_FATAL("task set is non-empty while removing the job");
-		delete jchosen.itr.value();
-		// the job set will be freed if its belonging pool is inactive
-		pchosen.itr.value()->erase(jchosen.itr);
-	}
-
-	return ret;
+	PROFILE_SCOPE(PROF_SEE_REDUCES);
+	see<reduce_side>(now, changes);
 }
 
-// pop out a map/reduce task
-td_ref *selector::pop_map()
+template<typename S>
+td_ref *selector::pop()
 {
-	if (_maps_popped == _seen_maps.size()) {
+	PROFILE_ALLOC_SCOPE(ALLOC_SELECTOR);
+	side_state<S> &st = S::state(this);
+
+	if (st.popped == st.seen.size()) {
 		ULIB_DEBUG("haven't seen a new task");
 		return NULL;
 	}
 
-	pool_map_fs_itr pbegin(_map_tasks.begin());
-	pool_map_fs_itr pend(_map_tasks.end());
-	fs_select<pool_map_fs_itr> pfs(pbegin, pend);
-	pool_map_fs_itr pchosen = pfs();
-	if (pchosen == pend) {
+	pool *p = descend<S>();
+	p2j_type::iterator pchosen = p? st.tasks.find(p): st.tasks.end();
+	if (pchosen == st.tasks.end()) {
 		ULIB_FATAL("should have chosen a task");
 		return NULL;
 	}
 
-	pool *p = pchosen.itr.key().ptr->getpool();
-	td_ref *ret;
-	if (p->sched == pool::SCHED_FAIR)
-		ret = job_select_map_fs(pchosen);
-	else if (p->sched == pool::SCHED_FCFS)
-		ret = job_select_map_fcfs(pchosen);
-	else {
+	const policy_entry *policy = get_policy(p->sched);
+	if (policy == NULL) {
 		ULIB_FATAL("unrecognized sched mode:%d for pool %s", p->sched, p->name.c_str());
 		return NULL;
 	}
+	td_ref *ret = S::select(*policy)(pchosen.value());
 
 	// mark the task as 'popped'
 	ret->set_flag(task::TASK_FLAG_POPPED);
-	++_maps_popped;
+	++st.popped;
+
+	// allocate the slot along the path, inactive pools leave the heaps
+	adjust<S>(p, 1, 0);
 
 	// remove inactive pool
-	if (p->fs_ctx_map.alloc == p->fs_ctx_map.demand) {
-		if (pchosen.itr.value()->size())
+	if (S::context(p).alloc == S::context(p).demand) {
+		if (pchosen.value()->size())
 			ULIB_FATAL("job set is non-empty while removing the pool");
-		delete pchosen.itr.value();
-		_map_tasks.erase(pchosen.itr);
+		delete pchosen.value();
+		st.tasks.erase(pchosen);
 	}
 
 	return ret;
 }
 
-td_ref *selector::pop_map(double now)
-{
-	see_maps(now);
-	return pop_map();
-}
-
-void selector::see_reduces(double now, changes_type *changes)
+// pop out a map/reduce task
+td_ref *selector::pop_map()
 {
-	// move emerged (ctime <= now) tasks to task tree
-	while (_reduce_refs.size() &&
-	       (*_reduce_refs.begin())->gettask()->ctime <= now) {  // just seen top
-		td_ref *top = *_reduce_refs.begin();
-		heap_pop_to_rear_inclass(&*_reduce_refs.begin(), &*_reduce_refs.end());
-		_reduce_refs.pop_back();
-		_seen_reduces.push_back(top);
-		// find or create the pool-to-job mapping
-		p2j_type::iterator pit = _reduce_tasks.find(top);
-		if (pit == _reduce_tasks.end()) {
-			j2t_type *jm = new j2t_type;
-			pit = _reduce_tasks.insert(top, jm);
-		}
-		// find or create the job-to-task mapping
-		j2t_type::iterator jit = pit.value()->find(top);
-		if (jit == pit.value()->end()) {
-			std::queue<td_ref *> *pl = new std::queue<td_ref *>;
-			jit = pit.value()->insert(top, pl);
-		}
-		jit.value()->push(top);
-		if (changes)
-			changes->insert(top);
-		++top->getpool()->fs_ctx_reduce.demand;
-		++top->getjob()->fs_ctx_reduce.demand;
-	}
+	PROFILE_SCOPE(PROF_POP_MAP);
+	return pop<map_side>();
 }
 
-td_ref * selector::job_select_reduce_fs(pool_reduce_fs_itr pchosen)
-{
-	job_reduce_fs_itr jbegin(pchosen.itr.value()->begin());
-	job_reduce_fs_itr jend(pchosen.itr.value()->end());
-	fs_select<job_reduce_fs_itr> jfs(jbegin, jend);
-	job_reduce_fs_itr jchosen = jfs();
-	if (jchosen == jend) {
-		ULIB_FATAL("should have chosen from a non-empty job");
-		return NULL;
-	}
-
-	td_ref *ret = jchosen.itr.value()->front();
-	jchosen.itr.value()->pop();
-
-	// remove inactive job
-	job *j = jchosen.itr.key().ptr->getjob();
-	if (j->fs_ctx_reduce.alloc == j->fs_ctx_reduce.demand) {
-		if (jchosen.itr.value()->size())
-			ULIB_FATAL("task set is non-empty while removing the job");
-		delete jchosen.itr.value();
-		// the job set will be freed if its belonging pool is inactive
-		pchosen.itr.value()->erase(jchosen.itr);
-	}
-
-	return ret;
-}
-
-td_ref * selector::job_select_reduce_fcfs(pool_reduce_fs_itr pchosen)
+td_ref *selector::pop_map(double now)
 {
-	job_reduce_fcfs_itr jbegin(pchosen.itr.value()->begin());
-	job_reduce_fcfs_itr jend(pchosen.itr.value()->end());
-	fs_select<job_reduce_fcfs_itr> jfs(jbegin, jend);
-	job_reduce_fcfs_itr jchosen = jfs();
-	if (jchosen == jend) {
-		ULIB_FATAL("should have chosen from a non-empty job");
-		return NULL;
-	}
-
-	td_ref *ret = jchosen.itr.value()->front();
-	jchosen.itr.value()->pop();
-
-	// remove inactive job
-	job *j = jchosen.itr.key().ptr->getjob();
-	if (j->fs_ctx_reduce.alloc == j->fs_ctx_reduce.demand) {
-		if (jchosen.itr.value()->size())
-			ULIB_FATAL("task set is non-empty while removing the job");
-		delete jchosen.itr.value();
-		// the job set will be freed if its belonging pool is inactive
-		pchosen.itr.value()->erase(jchosen.itr);
-	}
-
-	return ret;
+	see_maps(now);
+	return pop_map();
 }
 
-// pop out a reduce/reduce task
 td_ref *selector::pop_reduce()
 {
-	if (_reduces_popped == _seen_reduces.size()) {
-		ULIB_DEBUG("haven't seen a new task");
-		return NULL;
-	}
-
-	pool_reduce_fs_itr pbegin(_reduce_tasks.begin());
-	pool_reduce_fs_itr pend(_reduce_tasks.end());
-	fs_select<pool_reduce_fs_itr> pfs(pbegin, pend);
-	pool_reduce_fs_itr pchosen = pfs();
-	if (pchosen == pend) {
-		ULIB_FATAL("should have chosen a task");
-		return NULL;
-	}
-
-	pool *p = pchosen.itr.key().ptr->getpool();
-	td_ref *ret;
-	if (p->sched == pool::SCHED_FAIR)
-		ret = job_select_reduce_fs(pchosen);
-	else if (p->sched == pool::SCHED_FCFS)
-		ret = job_select_reduce_fcfs(pchosen);
-	else {
-		ULIB_FATAL("unrecognized sched mode:%d for pool %s", p->sched, p->name.c_str());
-		return NULL;
-	}
-
-	// mark the task as 'popped'
-	ret->set_flag(task::TASK_FLAG_POPPED);
-	++_reduces_popped;
-
-	// remove inactive pool
-	if (p->fs_ctx_reduce.alloc == p->fs_ctx_reduce.demand) {
-		if (pchosen.itr.value()->size())
-			ULIB_FATAL("job set is non-empty while removing the pool");
-		delete pchosen.itr.value();
-		_reduce_tasks.erase(pchosen.itr);
-	}
-
-	return ret;
+	PROFILE_SCOPE(PROF_POP_REDUCE);
+	return pop<reduce_side>();
 }
 
 td_ref *selector::pop_reduce(double now)
@@ -30,6 +30,7 @@
 #include "job.hpp"
 #include "pool.hpp"
 #include "fsched.hpp"
+#include "workload_index.hpp"
 
 namespace Tempo {
 
@@ -59,6 +60,29 @@ public:
 		}
 	};
 
+	struct pool_key {
+		pool *ptr;
+
+		typedef pool * pointer_type;
+
+		pool_key(pool *p) : ptr(p) { }
+
+		operator pool *&()
+		{
+			return ptr;
+		}
+
+		operator size_t() const
+		{
+			return ptr->id;
+		}
+
+		bool operator==(const pool_key &other) const
+		{
+			return ptr->id == other.ptr->id;
+		}
+	};
+
 	struct job_view {
 		td_ref * ptr;
 
@@ -87,94 +111,130 @@ public:
 	typedef std::list<pool>::iterator pool_itr_type;
 	typedef ulib::open_hash_set<pool_view> changes_type;
 	typedef ulib::open_hash_map<job_view, std::queue<td_ref *> *> j2t_type;
-        typedef ulib::open_hash_map<pool_view, j2t_type *> p2j_type;
+        typedef ulib::open_hash_map<pool_key, j2t_type *> p2j_type;
 
 	DEFINE_HEAP(inclass, td_ref *, std::greater<ctime_comp>());
 
-	struct pool_map_fs_itr {
-		p2j_type::iterator itr;
+	typedef td_ref *(*job_select_fn)(j2t_type *jobs);
+	struct policy_entry;
+
+	template<typename S> struct side_state;
+
+	// Task type traits, selecting the map or reduce side of jobs,
+	// pools, policies and of the selector itself, so that the code
+	// of both sides is written once
+	struct map_side {
+		static const task::task_type type = task::TASK_TYPE_MAP;
+		static fs_context &context(job *j) { return j->fs_ctx_map; }
+		static fs_context &context(pool *p) { return p->fs_ctx_map; }
+		static double &children_total(pool *p) { return p->map_children_total; }
+		static job_select_fn select(const policy_entry &e);
+		static side_state<map_side> &state(selector *s) { return s->_maps; }
+		static const side_state<map_side> &state(const selector *s) { return s->_maps; }
+	};
 
-		pool_map_fs_itr() { }
-		pool_map_fs_itr(const p2j_type::iterator &it) : itr(it) { }
+	struct reduce_side {
+		static const task::task_type type = task::TASK_TYPE_REDUCE;
+		static fs_context &context(job *j) { return j->fs_ctx_reduce; }
+		static fs_context &context(pool *p) { return p->fs_ctx_reduce; }
+		static double &children_total(pool *p) { return p->reduce_children_total; }
+		static job_select_fn select(const policy_entry &e);
+		static side_state<reduce_side> &state(selector *s) { return s->_reduces; }
+		static const side_state<reduce_side> &state(const selector *s) { return s->_reduces; }
+	};
 
-		pool_map_fs_itr &operator++()
-		{
-			++itr;
-			return *this;
-		}
+	// pool ordered by its fair scheduling context of side S
+	template<typename S>
+	struct pool_fs_ref {
+		pool *ptr;
 
-		bool operator==(const pool_map_fs_itr &other) const
-		{
-			return itr == other.itr;
-		}
-
-		bool operator!=(const pool_map_fs_itr &other) const
-		{
-			return itr != other.itr;
-		}
+		pool_fs_ref() { }
+		pool_fs_ref(pool *p) : ptr(p) { }
 
 		const fs_context & operator *() const
 		{
-			return ((td_ref *)itr.key())->getpool()->fs_ctx_map;
+			return S::context(ptr);
 		}
 
 		operator fs_context *()
 		{
-			return &((td_ref *)itr.key())->getpool()->fs_ctx_map;
+			return &S::context(ptr);
 		}
 	};
 
-	struct job_map_fs_itr {
+	// Tasks of one type
+	template<typename S>
+	struct side_state {
+		// active child pools of a parent, i.e. pools with seen but
+		// not yet popped tasks in their subtrees
+		typedef fs_heap< pool_fs_ref<S> > heap_type;
+		typedef ulib::open_hash_map<pool_key, heap_type *> tree_type;
+
+		p2j_type  tasks;   // seen tasks by pool and job
+		heap_type roots;   // of the top-level pools
+		tree_type tree;    // of the other parents
+		size_t    popped;  // tasks popped out by now
+		std::vector<td_ref *> refs;  // tasks not seen yet
+		std::vector<td_ref *> seen;
+
+		side_state() : popped(0) { }
+	};
+
+	// job ordered by its fair scheduling context
+	template<typename S>
+	struct job_fs_itr {
 		j2t_type::iterator itr;
 
-		job_map_fs_itr() { }
-		job_map_fs_itr(const j2t_type::iterator &it) : itr(it) { }
+		job_fs_itr() { }
+		job_fs_itr(const j2t_type::iterator &it) : itr(it) { }
 
-		job_map_fs_itr &operator++()
+		job_fs_itr &operator++()
 		{
 			++itr;
 			return *this;
 		}
 
-		bool operator==(const job_map_fs_itr &other) const
+		bool operator==(const job_fs_itr &other) const
 		{
 			return itr == other.itr;
 		}
 
-		bool operator!=(const job_map_fs_itr &other) const
+		bool operator!=(const job_fs_itr &other) const
 		{
 			return itr != other.itr;
 		}
 
 		const fs_context & operator *() const
 		{
-			return ((td_ref *)itr.key())->getjob()->fs_ctx_map;
+			return S::context(((td_ref *)itr.key())->getjob());
 		}
 
 		operator fs_context *()
 		{
-			return &((td_ref *)itr.key())->getjob()->fs_ctx_map;
+			return &S::context(((td_ref *)itr.key())->getjob());
 		}
 	};
 
-	struct job_map_fcfs_itr {
+	// job ordered by its creation time and priority
+	template<typename S>
+	struct job_fcfs_itr {
 		j2t_type::iterator itr;
 
-		job_map_fcfs_itr() { }
-		job_map_fcfs_itr(const j2t_type::iterator &it) : itr(it) { }
+		job_fcfs_itr() { }
+		job_fcfs_itr(const j2t_type::iterator &it) : itr(it) { }
 
-		job_map_fcfs_itr &operator++()
+		job_fcfs_itr &operator++()
 		{
 			++itr;
 			return *this;
 		}
 
-		bool operator==(const job_map_fcfs_itr &other) const
+		bool operator==(const job_fcfs_itr &other) const
 		{
 			return itr == other.itr;
 		}
 
-		bool operator!=(const job_map_fcfs_itr &other) const
+		bool operator!=(const job_fcfs_itr &other) const
 		{
 			return itr != other.itr;
 		}
@@ -186,110 +246,50 @@ public:
 
 		operator fs_context *()
 		{
-			return &((td_ref *)itr.key())->getjob()->fs_ctx_map;
+			return &S::context(((td_ref *)itr.key())->getjob());
 		}
 	};
 
-	struct pool_reduce_fs_itr {
-		p2j_type::iterator itr;
-
-		pool_reduce_fs_itr() { }
-		pool_reduce_fs_itr(const p2j_type::iterator &it) : itr(it) { }
-
-		pool_reduce_fs_itr &operator++()
-		{
-			++itr;
-			return *this;
-		}
-
-		bool operator==(const pool_reduce_fs_itr &other) const
-		{
-			return itr == other.itr;
-		}
-
-		bool operator!=(const pool_reduce_fs_itr &other) const
-		{
-			return itr != other.itr;
-		}
-
-		const fs_context & operator *() const
-		{
-			return ((td_ref *)itr.key())->getpool()->fs_ctx_reduce;
-		}
-
-		operator fs_context *()
-		{
-			return &((td_ref *)itr.key())->getpool()->fs_ctx_reduce;
-		}
+	typedef job_fs_itr<map_side>      job_map_fs_itr;
+	typedef job_fcfs_itr<map_side>    job_map_fcfs_itr;
+	typedef job_fs_itr<reduce_side>   job_reduce_fs_itr;
+	typedef job_fcfs_itr<reduce_side> job_reduce_fcfs_itr;
+
+	// Job scheduling policies
+	// A policy names the iterator through which fs_select orders
+	// the active jobs of a pool, so that the comparator is inlined
+	// into job_select(). To add a policy, add a pool::sched_mode,
+	// a policy class and a registry entry in selector.cpp.
+	template<typename S>
+	struct fair_policy {
+		typedef S side;
+		typedef job_fs_itr<S> iterator;
 	};
 
-	struct job_reduce_fs_itr {
-		j2t_type::iterator itr;
-
-		job_reduce_fs_itr() { }
-		job_reduce_fs_itr(const j2t_type::iterator &it) : itr(it) { }
-
-		job_reduce_fs_itr &operator++()
-		{
-			++itr;
-			return *this;
-		}
-
-		bool operator==(const job_reduce_fs_itr &other) const
-		{
-			return itr == other.itr;
-		}
-
-		bool operator!=(const job_reduce_fs_itr &other) const
-		{
-			return itr != other.itr;
-		}
-
-		const fs_context & operator *() const
-		{
-			return ((td_ref *)itr.key())->getjob()->fs_ctx_reduce;
-		}
-
-		operator fs_context *()
-		{
-			return &((td_ref *)itr.key())->getjob()->fs_ctx_reduce;
-		}
+	template<typename S>
+	struct fcfs_policy {
+		typedef S side;
+		typedef job_fcfs_itr<S> iterator;
 	};
 
-	struct job_reduce_fcfs_itr {
-		j2t_type::iterator itr;
-
-		job_reduce_fcfs_itr() { }
-		job_reduce_fcfs_itr(const j2t_type::iterator &it) : itr(it) { }
-
-		job_reduce_fcfs_itr &operator++()
-		{
-			++itr;
-			return *this;
-		}
-
-		bool operator==(const job_reduce_fcfs_itr &other) const
-		{
-			return itr == other.itr;
-		}
-
-		bool operator!=(const job_reduce_fcfs_itr &other) const
-		{
-			return itr != other.itr;
-		}
+	// registered policy of a scheduling mode
+	struct policy_entry {
+		const char   *name;  // name shown in reports
+		job_select_fn select_map;
+		job_select_fn select_reduce;
+	};
 
-		const job_ctime_hash operator *() const
-		{
-			return (td_ref *)itr.key();
-		}
+	// Returns the policy of @mode, NULL if none is registered
+	static const policy_entry *get_policy(pool::sched_mode mode);
 
-		operator fs_context *()
-		{
-			return &((td_ref *)itr.key())->getjob()->fs_ctx_reduce;
-		}
-	};
+	// Parse a scheduling mode name from a configuration file,
+	// ignoring case. Returns false if the name is unknown.
+	static bool parse_sched_mode(const char *name, pool::sched_mode *mode);
 
-	selector(const pool_itr_type &pb, const pool_itr_type &pe);
+	// Select from the tasks of the pools in [pb, pe), or only from
+	// the tasks in @view if given
+	selector(const pool_itr_type &pb, const pool_itr_type &pe,
+		 const workload_view *view = NULL);
 	~selector();
 
 	// preempted tasks may need to be added back
@@ -299,15 +299,15 @@ public:
 	double map_min_ctime() const;
 	double reduce_min_ctime() const;
 
-	size_t maps_popped() const { return _maps_popped; }
-	size_t maps_seen() const { return _seen_maps.size(); }
-	size_t maps_left() const { return _map_refs.size(); }
-	size_t reduces_popped() const { return _reduces_popped; }
-	size_t reduces_seen() const { return _seen_reduces.size(); }
-	size_t reduces_left() const { return _reduce_refs.size(); }
+	size_t maps_popped() const { return _maps.popped; }
+	size_t maps_seen() const { return _maps.seen.size(); }
+	size_t maps_left() const { return _maps.refs.size(); }
+	size_t reduces_popped() const { return _reduces.popped; }
+	size_t reduces_seen() const { return _reduces.seen.size(); }
+	size_t reduces_left() const { return _reduces.refs.size(); }
 
-	bool has_map() const { return _map_refs.size() || _maps_popped < _seen_maps.size(); }
-	bool has_reduce() const { return _reduce_refs.size() || _reduces_popped < _seen_reduces.size(); }
+	bool has_map() const { return has<map_side>(); }
+	bool has_reduce() const { return has<reduce_side>(); }
 	bool has_task() const { return has_map() || has_reduce(); }
 
 	void dump_seen_task_tree() const;
@@ -316,6 +316,12 @@ public:
 	void see_maps(double now, changes_type *changes = NULL);
 	void see_reduces(double now, changes_type *changes = NULL);
 
+	// release the slot of a finished or preempted map/reduce task,
+	// decrementing the allocation and demand of its pool and the
+	// pool's ancestors
+	void release_map(td_ref *ref);
+	void release_reduce(td_ref *ref);
+
 	// pop out a map/reduce task
 	// Note: popped tasks should NOT be freed from outside
 	td_ref *pop_map();  // pop only
@@ -324,23 +330,54 @@ public:
 	td_ref *pop_reduce(double now);  // see and pop
 
 private:
-	static td_ref * job_select_map_fs(pool_map_fs_itr pchosen);
-	static td_ref * job_select_map_fcfs(pool_map_fs_itr pchosen);
-	static td_ref * job_select_reduce_fs(pool_reduce_fs_itr pchosen);
-	static td_ref * job_select_reduce_fcfs(pool_reduce_fs_itr pchosen);
+	// select a task from the active jobs of a pool with policy P
+	template<typename P>
+	static td_ref * job_select(j2t_type *jobs);
+
+	static const policy_entry _policies[];
+
+	// The side S versions of the public map and reduce functions
+	template<typename S>
+	bool has() const
+	{
+		const side_state<S> &st = S::state(this);
+		return st.refs.size() || st.popped < st.seen.size();
+	}
+
+	template<typename S> void add_tasks(pool *p, job *j);
+	template<typename S> double min_ctime() const;
+	template<typename S> void add_preempted(td_ref *ref);
+	template<typename S> void see(double now, changes_type *changes);
+	template<typename S> td_ref *pop();
+	template<typename S> void dump_seen() const;
+	template<typename S> void free_side();
+
+	// Apply allocation and demand changes to a pool and its
+	// ancestors, keeping the heaps of active child pools in order
+	template<typename S> void adjust(pool *p, int dalloc, int ddemand);
+
+	// The heap of active children of @p, top-level pools if @p is NULL
+	template<typename S> typename side_state<S>::heap_type *heap(pool *p);
+
+	// Descend the pool tree to the leaf pool to schedule next
+	template<typename S> pool *descend();
 
 	pool_itr_type _pb;
 	pool_itr_type _pe;
-	p2j_type _map_tasks;
-	p2j_type _reduce_tasks;
-	size_t _maps_popped;     // maps popped out by now
-	size_t _reduces_popped;  // reduces popped out by now
-	std::vector<td_ref *> _map_refs;
-	std::vector<td_ref *> _seen_maps;
-	std::vector<td_ref *> _reduce_refs;
-	std::vector<td_ref *> _seen_reduces;
+	side_state<map_side>    _maps;
+	side_state<reduce_side> _reduces;
 };
 
+inline selector::job_select_fn selector::map_side::select(const policy_entry &e)
+{
+	return e.select_map;
+}
+
+inline selector::job_select_fn selector::reduce_side::select(const policy_entry &e)
+{
+	return e.select_reduce;
+}
+
 }
 
 #endif
@@ -0,0 +1,116 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cmath>
+#include <algorithm>
+#include "slot_usage.hpp"
+
+namespace Tempo {
+
+void slot_usage::clear(bool series)
+{
+	_busy = 0;
+	_preempted = 0;
+	_completed = 0;
+	_first = HUGE_VAL;
+	_last = -HUGE_VAL;
+	_running = 0;
+	_at = 0;
+	_acc = 0;
+	_series_on = series;
+	_series.clear();
+}
+
+void slot_usage::change(double now, int delta)
+{
+	if (_series.empty())
+		_at = now;
+	_acc += _running * (now - _at);
+	_at = now;
+	_running += delta;
+	// changes at the same time collapse into one point
+	if (_series.size() && _series.back().time == now) {
+		_series.back().running = _running;
+		return;
+	}
+	usage_point p;
+	p.time = now;
+	p.busy = _acc;
+	p.running = _running;
+	_series.push_back(p);
+}
+
+void slot_usage::start(double now)
+{
+	if (_series_on)
+		change(now, 1);
+	else
+		++_running;
+}
+
+void slot_usage::stop(double stime, double now, bool preempted)
+{
+	double len = now - stime;
+
+	if (_series_on)
+		change(now, -1);
+	else
+		--_running;
+	_busy += len;
+	if (preempted) {
+		_preempted += len;
+		return;
+	}
+	++_completed;
+	_first = std::min(_first, stime);
+	_last = std::max(_last, now);
+}
+
+double slot_usage::utilization(int nslots) const
+{
+	if (_completed == 0 || !(_last > _first) || nslots <= 0)
+		return 0;
+	return (_busy - _preempted) / (_last - _first) / nslots;
+}
+
+static bool before(double t, const usage_point &p)
+{
+	return t < p.time;
+}
+
+double slot_usage::busy_at(double t) const
+{
+	std::vector<usage_point>::const_iterator it =
+		std::upper_bound(_series.begin(), _series.end(), t, before);
+	if (it == _series.begin())
+		return 0;
+	--it;
+	return it->busy + it->running * (t - it->time);
+}
+
+double slot_usage::busy_between(double t0, double t1) const
+{
+	if (!_series_on)
+		return -1;
+	return busy_at(t1) - busy_at(t0);
+}
+
+double slot_usage::utilization_between(double t0, double t1, int nslots) const
+{
+	if (!_series_on || !(t1 > t0) || nslots <= 0)
+		return _series_on? 0: -1;
+	return busy_between(t0, t1) / (t1 - t0) / nslots;
+}
+
+}
@@ -0,0 +1,81 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_SLOT_USAGE_H
+#define _COLOSSAL_SLOT_USAGE_H
+
+#include <cstddef>
+#include <vector>
+
+namespace Tempo {
+
+// Slot-time integral up to a time, and the slots in use from then on
+struct usage_point {
+	double time;
+	double busy;
+	int    running;
+};
+
+// Slot usage of one task type, accumulated as tasks start and stop
+// The totals are kept for every run, so the utilization of a run is
+// O(1) to compute. With the series kept, the slot-time of any window
+// takes a binary search.
+class slot_usage
+{
+public:
+	slot_usage() : _series_on(false) { clear(); }
+
+	// Forget the accumulated usage, keeping a series if @series
+	void clear(bool series = false);
+
+	// A task attempt started at @now, or one started at @stime
+	// stopped at @now, either finished or preempted
+	void start(double now);
+	void stop(double stime, double now, bool preempted);
+
+	double busy() const { return _busy; }            // stopped attempts
+	double preempted() const { return _preempted; }  // wasted by preemption
+	size_t completed() const { return _completed; }  // finished tasks
+	int    running() const { return _running; }
+
+	// Effective utilization of @nslots: slot-time of the finished
+	// tasks over the span from the first start to the last finish of
+	// them, the same as compute_utilization() on the predicted times
+	double utilization(int nslots) const;
+
+	// Slot-time in use during [@t0, @t1), -1 without a series
+	double busy_between(double t0, double t1) const;
+	double utilization_between(double t0, double t1, int nslots) const;
+
+	const std::vector<usage_point> &series() const { return _series; }
+
+private:
+	void change(double now, int delta);
+	double busy_at(double t) const;
+
+	double _busy;
+	double _preempted;
+	size_t _completed;
+	double _first;     // first start of a finished task
+	double _last;      // last finish of a finished task
+	int    _running;
+	double _at;        // time of the last change
+	double _acc;       // slot-time integral up to _at
+	bool   _series_on;
+	std::vector<usage_point> _series;
+};
+
+}
+
+#endif
@@ -12,41 +12,29 @@
  * binding.
  */
 
-#include <cstdio>
-#include "metric.hpp"
+#include <cstring>
+#include "strtab.hpp"
 
 namespace Tempo
 {
 
-metric metric::operator[](const std::string &key)
+string_table::string_table()
+	: _arena(1, '\0')
 {
-	metric m = *this;
-	if (_key.size())
-		m.set_key(_key + "\t" + key);
-	else
-		m.set_key(key);
-	return m;
 }
 
-void metric::set_value(double val)
+size_t string_table::add(const char *s, size_t len)
 {
-	char buf[64];
-	snprintf(buf, sizeof(buf), "%lf", val);
-	set_value(buf);
+	size_t off = _arena.size();
+	_arena.insert(_arena.end(), s, s + len);
+	_arena.push_back('\0');
+	return off;
 }
 
-void metric::set_value(int val)
+bool string_table::equal(size_t off, const char *s, size_t len) const
 {
-	char buf[64];
-	snprintf(buf, sizeof(buf), "%d", val);
-	set_value(buf);
-}
-
-void metric::set_value(uint64_t val)
-{
-	char buf[64];
-	snprintf(buf, sizeof(buf), "%lu", val);
-	set_value(buf);
+	return off + len < _arena.size() && memcmp(&_arena[off], s, len) == 0 &&
+		_arena[off + len] == '\0';
 }
 
 }
@@ -0,0 +1,54 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_STRTAB_H
+#define _COLOSSAL_STRTAB_H
+
+#include <cstddef>
+#include <vector>
+
+namespace Tempo
+{
+
+// Names kept in one contiguous arena of NUL-terminated strings
+// A name is referred to by its offset, which stays valid when the
+// arena grows and when the table is copied. Offset 0 is the empty
+// string, used for unnamed jobs and tasks.
+class string_table
+{
+public:
+	string_table();
+
+	// Append a name, returns its offset
+	size_t add(const char *s, size_t len);
+
+	const char *str(size_t off) const { return &_arena[off]; }
+
+	// Returns true if the name at @off is @s
+	bool equal(size_t off, const char *s, size_t len) const;
+
+	// bytes used by the arena
+	size_t size() const { return _arena.size(); }
+
+	void reserve(size_t n) { _arena.reserve(n); }
+
+	void swap(string_table &other) { _arena.swap(other._arena); }
+
+private:
+	std::vector<char> _arena;
+};
+
+}
+
+#endif
@@ -28,6 +28,11 @@ uint64_t task::id_from_str(const char *str)
 	return hash_fast64(str, strlen(str), 0xdeedbeefdeedbeefull);
 }
 
+uint64_t task::id_from_str(const char *str, size_t len)
+{
+	return hash_fast64(str, len, 0xdeedbeefdeedbeefull);
+}
+
 std::string task::to_str() const
 {
         char buf[1024];
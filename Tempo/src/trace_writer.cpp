@@ -0,0 +1,604 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <algorithm>
+#include <functional>
+#include <ulib/util_log.h>
+#include "job.hpp"
+#include "helper.hpp"
+#include "trace_writer.hpp"
+#include "profile.hpp"
+
+// bytes buffered before writing
+#define TRACE_CHUNK_SIZE (1 << 20)
+
+// Track identifiers: the slot groups, then lanes, pool tracks and
+// counters in the upper 32 bits with an index in the lower ones. In
+// JSON the upper bits are the process and the lower the thread.
+#define TRACK_POOLS    3ull
+#define TRACK_COUNTERS 4ull
+
+// Perfetto protobuf field numbers
+#define PB_TRACE_PACKET           1   // Trace
+#define PB_TIMESTAMP              8   // TracePacket
+#define PB_SEQUENCE_ID            10
+#define PB_TRACK_EVENT            11
+#define PB_SEQUENCE_FLAGS         13
+#define PB_TRACK_DESCRIPTOR       60
+#define PB_TD_UUID                1   // TrackDescriptor
+#define PB_TD_NAME                2
+#define PB_TD_PARENT              5
+#define PB_TD_COUNTER             8
+#define PB_TE_ANNOTATION          4   // TrackEvent
+#define PB_TE_TYPE                9
+#define PB_TE_TRACK               11
+#define PB_TE_NAME                23
+#define PB_TE_COUNTER_VALUE       44
+#define PB_DA_BOOL                2   // DebugAnnotation
+#define PB_DA_INT                 4
+#define PB_DA_STRING              6
+#define PB_DA_NAME                10
+
+#define PB_SLICE_BEGIN 1
+#define PB_SLICE_END   2
+#define PB_INSTANT     3
+#define PB_COUNTER     4
+
+#define PB_SEQUENCE    1  // the trusted sequence id of all packets
+
+namespace Tempo {
+
+static const char *type_names[task::TASK_TYPE_NUM] = { "reduce", "map" };
+static const char *starve_names[2] = { "below min share", "below half fair share" };
+static const char *metric_names[3] = { "fairshare", "running", "demand" };
+
+// JSON processes of the map and reduce slots
+static uint64_t slot_group(int type)
+{
+	return type == task::TASK_TYPE_MAP? 1: 2;
+}
+
+static uint64_t lane_track(int type, uint32_t lane)
+{
+	return slot_group(type) << 32 | (lane + 1);
+}
+
+static uint64_t pool_track(size_t pool)
+{
+	return TRACK_POOLS << 32 | (pool * 8);
+}
+
+static uint64_t starve_track(size_t pool, int type, int kind)
+{
+	return TRACK_POOLS << 32 | (pool * 8 + 1 + type * 2 + kind);
+}
+
+static uint64_t counter_track(size_t pool, int type, int metric)
+{
+	return TRACK_COUNTERS << 32 | (pool * 8 + type * 3 + metric);
+}
+
+static void pb_varint(std::string *s, uint64_t v)
+{
+	while (v >= 0x80) {
+		s->push_back((char)(v | 0x80));
+		v >>= 7;
+	}
+	s->push_back((char)v);
+}
+
+static void pb_uint(std::string *s, int field, uint64_t v)
+{
+	pb_varint(s, field << 3);
+	pb_varint(s, v);
+}
+
+static void pb_double(std::string *s, int field, double v)
+{
+	pb_varint(s, field << 3 | 1);
+	s->append((const char *)&v, sizeof(v));  // little endian hosts
+}
+
+static void pb_bytes(std::string *s, int field, const char *data, size_t len)
+{
+	pb_varint(s, field << 3 | 2);
+	pb_varint(s, len);
+	s->append(data, len);
+}
+
+static void pb_string(std::string *s, int field, const char *str)
+{
+	pb_bytes(s, field, str, strlen(str));
+}
+
+// A debug annotation with either a string or an integer value, @a is
+// scratch space
+static void pb_annotation(std::string *s, std::string *a, const char *key,
+			  const char *str, int64_t v)
+{
+	a->clear();
+	pb_string(a, PB_DA_NAME, key);
+	if (str)
+		pb_string(a, PB_DA_STRING, str);
+	else
+		pb_uint(a, PB_DA_INT, v);
+	pb_bytes(s, PB_TE_ANNOTATION, a->data(), a->size());
+}
+
+static void json_string(std::string *s, const char *str)
+{
+	s->push_back('"');
+	for (; *str; ++str) {
+		unsigned char c = *str;
+		if (c == '"' || c == '\\') {
+			s->push_back('\\');
+			s->push_back(c);
+		} else if (c < 0x20) {
+			char buf[8];
+			snprintf(buf, sizeof(buf), "\\u%04x", c);
+			s->append(buf);
+		} else
+			s->push_back(c);
+	}
+	s->push_back('"');
+}
+
+static void json_number(std::string *s, double v)
+{
+	char buf[32];
+	s->append(buf, format_double(v, buf));
+}
+
+static uint64_t nanoseconds(double t)
+{
+	return t > 0? (uint64_t)llround(t * 1e9): 0;
+}
+
+// Microseconds to the nanosecond
+static void json_time(std::string *s, double t)
+{
+	json_number(s, nanoseconds(t) / 1e3);
+}
+
+// "ph":PH,"pid":PID,"tid":TID,"ts":TS
+static void json_head(std::string *s, char ph, uint64_t track, double ts)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "{\"ph\":\"%c\",\"pid\":%u,\"tid\":%u,\"ts\":",
+		 ph, (unsigned)(track >> 32), (unsigned)(track & 0xffffffff));
+	s->append(buf);
+	json_time(s, ts);
+}
+
+trace_writer::trace_writer()
+	: _fp(NULL), _base(0), _origin(0), _next(0), _started(false), _first(true)
+{
+	for (int i = 0; i < task::TASK_TYPE_NUM; ++i)
+		_free[i].nlanes = 0;
+}
+
+trace_writer::~trace_writer()
+{
+	close();
+}
+
+int trace_writer::open(const char *file, const trace_options &opts)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	close();
+	_fp = fopen(file, "w");
+	if (_fp == NULL) {
+		ULIB_WARNING("cannot open trace file %s", file);
+		return -1;
+	}
+	_opts = opts;
+	if (_opts.sample == 0)
+		_opts.sample = 1;
+	_started = false;
+	_first = true;
+	_pools.clear();
+	_pool_index.clear();
+	for (int i = 0; i < task::TASK_TYPE_NUM; ++i) {
+		_free[i].free.clear();
+		_free[i].nlanes = 0;
+	}
+	_buf.reserve(TRACE_CHUNK_SIZE + 4096);
+	if (_opts.format == TRACE_JSON)
+		_buf = "{\"traceEvents\":[\n";
+	return 0;
+}
+
+void trace_writer::close()
+{
+	if (_fp == NULL)
+		return;
+	if (_opts.format == TRACE_JSON)
+		_buf += "\n],\"displayTimeUnit\":\"ms\"}\n";
+	if (flush())
+		ULIB_WARNING("failed to write the trace");
+	fclose(_fp);
+	_fp = NULL;
+}
+
+// Account for an event in _buf, or wrap the TrackEvent or
+// TrackDescriptor in _ev as a packet
+void trace_writer::append_event()
+{
+	if (_opts.format == TRACE_JSON) {
+		if (!_first)
+			_buf += ",\n";
+	}
+	_first = false;
+	if (_buf.size() >= TRACE_CHUNK_SIZE && flush())
+		ULIB_WARNING("failed to write the trace");
+}
+
+static void pb_packet(std::string *buf, std::string *pk, int field,
+		      const std::string &msg, double ts, bool first)
+{
+	pk->clear();
+	if (field == PB_TRACK_EVENT)
+		pb_uint(pk, PB_TIMESTAMP, nanoseconds(ts));
+	pb_uint(pk, PB_SEQUENCE_ID, PB_SEQUENCE);
+	if (first)  // SEQ_INCREMENTAL_STATE_CLEARED
+		pb_uint(pk, PB_SEQUENCE_FLAGS, 1);
+	pb_bytes(pk, field, msg.data(), msg.size());
+	pb_bytes(buf, PB_TRACE_PACKET, pk->data(), pk->size());
+}
+
+void trace_writer::describe(uint64_t track, uint64_t parent,
+			    const std::string &name, bool counter)
+{
+	if (_opts.format == TRACE_JSON) {
+		// counters are named by their events
+		if (counter)
+			return;
+		append_event();
+		bool thread = track >> 32;
+		char buf[96];
+		snprintf(buf, sizeof(buf),
+			 "{\"ph\":\"M\",\"pid\":%u,\"tid\":%u,\"name\":\"%s_name\",\"args\":{\"name\":",
+			 (unsigned)(thread? track >> 32: track),
+			 (unsigned)(thread? track & 0xffffffff: 0),
+			 thread? "thread": "process");
+		_buf += buf;
+		json_string(&_buf, name.c_str());
+		_buf += "}}";
+		return;
+	}
+	_ev.clear();
+	pb_uint(&_ev, PB_TD_UUID, track);
+	if (parent)
+		pb_uint(&_ev, PB_TD_PARENT, parent);
+	pb_bytes(&_ev, PB_TD_NAME, name.data(), name.size());
+	if (counter)
+		pb_bytes(&_ev, PB_TD_COUNTER, NULL, 0);
+	pb_packet(&_buf, &_pk, PB_TRACK_DESCRIPTOR, _ev, 0, _first);
+	append_event();
+}
+
+int trace_writer::start(const std::list<pool> &pools, double now)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	_origin = now;
+	_next = now;
+
+	// lanes are free again in a new run
+	_lanes.clear();
+	for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+		lane_set &ls = _free[type];
+		ls.free.clear();
+		for (uint32_t i = 0; i < ls.nlanes; ++i)
+			ls.free.push_back(i);
+	}
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			share_state &ss = _pools[i].share[type];
+			ss.fairshare = -1;
+			ss.running = -1;
+			ss.demand = -1;
+			ss.starved_since[0] = -1;
+			ss.starved_since[1] = -1;
+		}
+	}
+	if (_started)
+		return 0;
+	_base = now;
+
+	std::vector<std::string> names;
+	for (size_t pos = 0; pos < _opts.pools.size(); ) {
+		size_t end = _opts.pools.find(',', pos);
+		if (end == std::string::npos)
+			end = _opts.pools.size();
+		if (end > pos)
+			names.push_back(_opts.pools.substr(pos, end - pos));
+		pos = end + 1;
+	}
+
+	for (std::list<pool>::const_iterator it = pools.begin(); it != pools.end(); ++it) {
+		pool_state s;
+		s.p = &*it;
+		s.traced = names.empty();
+		for (const pool *p = &*it; p && !s.traced; p = p->parent)
+			s.traced = std::find(names.begin(), names.end(), p->name) != names.end();
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			share_state &ss = s.share[type];
+			ss.fairshare = -1;
+			ss.running = -1;
+			ss.demand = -1;
+			ss.starved_since[0] = -1;
+			ss.starved_since[1] = -1;
+		}
+		_pool_index[(uint64_t)(uintptr_t)&*it] = _pools.size();
+		_pools.push_back(s);
+	}
+
+	describe(slot_group(task::TASK_TYPE_MAP), 0, "map slots", false);
+	describe(slot_group(task::TASK_TYPE_REDUCE), 0, "reduce slots", false);
+	describe(TRACK_POOLS, 0, "pools", false);
+	// parents precede their children
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		if (!_pools[i].traced)
+			continue;
+		const pool *p = _pools[i].p;
+		uint64_t parent = TRACK_POOLS;
+		if (p->parent)
+			parent = pool_track(_pool_index[(uint64_t)(uintptr_t)p->parent]);
+		if (_opts.format == TRACE_PERFETTO)
+			describe(pool_track(i), parent, p->name, false);
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			for (int kind = 0; kind < 2; ++kind)
+				describe(starve_track(i, type, kind),
+					 _opts.format == TRACE_PERFETTO? pool_track(i): 0,
+					 p->name + " " + type_names[type] + " " + starve_names[kind],
+					 false);
+			for (int m = 0; m < 3; ++m)
+				describe(counter_track(i, type, m), pool_track(i),
+					 std::string(type_names[type]) + " " + metric_names[m], true);
+		}
+	}
+	_started = true;
+	return 0;
+}
+
+void trace_writer::add_lane(int type)
+{
+	lane_set &ls = _free[type];
+	uint32_t lane = ls.nlanes++;
+	char name[32];
+
+	snprintf(name, sizeof(name), "%s slot %u", type_names[type], lane);
+	describe(lane_track(type, lane), slot_group(type), name, false);
+	ls.free.push_back(lane);
+	std::push_heap(ls.free.begin(), ls.free.end(), std::greater<uint32_t>());
+}
+
+void trace_writer::start_task(td_ref *t)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	lane_set &ls = _free[t->gettask()->type];
+
+	if (ls.free.empty())
+		add_lane(t->gettask()->type);
+	std::pop_heap(ls.free.begin(), ls.free.end(), std::greater<uint32_t>());
+	_lanes[(uint64_t)(uintptr_t)t] = ls.free.back();
+	ls.free.pop_back();
+}
+
+bool trace_writer::traced(const pool_state &s, const job *j) const
+{
+	if (!s.traced)
+		return false;
+	// the same jobs are kept in every run
+	return _opts.sample == 1 ||
+		(j->id * 0x9e3779b97f4a7c15ull >> 32) % _opts.sample == 0;
+}
+
+void trace_writer::stop_task(td_ref *t, double now, bool preempted)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	int type = t->gettask()->type;
+	index_type::iterator it = _lanes.find((uint64_t)(uintptr_t)t);
+
+	if (it == _lanes.end())
+		return;
+	uint32_t lane = it.value();
+	_lanes.erase(it);
+	lane_set &ls = _free[type];
+	ls.free.push_back(lane);
+	std::push_heap(ls.free.begin(), ls.free.end(), std::greater<uint32_t>());
+
+	double stime = t->gettask()->stime;
+	const pool_state &s = _pools[_pool_index[(uint64_t)(uintptr_t)t->getpool()]];
+	if (!in_window(stime) || !traced(s, t->getjob()))
+		return;
+	char buf[17];
+	span(lane_track(type, lane), s.p->name.c_str(), stime, now, "job",
+	     name_or_id(s.p->name_of(*t->getjob()), t->getjob()->id, buf), preempted);
+}
+
+void trace_writer::span(uint64_t track, const char *name, double begin, double end,
+			const char *key, const char *value, bool highlight)
+{
+	if (_opts.format == TRACE_JSON) {
+		append_event();
+		json_head(&_buf, 'X', track, begin - _base);
+		_buf += ",\"dur\":";
+		// from the rounded ends, so adjacent slices do not overlap
+		json_number(&_buf, (nanoseconds(end - _base) -
+				    nanoseconds(begin - _base)) / 1e3);
+		_buf += ",\"name\":";
+		json_string(&_buf, name);
+		if (highlight)
+			_buf += ",\"cname\":\"terrible\"";
+		if (key) {
+			_buf += ",\"args\":{";
+			json_string(&_buf, key);
+			_buf += ':';
+			json_string(&_buf, value);
+			if (highlight)
+				_buf += ",\"preempted\":true";
+			_buf += '}';
+		}
+		_buf += '}';
+		return;
+	}
+	_ev.clear();
+	pb_uint(&_ev, PB_TE_TYPE, PB_SLICE_BEGIN);
+	pb_uint(&_ev, PB_TE_TRACK, track);
+	pb_string(&_ev, PB_TE_NAME, name);
+	if (key)
+		pb_annotation(&_ev, &_pk, key, value, 0);
+	if (highlight)
+		pb_annotation(&_ev, &_pk, "preempted", NULL, 1);
+	pb_packet(&_buf, &_pk, PB_TRACK_EVENT, _ev, begin - _base, _first);
+	_first = false;
+	_ev.clear();
+	pb_uint(&_ev, PB_TE_TYPE, PB_SLICE_END);
+	pb_uint(&_ev, PB_TE_TRACK, track);
+	pb_packet(&_buf, &_pk, PB_TRACK_EVENT, _ev, end - _base, false);
+	append_event();
+}
+
+void trace_writer::instant(uint64_t group, double now, int need, int num)
+{
+	if (_opts.format == TRACE_JSON) {
+		append_event();
+		json_head(&_buf, 'i', group << 32, now - _base);
+		char buf[96];
+		snprintf(buf, sizeof(buf),
+			 ",\"s\":\"p\",\"name\":\"preempt\",\"args\":{\"need\":%d,\"preempted\":%d}}",
+			 need, num);
+		_buf += buf;
+		return;
+	}
+	_ev.clear();
+	pb_uint(&_ev, PB_TE_TYPE, PB_INSTANT);
+	pb_uint(&_ev, PB_TE_TRACK, group);
+	pb_string(&_ev, PB_TE_NAME, "preempt");
+	pb_annotation(&_ev, &_pk, "need", NULL, need);
+	pb_annotation(&_ev, &_pk, "preempted", NULL, num);
+	pb_packet(&_buf, &_pk, PB_TRACK_EVENT, _ev, now - _base, _first);
+	append_event();
+}
+
+void trace_writer::preempt(task::task_type type, double now, int need, int num)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	if (in_window(now))
+		instant(slot_group(type), now, need, num);
+}
+
+void trace_writer::counter(size_t pool, int type, int metric, double now, double value)
+{
+	if (_opts.format == TRACE_JSON) {
+		append_event();
+		json_head(&_buf, 'C', TRACK_POOLS << 32, now - _base);
+		_buf += ",\"name\":";
+		json_string(&_buf, (_pools[pool].p->name + " " + type_names[type] + " " +
+				    metric_names[metric]).c_str());
+		_buf += ",\"args\":{\"value\":";
+		json_number(&_buf, value);
+		_buf += "}}";
+		return;
+	}
+	_ev.clear();
+	pb_uint(&_ev, PB_TE_TYPE, PB_COUNTER);
+	pb_uint(&_ev, PB_TE_TRACK, counter_track(pool, type, metric));
+	pb_double(&_ev, PB_TE_COUNTER_VALUE, value);
+	pb_packet(&_buf, &_pk, PB_TRACK_EVENT, _ev, now - _base, _first);
+	append_event();
+}
+
+// Write the changed counters and the starvation periods ended as of
+// @now, ending all periods if @closing
+void trace_writer::record(double now, bool closing)
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_TRACE);
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		pool_state &s = _pools[i];
+		if (!s.traced)
+			continue;
+		const pool &p = *s.p;
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			share_state &ss = s.share[type];
+			const fs_context &ctx = type == task::TASK_TYPE_MAP?
+				p.fs_ctx_map: p.fs_ctx_reduce;
+			if (in_window(now)) {
+				if (ctx.fairshare != ss.fairshare)
+					counter(i, type, 0, now, ctx.fairshare);
+				if (ctx.alloc != ss.running)
+					counter(i, type, 1, now, ctx.alloc);
+				if (ctx.demand != ss.demand)
+					counter(i, type, 2, now, ctx.demand);
+				ss.fairshare = ctx.fairshare;
+				ss.running = ctx.alloc;
+				ss.demand = ctx.demand;
+			}
+
+			double since[2];
+			since[0] = type == task::TASK_TYPE_MAP? p.map_last_at_ms: p.reduce_last_at_ms;
+			since[1] = type == task::TASK_TYPE_MAP? p.map_last_at_hf: p.reduce_last_at_hf;
+			for (int kind = 0; kind < 2; ++kind) {
+				double &from = ss.starved_since[kind];
+				// a period that ended between samples ends
+				// before the next one starts
+				if (from >= 0 && (since[kind] != from || closing)) {
+					double to = since[kind] >= 0 && since[kind] < now?
+						since[kind]: now;
+					if (to >= _opts.start && (_opts.end < 0 || from < _opts.end))
+						span(starve_track(i, type, kind), starve_names[kind],
+						     from, to, NULL, NULL, false);
+					from = -1;
+				}
+				if (from < 0 && since[kind] >= 0 && !closing)
+					from = since[kind];
+			}
+		}
+	}
+}
+
+void trace_writer::sample(double next_event)
+{
+	record(_next, false);
+	if (!(_opts.interval > 0)) {
+		_next = next_event;
+		return;
+	}
+	double n = ceil((next_event - _origin) / _opts.interval);
+	_next = _origin + n * _opts.interval;
+	if (_next < next_event)
+		_next += _opts.interval;
+}
+
+void trace_writer::finish(double now)
+{
+	record(now, true);
+	if (flush())
+		ULIB_WARNING("failed to write the trace");
+}
+
+int trace_writer::flush()
+{
+	if (_fp == NULL || _buf.empty())
+		return 0;
+	bool ok = fwrite(_buf.data(), 1, _buf.size(), _fp) == _buf.size();
+	_buf.clear();
+	return ok && fflush(_fp) == 0? 0: -1;
+}
+
+}
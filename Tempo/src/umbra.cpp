@@ -18,9 +18,19 @@
 #include <gsl/gsl_permutation.h>
 #include <ulib/util_log.h>
 #include "umbra.hpp"
+#include "introspect.hpp"
 
 namespace Tempo {
 
+void umbra::problem::eval_batch(const gsl_matrix *xs, gsl_matrix *ys)
+{
+	for (size_t i = 0; i < xs->size1; ++i) {
+		gsl_vector_const_view x = gsl_matrix_const_row(xs, i);
+		gsl_vector_view y = gsl_matrix_column(ys, i);
+		eval(&x.vector, &y.vector);
+	}
+}
+
 void umbra::perturb(gsl_vector *x, const gsl_vector *ref, double deg, int r)
 {
 	for (unsigned int i = 0; i < x->size; ++i) {
@@ -159,6 +169,16 @@ int umbra::operator()(
 	f = gsl_matrix_column(fval, 0);
 	task->eval(x0, &f.vector);
 
+	// progress for introspection, objectives are summed as by utility()
+	is_optimizer st;
+	st.iteration = 0;
+	st.niter = niter;
+	st.evaluations = 1;
+	st.objective = utility(&f.vector, &f.vector, false);
+	st.best = st.objective;
+	if (introspect_enabled())
+		introspect_optimizer(st);
+
 	gsl_matrix *batch = gsl_matrix_alloc(bs, x0->size);
 	if (batch == NULL) {
 		ULIB_FATAL("failed to alloc a batch matrix: %d x %zu", bs, x0->size);
@@ -172,26 +192,48 @@ int umbra::operator()(
 		return -1;
 	}
 
+	// the perturbed points of an iteration, evaluated at once, and
+	// the objectives of x0 they compare with
+	gsl_matrix *points = gsl_matrix_alloc(2 * bs, x0->size);
+	gsl_matrix *objs = gsl_matrix_alloc(fval->size1, 2 * bs);
+	gsl_vector *ref = gsl_vector_alloc(fval->size1);
+	if (points == NULL || objs == NULL || ref == NULL) {
+		ULIB_FATAL("failed to alloc the evaluation matrices: %d x %zu",
+			   2 * bs, x0->size);
+		goto done;
+	}
+
 	for (int i = 1, r = 1; i < niter; ++i) {
 		t = gsl_matrix_row(xval, i - 1);
 		z = gsl_matrix_row(xval, i);
 		s = gsl_matrix_column(fval, i);
+		// utilities are relative to x0, evaluated before the loop
 		f = gsl_matrix_column(fval, 0);
-		task->eval(x0, &f.vector);
+		gsl_vector_memcpy(ref, &f.vector);
+		task->set_scale(1.0 / pow(r, 1.0 / 3.0), ref);
+		for (int j = 0; j < bs; ++j) {
+			gsl_vector_view d = gsl_matrix_row(batch, j);
+			perturb(&d.vector, &t.vector, deg, r);
+			v = gsl_matrix_row(points, 2 * j);
+			gsl_vector_memcpy(&v.vector, &t.vector);
+			gsl_vector_add(&v.vector, &d.vector);
+			task->proj(&v.vector);
+			v = gsl_matrix_row(points, 2 * j + 1);
+			gsl_vector_memcpy(&v.vector, &t.vector);
+			gsl_vector_sub(&v.vector, &d.vector);
+			task->proj(&v.vector);
+		}
+		// under the strict utility, a point with an objective
+		// worse than that of x0 is worth the same however worse
+		task->set_bound(strict? ref: NULL);
+		task->eval_batch(points, objs);
+		task->set_bound(NULL);
 		bool changed = false;
 		for (int j = 0; j < bs; ++j) {
-			v = gsl_matrix_row(batch, j);
-			perturb(&v.vector, &t.vector, deg, r);
-			gsl_vector_memcpy(&z.vector, &t.vector);
-			gsl_vector_add(&z.vector, &v.vector);
-			task->proj(&z.vector);
-			task->eval(&z.vector, &s.vector);
-			double u1 = utility(&s.vector, &f.vector, strict);
-			gsl_vector_memcpy(&z.vector, &t.vector);
-			gsl_vector_sub(&z.vector, &v.vector);
-			task->proj(&z.vector);
-			task->eval(&z.vector, &s.vector);
-			double u2 = utility(&s.vector, &f.vector, strict);
+			gsl_vector_view y1 = gsl_matrix_column(objs, 2 * j);
+			gsl_vector_view y2 = gsl_matrix_column(objs, 2 * j + 1);
+			double u1 = utility(&y1.vector, ref, strict);
+			double u2 = utility(&y2.vector, ref, strict);
 			gsl_vector_set(y, j, method == OPT_LOG? log(u1/u2): u1-u2);
 			changed = changed || fabs(u1 - u2) > PRECISION;
 		}
@@ -210,6 +252,14 @@ int umbra::operator()(
 			gsl_vector_memcpy(&z.vector, &t.vector);
 		// must re-evaluate no matter if xval(i) == xval(i-1)
 		task->eval(&z.vector, &s.vector);
+
+		st.iteration = i;
+		st.evaluations += 2 * bs + 1;
+		st.objective = utility(&s.vector, &s.vector, false);
+		if (st.objective < st.best)
+			st.best = st.objective;
+		if (introspect_enabled())
+			introspect_optimizer(st);
 	}
 
 	ret = 0;
@@ -217,6 +267,9 @@ int umbra::operator()(
 done:
 	gsl_matrix_free(batch);
 	gsl_vector_free(y);
+	gsl_matrix_free(points);
+	gsl_matrix_free(objs);
+	gsl_vector_free(ref);
 
 	return ret;
 }
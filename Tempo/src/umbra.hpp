@@ -42,6 +42,26 @@ public:
 		virtual void proj(gsl_vector *x) = 0;
 		// Estimate the value of the objective functions
 		virtual void eval(const gsl_vector *x, gsl_vector *y) = 0;
+		// Estimate the objective functions of the rows of @xs into
+		// the columns of @ys, possibly concurrently. The results
+		// must not depend on the order of the evaluations. The
+		// default evaluates the rows in turn with eval().
+		virtual void eval_batch(const gsl_matrix *xs, gsl_matrix *ys);
+		// Bound the objectives of later batches, NULL for none. An
+		// evaluation may stop once an objective is known to exceed
+		// its bound, the objectives are then lower bounds.
+		virtual void set_bound(const gsl_vector *ub) { (void)ub; }
+		// Set the scale of the perturbations of the next batch, 1
+		// at first and shrinking as the search narrows. A problem
+		// may evaluate coarser batches at larger scales, and then
+		// sets @ref to the objectives of x0 at the same fidelity.
+		virtual void set_scale(double scale, gsl_vector *ref)
+		{
+			(void)scale;
+			(void)ref;
+		}
+
+		virtual ~problem() { }
 	};
 
         // Returns 0 on success, and [xval fval'] will hold the
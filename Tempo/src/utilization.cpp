@@ -0,0 +1,341 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <ulib/hash_open.h>
+#include <ulib/util_log.h>
+#include "utilization.hpp"
+
+// tasks analyzed per chunk, chunks never span pools
+#define UTILIZATION_CHUNK_TASKS 16384
+// timestamp resolution of the utilization curves, in ticks per second
+#define UTILIZATION_TICKS       1000000.0
+// windows a curve may have
+#define UTILIZATION_MAX_WINDOWS (1 << 24)
+
+namespace Tempo {
+
+namespace {
+
+// Busy slot time and extent of some tasks of a type
+struct ut_stat {
+	double busy;
+	double first;
+	double last;
+	size_t count;
+
+	ut_stat() : busy(0), first(HUGE_VAL), last(-HUGE_VAL), count(0) { }
+
+	void add(const ut_stat &o)
+	{
+		busy  += o.busy;
+		first  = o.first < first? o.first: first;
+		last   = o.last > last? o.last: last;
+		count += o.count;
+	}
+
+	double utilization(int nslots) const
+	{
+		// tasks all of zero length at one instant span no time
+		if (count == 0 || !(last > first) || nslots <= 0)
+			return 0;
+		return busy / (last - first) / nslots;
+	}
+};
+
+// Consecutive jobs of a pool
+struct ut_chunk {
+	const pool *p;
+	size_t      pool_index;
+	size_t      first;
+	size_t      last;
+	ut_stat     stat[task::TASK_TYPE_NUM];
+};
+
+// Busy ticks of a thread per window, split into the partly covered
+// windows at the ends of tasks and a difference array of the fully
+// covered ones
+struct ut_curve {
+	std::vector<int64_t> partial[task::TASK_TYPE_NUM];
+	std::vector<int64_t> full[task::TASK_TYPE_NUM];
+};
+
+struct ut_ctx {
+	std::vector<ut_chunk> chunks;
+	volatile size_t next;
+	bool            curves;
+	double          origin;
+	int64_t         wticks;
+	size_t          nwin;
+};
+
+struct ut_worker {
+	ut_ctx  *ctx;
+	ut_curve curve;
+};
+
+inline bool analyzed(const task &t)
+{
+	return t.stime >= 0 && t.ftime >= t.stime;
+}
+
+inline int64_t to_ticks(double t, double origin)
+{
+	return llround((t - origin) * UTILIZATION_TICKS);
+}
+
+void stat_chunk(ut_chunk *c)
+{
+	for (size_t j = c->first; j < c->last; ++j) {
+		const job &jb = c->p->jobs[j];
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			ut_stat &s = c->stat[type];
+			const job::task_container_type &tasks = jb.tasks[type];
+			for (size_t k = 0; k < tasks.size(); ++k) {
+				const task &t = tasks[k];
+				if (!analyzed(t))
+					continue;
+				s.busy += t.ftime - t.stime;
+				if (t.stime < s.first)
+					s.first = t.stime;
+				if (t.ftime > s.last)
+					s.last = t.ftime;
+				++s.count;
+			}
+		}
+	}
+}
+
+void curve_chunk(const ut_ctx &ctx, const ut_chunk &c, ut_curve *cv)
+{
+	int64_t w = ctx.wticks;
+
+	for (size_t j = c.first; j < c.last; ++j) {
+		const job &jb = c.p->jobs[j];
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			std::vector<int64_t> &partial = cv->partial[type];
+			std::vector<int64_t> &full = cv->full[type];
+			const job::task_container_type &tasks = jb.tasks[type];
+			for (size_t k = 0; k < tasks.size(); ++k) {
+				const task &t = tasks[k];
+				if (!analyzed(t))
+					continue;
+				int64_t s = to_ticks(t.stime, ctx.origin);
+				int64_t f = to_ticks(t.ftime, ctx.origin);
+				size_t ks = s / w;
+				size_t kf = f / w;
+				// the end of the trace closes the last window
+				if (ks >= ctx.nwin)
+					ks = ctx.nwin - 1;
+				if (kf >= ctx.nwin)
+					kf = ctx.nwin - 1;
+				if (ks == kf)
+					partial[ks] += f - s;
+				else {
+					partial[ks] += (ks + 1) * w - s;
+					partial[kf] += f - kf * w;
+					++full[ks + 1];
+					--full[kf];
+				}
+			}
+		}
+	}
+}
+
+void *analyze_worker(void *arg)
+{
+	ut_worker *wk = (ut_worker *)arg;
+	ut_ctx *ctx = wk->ctx;
+
+	for (;;) {
+		size_t i = __sync_fetch_and_add(&ctx->next, 1);
+		if (i >= ctx->chunks.size())
+			break;
+		if (ctx->curves)
+			curve_chunk(*ctx, ctx->chunks[i], &wk->curve);
+		else
+			stat_chunk(&ctx->chunks[i]);
+	}
+	return NULL;
+}
+
+// Run a pass over the chunks with @workers, the calling thread being
+// the first worker. Chunks are claimed as threads become free, the
+// calling thread completes the pass if no thread could start.
+void run_pass(ut_ctx *ctx, std::vector<ut_worker> *workers)
+{
+	std::vector<pthread_t> tids(workers->size());
+	size_t nstarted = 0;
+
+	ctx->next = 0;
+	for (size_t i = 1; i < workers->size(); ++i)
+		if (pthread_create(&tids[nstarted], NULL, analyze_worker, &(*workers)[i]) == 0)
+			++nstarted;
+	analyze_worker(&(*workers)[0]);
+	for (size_t i = 0; i < nstarted; ++i)
+		pthread_join(tids[i], NULL);
+}
+
+void plan_chunks(const job_tracker::pool_container_type &pools,
+		 std::vector<ut_chunk> *chunks)
+{
+	ut_chunk c;
+	size_t i = 0;
+
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit, ++i) {
+		c.p = &*pit;
+		c.pool_index = i;
+		c.first = 0;
+		size_t ntasks = 0;
+		for (size_t j = 0; j < pit->jobs.size(); ++j) {
+			const job &jb = pit->jobs[j];
+			ntasks += jb.tasks[task::TASK_TYPE_MAP].size() +
+				jb.tasks[task::TASK_TYPE_REDUCE].size();
+			if (ntasks >= UTILIZATION_CHUNK_TASKS || j + 1 == pit->jobs.size()) {
+				c.last = j + 1;
+				chunks->push_back(c);
+				ntasks = 0;
+				c.first = j + 1;
+			}
+		}
+	}
+}
+
+}  // anonymous namespace
+
+int analyze_utilization(const job_tracker::pool_container_type &pools,
+			int nmaps, int nreduces, utilization_report *report,
+			double window, int nthreads)
+{
+	int nslots[task::TASK_TYPE_NUM];
+	nslots[task::TASK_TYPE_MAP] = nmaps;
+	nslots[task::TASK_TYPE_REDUCE] = nreduces;
+	if (nmaps <= 0 || nreduces <= 0) {
+		ULIB_WARNING("invalid number of slots, maps %d reduces %d", nmaps, nreduces);
+		return -1;
+	}
+
+	ut_ctx ctx;
+	plan_chunks(pools, &ctx.chunks);
+
+	if (nthreads <= 0)
+		nthreads = sysconf(_SC_NPROCESSORS_ONLN);
+	if (nthreads <= 0)
+		nthreads = 1;
+	if ((size_t)nthreads > ctx.chunks.size())
+		nthreads = ctx.chunks.size()? ctx.chunks.size(): 1;
+	std::vector<ut_worker> workers(nthreads);
+	for (size_t i = 0; i < workers.size(); ++i)
+		workers[i].ctx = &ctx;
+
+	ctx.curves = false;
+	run_pass(&ctx, &workers);
+
+	// merge the chunks in order, so the sums do not depend on the
+	// threads, then fold the pools into their parents, children
+	// following their parents
+	std::vector<ut_stat> pstat[task::TASK_TYPE_NUM];
+	std::vector<const pool *> plist;
+	ulib::open_hash_map<uint64_t, size_t> pindex;
+	for (job_tracker::pool_container_type::const_iterator pit = pools.begin();
+	     pit != pools.end(); ++pit) {
+		pindex[pit->id] = plist.size();
+		plist.push_back(&*pit);
+	}
+	for (int type = 0; type < task::TASK_TYPE_NUM; ++type)
+		pstat[type].resize(plist.size());
+	for (size_t i = 0; i < ctx.chunks.size(); ++i)
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type)
+			pstat[type][ctx.chunks[i].pool_index].add(ctx.chunks[i].stat[type]);
+
+	ut_stat cluster[task::TASK_TYPE_NUM];
+	for (size_t i = plist.size(); i-- > 0; ) {
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			if (plist[i]->parent)
+				pstat[type][pindex[plist[i]->parent->id]].add(pstat[type][i]);
+			else
+				cluster[type].add(pstat[type][i]);
+		}
+	}
+
+	double first = HUGE_VAL;
+	double last = -HUGE_VAL;
+	for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+		report->cluster[type] = cluster[type].utilization(nslots[type]);
+		report->ntasks[type] = cluster[type].count;
+		report->pools[type].resize(plist.size());
+		for (size_t i = 0; i < plist.size(); ++i)
+			report->pools[type][i] = pstat[type][i].utilization(nslots[type]);
+		report->curve[type].clear();
+		if (cluster[type].count) {
+			first = std::min(first, cluster[type].first);
+			last = std::max(last, cluster[type].last);
+		}
+	}
+	report->origin = first < last? first: 0;
+	report->window = window;
+
+	if (!(window > 0) || !(first < last))
+		return 0;
+
+	ctx.origin = first;
+	ctx.wticks = llround(window * UTILIZATION_TICKS);
+	if (ctx.wticks <= 0) {
+		ULIB_WARNING("window %f is shorter than a microsecond", window);
+		return -1;
+	}
+	int64_t span = to_ticks(last, first);
+	if (span / ctx.wticks >= UTILIZATION_MAX_WINDOWS) {
+		ULIB_WARNING("window %f is too short for a trace of %f seconds",
+			     window, last - first);
+		return -1;
+	}
+	ctx.nwin = (span + ctx.wticks - 1) / ctx.wticks;
+	if (ctx.nwin == 0)
+		ctx.nwin = 1;
+	for (size_t i = 0; i < workers.size(); ++i) {
+		for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+			workers[i].curve.partial[type].assign(ctx.nwin, 0);
+			workers[i].curve.full[type].assign(ctx.nwin + 1, 0);
+		}
+	}
+
+	ctx.curves = true;
+	run_pass(&ctx, &workers);
+
+	// the tick sums are exact, whatever the threads
+	for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+		report->curve[type].resize(ctx.nwin);
+		int64_t nfull = 0;
+		for (size_t k = 0; k < ctx.nwin; ++k) {
+			int64_t busy = 0;
+			for (size_t i = 0; i < workers.size(); ++i) {
+				nfull += workers[i].curve.full[type][k];
+				busy += workers[i].curve.partial[type][k];
+			}
+			busy += nfull * ctx.wticks;
+			report->curve[type][k] = (double)busy / ctx.wticks / nslots[type];
+		}
+	}
+
+	return 0;
+}
+
+}
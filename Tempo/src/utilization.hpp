@@ -0,0 +1,53 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_UTILIZATION_H
+#define _COLOSSAL_UTILIZATION_H
+
+#include <vector>
+#include "task.hpp"
+#include "job_tracker.hpp"
+
+namespace Tempo {
+
+// Utilization of a trace, see analyze_utilization()
+struct utilization_report {
+	// effective utilization of the cluster and of each pool in the
+	// order of the pools, a pool including the tasks of its children
+	double cluster[task::TASK_TYPE_NUM];
+	std::vector<double> pools[task::TASK_TYPE_NUM];
+	size_t ntasks[task::TASK_TYPE_NUM];  // tasks analyzed
+
+	// utilization of the cluster in consecutive windows from @origin,
+	// the first task start, if a window was given
+	double origin;
+	double window;
+	std::vector<double> curve[task::TASK_TYPE_NUM];
+};
+
+// Effective utilization of the task times in @pools, e.g. an imported
+// trace, for the cluster and every pool at once. The values are those
+// of compute_utilization() up to rounding, without sorting the task
+// times. Tasks not started or not finished are left out. If
+// @window > 0, the utilization of the cluster in every window is
+// computed on timestamps rounded to the microsecond.
+// nthreads: number of threads, <= 0 to use all online CPUs
+// Returns 0 on success, -1 otherwise.
+int analyze_utilization(const job_tracker::pool_container_type &pools,
+			int nmaps, int nreduces, utilization_report *report,
+			double window = 0, int nthreads = 0);
+
+}
+
+#endif
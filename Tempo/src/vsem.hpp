@@ -61,6 +61,16 @@ public:
 		return _wlist.size();
 	}
 
+	// Drop the waiting objects and set the value to @val
+	void reset(int val)
+	{
+		while (_wlist.size()) {
+			delete _wlist.front();
+			_wlist.pop();
+		}
+		_val = val;
+	}
+
 private:
         std::queue<T> _wlist;
         int _val;
@@ -0,0 +1,240 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <ulib/hash_open.h>
+#include <ulib/util_log.h>
+#include "workload_file.hpp"
+#include "profile.hpp"
+
+namespace Tempo {
+
+workload_file::workload_file()
+	: _data(NULL), _size(0), _hdr(NULL)
+{
+	close();
+}
+
+workload_file::~workload_file()
+{
+	close();
+}
+
+void workload_file::close()
+{
+	if (_data)
+		munmap((void *)_data, _size);
+	_data = NULL;
+	_size = 0;
+	_hdr = NULL;
+	_strtab = NULL;
+	_pools = NULL;
+	_jobs = NULL;
+	_task_ids = NULL;
+	_task_names = NULL;
+	_ctimes = NULL;
+	_ptimes = NULL;
+	_stimes = NULL;
+	_ftimes = NULL;
+	_types = NULL;
+	_job_indices = NULL;
+}
+
+bool workload_file::is_binary(const char *file)
+{
+	char magic[sizeof(((wl_header *)0)->magic)];
+	FILE *fp = fopen(file, "r");
+	if (fp == NULL)
+		return false;
+	bool ret = fread(magic, sizeof(magic), 1, fp) == 1 &&
+		memcmp(magic, WORKLOAD_MAGIC, sizeof(magic)) == 0;
+	fclose(fp);
+	return ret;
+}
+
+// Returns true if an aligned section of @n elements of @size bytes
+// at @off lies within a file of @fsize bytes
+static bool section_ok(uint64_t off, uint64_t n, size_t size, size_t fsize)
+{
+	return off % 8 == 0 && off <= fsize &&
+		n <= (fsize - off) / size;
+}
+
+int workload_file::open(const char *file)
+{
+	close();
+
+	int fd = ::open(file, O_RDONLY);
+	if (fd == -1) {
+		ULIB_WARNING("cannot open %s for reading", file);
+		return -1;
+	}
+	struct stat st;
+	if (fstat(fd, &st) || (size_t)st.st_size < sizeof(wl_header)) {
+		ULIB_WARNING("%s is not a binary workload", file);
+		::close(fd);
+		return -1;
+	}
+	void *data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if (data == MAP_FAILED) {
+		ULIB_WARNING("cannot map %s", file);
+		return -1;
+	}
+	_data = (const char *)data;
+	_size = st.st_size;
+	_hdr = (const wl_header *)_data;
+
+	const wl_header &h = *_hdr;
+	uint64_t n = h.ntasks;
+	bool times = h.flags & wl_header::WL_FLAG_TIMES;
+	if (memcmp(h.magic, WORKLOAD_MAGIC, sizeof(h.magic)) ||
+	    h.version != WORKLOAD_VERSION ||
+	    !section_ok(h.strtab_off, h.strtab_size, 1, _size) ||
+	    (h.strtab_size && _data[h.strtab_off + h.strtab_size - 1] != '\0') ||
+	    !section_ok(h.pools_off, h.npools, sizeof(wl_pool), _size) ||
+	    !section_ok(h.jobs_off, h.njobs, sizeof(wl_job), _size) ||
+	    !section_ok(h.task_id_off, n, sizeof(uint64_t), _size) ||
+	    !section_ok(h.task_name_off, n, sizeof(uint64_t), _size) ||
+	    !section_ok(h.ctime_off, n, sizeof(double), _size) ||
+	    !section_ok(h.ptime_off, n, sizeof(double), _size) ||
+	    (times && !section_ok(h.stime_off, n, sizeof(double), _size)) ||
+	    (times && !section_ok(h.ftime_off, n, sizeof(double), _size)) ||
+	    !section_ok(h.type_off, n, sizeof(uint8_t), _size) ||
+	    !section_ok(h.job_index_off, n, sizeof(uint32_t), _size)) {
+		ULIB_WARNING("%s is not a valid binary workload", file);
+		close();
+		return -1;
+	}
+
+	_strtab = _data + h.strtab_off;
+	_pools = (const wl_pool *)(_data + h.pools_off);
+	_jobs = (const wl_job *)(_data + h.jobs_off);
+	_task_ids = (const uint64_t *)(_data + h.task_id_off);
+	_task_names = (const uint64_t *)(_data + h.task_name_off);
+	_ctimes = (const double *)(_data + h.ctime_off);
+	_ptimes = (const double *)(_data + h.ptime_off);
+	_stimes = times? (const double *)(_data + h.stime_off): NULL;
+	_ftimes = times? (const double *)(_data + h.ftime_off): NULL;
+	_types = (const uint8_t *)(_data + h.type_off);
+	_job_indices = (const uint32_t *)(_data + h.job_index_off);
+
+	// directories must stay within their sections
+	for (size_t i = 0; i < h.npools; ++i) {
+		if (_pools[i].name >= h.strtab_size ||
+		    _pools[i].first_job > h.njobs ||
+		    _pools[i].njobs > h.njobs - _pools[i].first_job) {
+			ULIB_WARNING("%s has a corrupted pool directory", file);
+			close();
+			return -1;
+		}
+	}
+	for (size_t i = 0; i < h.njobs; ++i) {
+		uint64_t cnt = (uint64_t)_jobs[i].nmaps + _jobs[i].nreduces;
+		if (_jobs[i].name >= h.strtab_size ||
+		    _jobs[i].first_task > n || cnt > n - _jobs[i].first_task) {
+			ULIB_WARNING("%s has a corrupted job directory", file);
+			close();
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+int workload_file::load(job_tracker::pool_container_type *pools) const
+{
+	PROFILE_ALLOC_SCOPE(ALLOC_IMPORT);
+	ulib::open_hash_map<uint64_t, pool *> pmap;
+
+	for (job_tracker::pool_container_type::iterator pit = pools->begin();
+	     pit != pools->end(); ++pit)
+		pmap[pit->id] = &*pit;
+
+	for (size_t i = 0; i < pool_count(); ++i) {
+		const wl_pool &wp = _pools[i];
+		ulib::open_hash_map<uint64_t, pool *>::iterator pit = pmap.find(wp.id);
+		if (pit == pmap.end()) {
+			ULIB_FATAL("pool %s has not been configured", str(wp.name));
+			return -1;
+		}
+		pool *p = pit.value();
+		if (p->name != str(wp.name)) {
+			ULIB_FATAL("pool %s collides with pool %s", str(wp.name), p->name.c_str());
+			return -1;
+		}
+		if (!p->is_leaf()) {
+			ULIB_FATAL("pool %s has child pools, jobs must go to a leaf pool",
+				   str(wp.name));
+			return -1;
+		}
+		// avoid copying the task lists of earlier jobs on growth
+		p->jobs.reserve(p->jobs.size() + wp.njobs);
+		for (uint64_t k = wp.first_job; k < wp.first_job + wp.njobs; ++k) {
+			const wl_job &wj = _jobs[k];
+			job nj;
+			nj.id = wj.id;
+			nj.ctime = wj.ctime;
+			nj.ftime = -1;
+			nj.fs_ctx_map.uid = wj.id;
+			nj.fs_ctx_reduce.uid = wj.id;
+			nj.fs_ctx_map.weight = wj.weight;
+			nj.fs_ctx_reduce.weight = wj.weight;
+			nj.name = p->names.add(str(wj.name), strlen(str(wj.name)));
+			job &j = p->add_job(nj);
+
+			uint64_t t = wj.first_task;
+			uint32_t count[task::TASK_TYPE_NUM];
+			count[task::TASK_TYPE_MAP] = wj.nmaps;
+			count[task::TASK_TYPE_REDUCE] = wj.nreduces;
+			task::task_type order[] = { task::TASK_TYPE_MAP, task::TASK_TYPE_REDUCE };
+			for (int o = 0; o < task::TASK_TYPE_NUM; ++o) {
+				job::task_container_type &tasks = j.tasks[order[o]];
+				tasks.resize(count[order[o]]);
+				for (size_t m = 0; m < tasks.size(); ++m, ++t) {
+					if (_task_names[t] >= _hdr->strtab_size) {
+						ULIB_FATAL("task %zu has a corrupted name", (size_t)t);
+						return -1;
+					}
+					const char *name = str(_task_names[t]);
+					tasks[m].name = p->names.add(name, strlen(name));
+					tasks[m].id = _task_ids[t];
+					tasks[m].ctime = _ctimes[t];
+					tasks[m].ptime = _ptimes[t];
+					tasks[m].stime = _stimes? _stimes[t]: -1;
+					tasks[m].ftime = _ftimes? _ftimes[t]: -1;
+					tasks[m].type = order[o];
+				}
+			}
+		}
+	}
+
+	return 0;
+}
+
+int import_binary_workload(const char *file, job_tracker::pool_container_type *pools)
+{
+	workload_file wf;
+
+	if (wf.open(file))
+		return -1;
+	return wf.load(pools);
+}
+
+}
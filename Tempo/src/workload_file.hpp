@@ -0,0 +1,146 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_WORKLOAD_FILE_H
+#define _COLOSSAL_WORKLOAD_FILE_H
+
+#include <cstddef>
+#include <stdint.h>
+#include "pool.hpp"
+#include "job_tracker.hpp"
+
+namespace Tempo {
+
+// Binary columnar workload format
+//
+// The file starts with a wl_header, followed by 8-byte aligned
+// sections: a string table of NUL-terminated names, the pool
+// directory, the job directory and one array per task column. Jobs
+// are grouped by pool and tasks by job, maps before reduces, each in
+// the order of the text workload. Integers and doubles are stored in
+// host byte order.
+
+#define WORKLOAD_MAGIC   "TEMPOWL"
+#define WORKLOAD_VERSION 1
+
+struct wl_header {
+	char     magic[8];     // WORKLOAD_MAGIC
+	uint32_t version;      // WORKLOAD_VERSION
+	uint32_t flags;        // WL_FLAG_*
+	uint64_t npools;
+	uint64_t njobs;
+	uint64_t ntasks;
+	uint64_t strtab_off;   // section offsets from the file start
+	uint64_t strtab_size;
+	uint64_t pools_off;
+	uint64_t jobs_off;
+	uint64_t task_id_off;
+	uint64_t task_name_off;
+	uint64_t ctime_off;
+	uint64_t ptime_off;
+	uint64_t stime_off;    // 0 if WL_FLAG_TIMES is not set
+	uint64_t ftime_off;    // 0 if WL_FLAG_TIMES is not set
+	uint64_t type_off;
+	uint64_t job_index_off;
+
+	enum {
+		WL_FLAG_TIMES = 1  // observed start and finish times present
+	};
+};
+
+struct wl_pool {
+	uint64_t name;       // string table offset
+	uint64_t id;         // pool::id_from_str(name)
+	uint64_t first_job;
+	uint64_t njobs;
+};
+
+struct wl_job {
+	uint64_t name;       // string table offset
+	uint64_t id;         // job::id_from_str(name)
+	double   ctime;
+	double   weight;
+	uint64_t first_task;
+	uint32_t nmaps;      // maps precede reduces
+	uint32_t nreduces;
+};
+
+// Read-only view of a memory-mapped binary workload
+// Columns are used in place; nothing is copied when opening a file.
+class workload_file
+{
+public:
+	workload_file();
+	~workload_file();
+
+	// Map and validate a binary workload
+	// Returns 0 on success, -1 otherwise.
+	int open(const char *file);
+	void close();
+
+	// Returns true if @file starts with the binary workload magic
+	static bool is_binary(const char *file);
+
+	// counts are zero if no file is open
+	size_t pool_count() const { return _hdr? _hdr->npools: 0; }
+	size_t job_count() const { return _hdr? _hdr->njobs: 0; }
+	size_t task_count() const { return _hdr? _hdr->ntasks: 0; }
+	bool   has_times() const { return _hdr && (_hdr->flags & wl_header::WL_FLAG_TIMES); }
+
+	const wl_pool &pool_at(size_t i) const { return _pools[i]; }
+	const wl_job  &job_at(size_t i) const { return _jobs[i]; }
+	const char    *str(uint64_t off) const { return _strtab + off; }
+
+	// task columns, indexed by task
+	const uint64_t *task_ids() const { return _task_ids; }
+	const uint64_t *task_names() const { return _task_names; }
+	const double   *ctimes() const { return _ctimes; }
+	const double   *ptimes() const { return _ptimes; }
+	const double   *stimes() const { return _stimes; }  // NULL without times
+	const double   *ftimes() const { return _ftimes; }  // NULL without times
+	const uint8_t  *types() const { return _types; }
+	const uint32_t *job_indices() const { return _job_indices; }
+
+	// Add the jobs and tasks to the configured pools, the same as
+	// importing the text workload the file was converted from
+	// Returns 0 on success, -1 otherwise.
+	int load(job_tracker::pool_container_type *pools) const;
+
+private:
+	workload_file(const workload_file &);
+	workload_file &operator=(const workload_file &);
+
+	const char      *_data;
+	size_t           _size;
+	const wl_header *_hdr;
+	const char      *_strtab;
+	const wl_pool   *_pools;
+	const wl_job    *_jobs;
+	const uint64_t  *_task_ids;
+	const uint64_t  *_task_names;
+	const double    *_ctimes;
+	const double    *_ptimes;
+	const double    *_stimes;
+	const double    *_ftimes;
+	const uint8_t   *_types;
+	const uint32_t  *_job_indices;
+};
+
+// Import a binary workload into the configured pools
+// Returns 0 on success, -1 otherwise.
+int import_binary_workload(const char *file, job_tracker::pool_container_type *pools);
+
+}
+
+#endif
@@ -0,0 +1,200 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <algorithm>
+#include <ulib/hash_func.h>
+#include "workload_index.hpp"
+
+namespace Tempo {
+
+size_t workload_view::task_count() const
+{
+	size_t n = 0;
+	for (size_t i = 0; i < parts.size(); ++i)
+		n += parts[i].task_count();
+	return n;
+}
+
+size_t workload_view::job_count() const
+{
+	size_t n = 0;
+	for (size_t i = 0; i < parts.size(); ++i)
+		n += parts[i].job_count();
+	return n;
+}
+
+workload_index::workload_index()
+	: _min(1), _max(0), _width(1), _nbuckets(0)
+{
+}
+
+template<typename E>
+static bool ctime_less(const E &a, const E &b)
+{
+	return a.ctime < b.ctime;
+}
+
+// Returns the first entry of each of @n buckets of @width from @origin
+// The first bucket also holds the entries before @origin.
+template<typename E>
+static void fill_buckets(const std::vector<E> &v, double origin, double width,
+			 size_t n, std::vector<uint32_t> *buckets)
+{
+	buckets->resize(n);
+	(*buckets)[0] = 0;
+	size_t k = 0;
+	for (size_t b = 1; b < n; ++b) {
+		double start = origin + b * width;
+		while (k < v.size() && v[k].ctime < start)
+			++k;
+		(*buckets)[b] = k;
+	}
+}
+
+bool workload_index::sampled(const job &j, double fraction)
+{
+	if (fraction >= 1.0)
+		return true;
+	uint64_t h = hash_fast64(&j.id, sizeof(j.id), 0);
+	return (h >> 11) * (1.0 / 9007199254740992.0) < fraction;
+}
+
+void workload_index::build(std::list<pool> &pools, size_t tasks_per_bucket,
+			   double fraction)
+{
+	size_t ntasks = 0;
+
+	_pools.clear();
+	_min = 1;
+	_max = 0;
+	for (std::list<pool>::iterator pit = pools.begin(); pit != pools.end(); ++pit) {
+		_pools.push_back(pool_index());
+		pool_index &pi = _pools.back();
+		pi.p = &*pit;
+		for (size_t j = 0; j < pit->jobs.size(); ++j) {
+			const job &jb = pit->jobs[j];
+			if (!sampled(jb, fraction))
+				continue;
+			wi_job wj;
+			wj.ctime = jb.ctime;
+			wj.job = j;
+			pi.jobs.push_back(wj);
+			for (int type = 0; type < task::TASK_TYPE_NUM; ++type) {
+				const job::task_container_type &tasks = jb.tasks[type];
+				for (size_t k = 0; k < tasks.size(); ++k) {
+					wi_task t;
+					t.ctime = jb.ctime;
+					t.job = j;
+					t.slot = k * task::TASK_TYPE_NUM + type;
+					pi.tasks.push_back(t);
+				}
+			}
+			if (_min > _max)
+				_min = _max = jb.ctime;
+			else if (jb.ctime < _min)
+				_min = jb.ctime;
+			else if (jb.ctime > _max)
+				_max = jb.ctime;
+		}
+		// ties stay in the order of the pool, which keeps the
+		// tasks of a job together
+		std::stable_sort(pi.tasks.begin(), pi.tasks.end(), ctime_less<wi_task>);
+		std::stable_sort(pi.jobs.begin(), pi.jobs.end(), ctime_less<wi_job>);
+		ntasks += pi.tasks.size();
+	}
+
+	_nbuckets = 0;
+	if (ntasks == 0)
+		return;
+	if (tasks_per_bucket == 0)
+		tasks_per_bucket = 1;
+	_nbuckets = ntasks / tasks_per_bucket + 1;
+	_width = (_max - _min) / _nbuckets;
+	if (!(_width > 0)) {
+		_width = 1;
+		_nbuckets = 1;
+	}
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		pool_index &pi = _pools[i];
+		fill_buckets(pi.tasks, _min, _width, _nbuckets, &pi.task_buckets);
+		fill_buckets(pi.jobs, _min, _width, _nbuckets, &pi.job_buckets);
+	}
+}
+
+template<typename E>
+const E *workload_index::lower_bound(const std::vector<E> &v,
+				     const std::vector<uint32_t> &buckets,
+				     double t) const
+{
+	if (v.empty())
+		return NULL;
+	const E *first = &v[0];
+	size_t lo = 0, hi = v.size();
+	if (_nbuckets) {
+		double f = (t - _min) / _width;
+		size_t b = f < 0? 0: f < _nbuckets? (size_t)f: _nbuckets - 1;
+		// bucket starts are computed as in fill_buckets()
+		while (b > 0 && t < _min + b * _width)
+			--b;
+		while (b + 1 < _nbuckets && t >= _min + (b + 1) * _width)
+			++b;
+		lo = buckets[b];
+		if (b + 1 < _nbuckets)
+			hi = buckets[b + 1];
+	}
+	E key;
+	key.ctime = t;
+	return std::lower_bound(first + lo, first + hi, key, ctime_less<E>);
+}
+
+void workload_index::slice_pool(const pool_index &pi, double t0, double t1,
+				workload_view *view) const
+{
+	workload_view::part part;
+
+	part.p = pi.p;
+	part.tasks = lower_bound(pi.tasks, pi.task_buckets, t0);
+	part.tasks_end = lower_bound(pi.tasks, pi.task_buckets, t1);
+	part.jobs = lower_bound(pi.jobs, pi.job_buckets, t0);
+	part.jobs_end = lower_bound(pi.jobs, pi.job_buckets, t1);
+	if (t1 < t0) {
+		part.tasks_end = part.tasks;
+		part.jobs_end = part.jobs;
+	}
+	view->parts.push_back(part);
+}
+
+workload_view workload_index::slice(double t0, double t1) const
+{
+	workload_view view;
+
+	for (size_t i = 0; i < _pools.size(); ++i)
+		slice_pool(_pools[i], t0, t1, &view);
+	return view;
+}
+
+workload_view workload_index::slice(const pool &p, double t0, double t1) const
+{
+	workload_view view;
+
+	for (size_t i = 0; i < _pools.size(); ++i) {
+		if (_pools[i].p == &p) {
+			slice_pool(_pools[i], t0, t1, &view);
+			break;
+		}
+	}
+	return view;
+}
+
+}
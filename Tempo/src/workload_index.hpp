@@ -0,0 +1,133 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#ifndef _COLOSSAL_WORKLOAD_INDEX_H
+#define _COLOSSAL_WORKLOAD_INDEX_H
+
+#include <cstddef>
+#include <stdint.h>
+#include <list>
+#include <vector>
+#include "task.hpp"
+#include "job.hpp"
+#include "pool.hpp"
+
+namespace Tempo {
+
+// a task of an indexed pool
+struct wi_task {
+	double   ctime; // of the job, so windows take whole jobs
+	uint32_t job;   // index in the jobs of the pool
+	uint32_t slot;  // index in the tasks of the job * TASK_TYPE_NUM + type
+
+	task::task_type type() const { return (task::task_type)(slot % task::TASK_TYPE_NUM); }
+	size_t index() const { return slot / task::TASK_TYPE_NUM; }
+};
+
+// a job of an indexed pool
+struct wi_job {
+	double   ctime;
+	uint32_t job;   // index in the jobs of the pool
+};
+
+// Jobs of the pools created within a time window and all their tasks
+// The entries point into a workload_index, and through it to the jobs
+// and tasks of the pools; nothing is copied.
+class workload_view
+{
+public:
+	// the window of one pool, entries are sorted by ctime
+	struct part {
+		pool          *p;
+		const wi_task *tasks;
+		const wi_task *tasks_end;
+		const wi_job  *jobs;
+		const wi_job  *jobs_end;
+
+		size_t task_count() const { return tasks_end - tasks; }
+		size_t job_count() const { return jobs_end - jobs; }
+
+		task &task_at(const wi_task &t) const { return p->jobs[t.job].tasks[t.type()][t.index()]; }
+		job  &job_at(const wi_job &j) const { return p->jobs[j.job]; }
+	};
+
+	// parts in the order of the pools
+	std::vector<part> parts;
+
+	size_t task_count() const;
+	size_t job_count() const;
+};
+
+// Index of the jobs and tasks of the pools by job creation time
+//
+// Each pool keeps its jobs and tasks sorted by the ctime of the job,
+// ties in the order of the pool, along with coarse time buckets
+// pointing to the first entry of every bucket, so a window is found
+// with a bucket lookup and a short binary search. A window takes every
+// task of the jobs created within it, even the tasks created after it,
+// so that the jobs of a view finish as they would in the full run.
+// Jobs and tasks added after build() are not indexed until the next
+// build(), and the pools must outlive the index.
+class workload_index
+{
+public:
+	workload_index();
+
+	// Index the jobs and tasks of @pools, replacing the previous index
+	// @tasks_per_bucket sets the bucket width from the average task rate.
+	// @fraction keeps a sample of the jobs, see sampled().
+	void build(std::list<pool> &pools, size_t tasks_per_bucket = 64,
+		   double fraction = 1.0);
+
+	// Whether job @j is in the sample of @fraction of the jobs
+	// The sample only depends on the job id, and samples of smaller
+	// fractions are subsets of those of larger ones.
+	static bool sampled(const job &j, double fraction);
+
+	// Jobs of all pools created within [@t0, @t1) and their tasks
+	workload_view slice(double t0, double t1) const;
+
+	// Jobs of pool @p created within [@t0, @t1) and their tasks, an
+	// empty view if the pool is not indexed
+	workload_view slice(const pool &p, double t0, double t1) const;
+
+	// ctime range of the indexed jobs, min > max if there are none
+	double min_ctime() const { return _min; }
+	double max_ctime() const { return _max; }
+
+private:
+	struct pool_index {
+		pool                 *p;
+		std::vector<wi_task>  tasks;
+		std::vector<wi_job>   jobs;
+		std::vector<uint32_t> task_buckets;  // first entry of each bucket
+		std::vector<uint32_t> job_buckets;
+	};
+
+	template<typename E>
+	const E *lower_bound(const std::vector<E> &v, const std::vector<uint32_t> &buckets,
+			     double t) const;
+
+	void slice_pool(const pool_index &pi, double t0, double t1, workload_view *view) const;
+
+	std::vector<pool_index> _pools;
+	double _min;
+	double _max;
+	double _width;     // bucket width
+	size_t _nbuckets;
+};
+
+}
+
+#endif
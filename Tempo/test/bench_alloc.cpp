@@ -0,0 +1,74 @@
+// Count the allocations per event of a simulation in the steady state.
+// Needs the library and the test built with make PROFILE=-DTEMPO_PROFILE_ALLOC,
+// fails if the run allocates more than the budget per event.
+
+#include <cstdio>
+#include <cstdlib>
+#include <Tempo/tempo.hpp>
+#include <Tempo/profile.hpp>
+
+#ifdef TEMPO_PROFILE_ALLOC
+
+// Zero is not reached yet: the engine allocates every event with new and
+// hlist its nodes, about 3 per event, and fs_select grows a fresh job heap
+// for every fair pop, about 118 per event of the default workload which
+// measures 121.1. The budget catches regressions beyond that.
+#define ALLOCS_PER_EVENT_BUDGET 128.0
+
+static void add_tasks(Tempo::job &j, Tempo::task::task_type type, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		Tempo::task t;
+		t.id = j.id * 1000 + i;
+		t.ctime = j.ctime;
+		t.ptime = 1 + (j.id + i) % 7;
+		t.stime = -1;
+		t.ftime = -1;
+		t.type = type;
+		j.tasks[type].push_back(t);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	int npools = argc > 1? atoi(argv[1]): 8;
+	int njobs  = argc > 2? atoi(argv[2]): 256;
+	int ntasks = argc > 3? atoi(argv[3]): 16;
+	Tempo::job_tracker jt(npools * 8, npools * 4);
+	char pname[32];
+	for (int i = 0; i < npools; ++i) {
+		snprintf(pname, sizeof(pname), "pool%d", i);
+		Tempo::pool &p = jt.add_pool(pname, -1, -1, 1 + i % 3, 2, 1,
+					     Tempo::pool::SCHED_FAIR);
+		for (int k = 0; k < njobs; ++k) {
+			Tempo::job j;
+			j.id = i * njobs + k + 1;
+			j.ctime = k * 2;
+			j.fs_ctx_map.uid = j.id;
+			j.fs_ctx_reduce.uid = j.id;
+			add_tasks(j, Tempo::task::TASK_TYPE_MAP, ntasks);
+			add_tasks(j, Tempo::task::TASK_TYPE_REDUCE, ntasks / 4 + 1);
+			p.add_job(j);
+		}
+	}
+	jt.scale_minshares();
+	jt.process();
+
+	uint64_t nev = Tempo::profile_steady_events();
+	uint64_t nalloc = Tempo::profile_steady_allocs();
+	double per_event = nev? (double)nalloc / nev: 0;
+	printf("%lu allocations in the last %lu events, %.3f per event, budget %.3f\n",
+	       (unsigned long)nalloc, (unsigned long)nev, per_event,
+	       ALLOCS_PER_EVENT_BUDGET);
+	return per_event > ALLOCS_PER_EVENT_BUDGET;
+}
+
+#else
+
+int main()
+{
+	printf("build with make PROFILE=-DTEMPO_PROFILE_ALLOC to count allocations\n");
+	return 0;
+}
+
+#endif
@@ -0,0 +1,76 @@
+// Measure the per-pop cost of the task selector for each job
+// scheduling mode.
+
+#include <sys/time.h>
+#include <cstdio>
+#include <cstdlib>
+#include <Tempo/tempo.hpp>
+
+static double now_us()
+{
+	struct timeval tv;
+	gettimeofday(&tv, NULL);
+	return tv.tv_sec * 1e6 + tv.tv_usec;
+}
+
+static void add_tasks(Tempo::job &j, Tempo::task::task_type type, int n)
+{
+	for (int i = 0; i < n; ++i) {
+		Tempo::task t;
+		t.id = j.id * 1000 + i;
+		t.ctime = 0;
+		t.ptime = 1;
+		t.stime = -1;
+		t.ftime = -1;
+		t.type = type;
+		j.tasks[type].push_back(t);
+	}
+}
+
+static void bench(Tempo::pool::sched_mode sched, const char *name,
+		  int npools, int njobs, int ntasks)
+{
+	std::list<Tempo::pool> pools;
+	char pname[32];
+	for (int i = 0; i < npools; ++i) {
+		snprintf(pname, sizeof(pname), "pool%d", i);
+		pools.push_back(Tempo::pool(pname, -1, -1, 1 + i % 3, 0, 0, sched));
+		for (int k = 0; k < njobs; ++k) {
+			Tempo::job j;
+			j.id = i * njobs + k + 1;
+			j.ctime = k;
+			j.fs_ctx_map.uid = j.id;
+			j.fs_ctx_reduce.uid = j.id;
+			add_tasks(j, Tempo::task::TASK_TYPE_MAP, ntasks);
+			add_tasks(j, Tempo::task::TASK_TYPE_REDUCE, ntasks);
+			pools.back().add_job(j);
+		}
+	}
+
+	Tempo::selector sel(pools.begin(), pools.end());
+	sel.see_maps(0);
+	sel.see_reduces(0);
+
+	size_t n = 0;
+	double start = now_us();
+	while (sel.pop_map())
+		++n;
+	while (sel.pop_reduce())
+		++n;
+	double elapsed = now_us() - start;
+
+	printf("%s: %d pools x %d jobs x %d tasks, %zu pops, %.1f ns/pop\n",
+	       name, npools, njobs, ntasks, n, elapsed * 1000 / n);
+}
+
+int main(int argc, char *argv[])
+{
+	int npools = argc > 1? atoi(argv[1]): 8;
+	int njobs  = argc > 2? atoi(argv[2]): 64;
+	int ntasks = argc > 3? atoi(argv[3]): 64;
+
+	bench(Tempo::pool::SCHED_FAIR, "FAIR", npools, njobs, ntasks);
+	bench(Tempo::pool::SCHED_FCFS, "FCFS", npools, njobs, ntasks);
+
+        return 0;
+}
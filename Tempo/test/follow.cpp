@@ -0,0 +1,83 @@
+/* Tempo
+ * Copyright (c) Zilong Tan, Shivnath Babu {ztan,shivnath}@cs.duke.edu
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to
+ * deal in the Software without restriction, subject to the conditions listed
+ * in the Tempo LICENSE file. These conditions include: you must preserve this
+ * copyright notice, and you cannot mention the copyright holders in
+ * advertising related to the Software without their permission.  The Software
+ * is provided WITHOUT ANY WARRANTY, EXPRESS OR IMPLIED. This notice is a
+ * summary of the Tempo LICENSE file; the license in that file is legally
+ * binding.
+ */
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unistd.h>
+#include <Tempo/tempo.hpp>
+
+// Appends @s to @file, without a newline unless given
+static void append(const std::string &file, const char *s)
+{
+	FILE *fp = fopen(file.c_str(), "a");
+	fputs(s, fp);
+	fclose(fp);
+}
+
+static void show(Tempo::workload_follower &wf, Tempo::job_tracker &jt, long n)
+{
+	const Tempo::pool &p = jt.getpools().front();
+	size_t ntasks = 0;
+	for (size_t i = 0; i < p.jobs.size(); ++i)
+		ntasks += p.jobs[i].tasks[Tempo::task::TASK_TYPE_MAP].size() +
+			p.jobs[i].tasks[Tempo::task::TASK_TYPE_REDUCE].size();
+	printf("imported %ld, jobs = %zu, tasks = %zu, pending = %zu bytes\n",
+	       n, p.jobs.size(), ntasks, wf.pending());
+}
+
+int main()
+{
+	char tmpl[] = "/tmp/tempo_follow.XXXXXX";
+	if (mkdtemp(tmpl) == NULL) {
+		perror("mkdtemp");
+		return EXIT_FAILURE;
+	}
+	std::string dir = tmpl;
+	std::string f1 = dir + "/part-0001";
+	std::string f2 = dir + "/part-0002";
+
+	Tempo::job_tracker jt(4, 4);
+	jt.add_pool("prod", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+	Tempo::workload_follower wf(Tempo::WORKLOAD_PTIME, &jt.getpools());
+	if (wf.open(dir.c_str()))
+		return EXIT_FAILURE;
+
+	// nothing to read yet
+	show(wf, jt, wf.poll(20));
+
+	append(f1, "prod\tjob_1:NORMAL\tm_1\tMAP\t0\t10\n"
+	       "prod\tjob_1:NORMAL\tm_2\tMAP\t0\t12\nprod\tjob_1:NO");
+	show(wf, jt, wf.poll(100));
+
+	// the partial line is completed, the job continues
+	append(f1, "RMAL\tr_1\tREDUCE\t0\t5\n");
+	show(wf, jt, wf.poll(100));
+
+	// the last line of a rotated file may lack a newline
+	append(f1, "prod\tjob_2:HIGH\tm_1\tMAP\t1\t3");
+	append(f2, "prod\tjob_2:HIGH\tr_1\tREDUCE\t1\t4\n");
+	show(wf, jt, wf.poll(100));
+	printf("following %s\n", wf.current().substr(dir.size() + 1).c_str());
+
+	printf("%s\n", jt.getpools().front().to_str().c_str());
+
+	wf.close();
+	unlink(f1.c_str());
+	unlink(f2.c_str());
+	rmdir(dir.c_str());
+
+	return 0;
+}
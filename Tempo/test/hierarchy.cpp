@@ -0,0 +1,49 @@
+#include <Tempo/tempo.hpp>
+
+// Builds job @id with @n map tasks of length @ptime created at time 0
+static Tempo::job make_job(uint64_t id, int n, double ptime)
+{
+	Tempo::job j;
+	j.id = id;
+	j.fs_ctx_map.uid = id;
+	for (int i = 0; i < n; ++i) {
+		Tempo::task t;
+		t.id = id * 100 + i;
+		t.ctime = 0;
+		t.ptime = ptime;
+		t.stime = -1;
+		t.ftime = -1;
+		t.type = Tempo::task::TASK_TYPE_MAP;
+		j.tasks[Tempo::task::TASK_TYPE_MAP].push_back(t);
+	}
+	return j;
+}
+
+int main()
+{
+	Tempo::job_tracker jt(8, 0);
+
+	// eng and prod split the cluster evenly, and prod is further
+	// split 3:1 between etl and reports, so the first wave should
+	// run 4 eng, 3 etl and 1 reports tasks
+	Tempo::pool &eng  = jt.add_pool("eng",  -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+	Tempo::pool &prod = jt.add_pool("prod", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+	Tempo::pool &etl  = jt.add_pool("etl",  -1, -1, 3, 0, 0, Tempo::pool::SCHED_FAIR, &prod);
+	Tempo::pool &rep  = jt.add_pool("reports", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FCFS, &prod);
+
+	eng.add_job(make_job(1, 8, 10));
+	etl.add_job(make_job(2, 6, 10));
+	rep.add_job(make_job(3, 4, 10));
+
+	jt.process();
+
+	Tempo::print_pool_settings(jt.getpools());
+
+	printf("------------ WORKLOAD ------------\n");
+	printf("%s\n", eng.to_str().c_str());
+	printf("%s\n", etl.to_str().c_str());
+	printf("%s\n", rep.to_str().c_str());
+	printf("----------------------------------\n");
+
+        return 0;
+}
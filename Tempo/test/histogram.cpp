@@ -0,0 +1,130 @@
+// Check the quantiles of histogram against a sorted copy of the values.
+
+#include <cmath>
+#include <cstdio>
+#include <algorithm>
+#include <vector>
+#include <Tempo/histogram.hpp>
+
+static int failures;
+
+#define CHECK(cond, ...)					\
+	do {							\
+		if (!(cond)) {					\
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);	\
+			printf(__VA_ARGS__);			\
+			printf("\n");				\
+			++failures;				\
+		}						\
+	} while (0)
+
+static const double quantiles[] = {
+	0, 0.001, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 1 };
+static const size_t nquantiles = sizeof(quantiles) / sizeof(quantiles[0]);
+
+// relative error of the middle of a bucket, plus the absolute error of
+// the values below the first bucket
+static const double rel_error = 0.5 / Tempo::histogram::HIST_SUB_BUCKETS;
+static const double abs_error = ldexp(1.0, Tempo::histogram::HIST_MIN_EXP + 1);
+
+// deterministic uniform numbers in [0, 1)
+static double uniform(uint64_t *state)
+{
+	*state = *state * 6364136223846793005ULL + 1442695040888963407ULL;
+	return (*state >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Compares the quantiles of @h with those of the sorted @values
+static void check_quantiles(const char *name, const Tempo::histogram &h,
+			    std::vector<double> values)
+{
+	std::sort(values.begin(), values.end());
+	CHECK(h.count() == values.size(), "%s: count %lu, expected %zu", name,
+	      (unsigned long)h.count(), values.size());
+	CHECK(h.min() == values.front() && h.max() == values.back(),
+	      "%s: range [%g, %g], expected [%g, %g]", name, h.min(), h.max(),
+	      values.front(), values.back());
+	double worst = 0;
+	for (size_t i = 0; i < nquantiles; ++i) {
+		double q = quantiles[i];
+		size_t rank = (size_t)ceil(q * values.size());
+		double exact = values[rank? rank - 1: 0];
+		double v = h.quantile(q);
+		double err = fabs(v - exact);
+		CHECK(err <= exact * rel_error + abs_error,
+		      "%s: quantile %g is %g, exact %g", name, q, v, exact);
+		if (exact > 0)
+			worst = std::max(worst, err / exact);
+	}
+	printf("%s: %zu values, worst relative quantile error %.4f%%\n",
+	       name, values.size(), worst * 100);
+}
+
+int main()
+{
+	uint64_t state = 42;
+
+	// log-uniform over [1e-3, 1e7], the span of response times and
+	// slowdowns
+	Tempo::histogram h, lo, hi;
+	std::vector<double> values;
+	for (int i = 0; i < 100000; ++i) {
+		double v = pow(10, -3 + 10 * uniform(&state));
+		values.push_back(v);
+		h.add(v);
+		(i % 2? lo: hi).add(v);
+	}
+	check_quantiles("log-uniform", h, values);
+
+	// merging the halves gives the same histogram
+	lo.merge(hi);
+	for (size_t i = 0; i < nquantiles; ++i)
+		CHECK(lo.quantile(quantiles[i]) == h.quantile(quantiles[i]),
+		      "merged: quantile %g is %g, expected %g", quantiles[i],
+		      lo.quantile(quantiles[i]), h.quantile(quantiles[i]));
+	CHECK(lo.count() == h.count() && lo.min() == h.min() && lo.max() == h.max(),
+	      "merged: count or range differs");
+
+	// many equal values
+	Tempo::histogram same;
+	std::vector<double> svalues(1000, 3.7);
+	for (size_t i = 0; i < svalues.size(); ++i)
+		same.add(svalues[i]);
+	check_quantiles("constant", same, svalues);
+
+	// empty
+	Tempo::histogram empty;
+	CHECK(empty.count() == 0 && empty.sum() == 0 && empty.mean() == 0,
+	      "empty: count, sum or mean is not 0");
+	CHECK(empty.min() == 0 && empty.max() == 0, "empty: range is not 0");
+	for (size_t i = 0; i < nquantiles; ++i)
+		CHECK(empty.quantile(quantiles[i]) == 0, "empty: quantile %g is %g",
+		      quantiles[i], empty.quantile(quantiles[i]));
+	empty.merge(Tempo::histogram());
+	CHECK(empty.count() == 0, "empty: merging an empty histogram adds values");
+
+	// zeros, e.g. the response times of jobs without tasks
+	Tempo::histogram zeros;
+	for (int i = 0; i < 100; ++i)
+		zeros.add(0);
+	for (size_t i = 0; i < nquantiles; ++i)
+		CHECK(zeros.quantile(quantiles[i]) == 0, "zeros: quantile %g is %g",
+		      quantiles[i], zeros.quantile(quantiles[i]));
+	CHECK(zeros.mean() == 0 && zeros.max() == 0, "zeros: mean or max is not 0");
+
+	// zeros mixed with larger values
+	Tempo::histogram mixed;
+	std::vector<double> mvalues;
+	for (int i = 0; i < 1000; ++i) {
+		double v = i % 4? 1 + 100 * uniform(&state): 0;
+		mvalues.push_back(v);
+		mixed.add(v);
+	}
+	check_quantiles("zeros and values", mixed, mvalues);
+
+	h.clear();
+	CHECK(h.count() == 0 && h.quantile(0.5) == 0, "cleared: not empty");
+
+	printf("%d failures\n", failures);
+	return failures != 0;
+}
@@ -0,0 +1,161 @@
+// Check the windows of workload_index against a scan of the pools.
+
+#include <cstdio>
+#include <set>
+#include <utility>
+#include <Tempo/tempo.hpp>
+#include <Tempo/workload_index.hpp>
+
+static int failures;
+
+#define CHECK(cond, ...)					\
+	do {							\
+		if (!(cond)) {					\
+			printf("FAIL %s:%d: ", __FILE__, __LINE__);	\
+			printf(__VA_ARGS__);			\
+			printf("\n");				\
+			++failures;				\
+		}						\
+	} while (0)
+
+// Adds job @id created at @ctime with maps created at @mtimes and
+// reduces at @rtimes, terminated by a negative time
+static void add_job(Tempo::pool &p, uint64_t id, double ctime,
+		    const double *mtimes, const double *rtimes)
+{
+	Tempo::job j;
+	j.id = id;
+	j.ctime = ctime;
+	const double *times[] = { rtimes, mtimes };
+	Tempo::task::task_type types[] = {
+		Tempo::task::TASK_TYPE_REDUCE, Tempo::task::TASK_TYPE_MAP };
+	for (int k = 0; k < 2; ++k) {
+		for (int i = 0; times[k][i] >= 0; ++i) {
+			Tempo::task t;
+			t.id = id * 100 + k * 10 + i;
+			t.ctime = times[k][i];
+			t.ptime = 1;
+			t.stime = -1;
+			t.ftime = -1;
+			t.type = types[k];
+			j.tasks[types[k]].push_back(t);
+		}
+	}
+	p.add_job(j);
+}
+
+typedef std::set< std::pair<size_t, size_t> > entry_set;  // job, slot
+
+// Compares a part with the jobs of @p created within [@t0, @t1), which
+// should come with all of their tasks
+static void check_part(const Tempo::workload_view::part &part, Tempo::pool &p,
+		       double t0, double t1)
+{
+	entry_set jobs, tasks;
+	for (size_t j = 0; j < p.jobs.size(); ++j) {
+		if (!(p.jobs[j].ctime >= t0 && p.jobs[j].ctime < t1))
+			continue;
+		jobs.insert(std::make_pair(j, 0));
+		for (int type = 0; type < Tempo::task::TASK_TYPE_NUM; ++type)
+			for (size_t k = 0; k < p.jobs[j].tasks[type].size(); ++k)
+				tasks.insert(std::make_pair(j, k * Tempo::task::TASK_TYPE_NUM + type));
+	}
+
+	entry_set vjobs, vtasks;
+	double last = -1e300;
+	for (const Tempo::wi_job *j = part.jobs; j != part.jobs_end; ++j) {
+		CHECK(j->ctime >= last, "[%g, %g) %s: jobs out of order",
+		      t0, t1, p.name.c_str());
+		last = j->ctime;
+		vjobs.insert(std::make_pair((size_t)j->job, 0));
+	}
+	for (const Tempo::wi_task *t = part.tasks; t != part.tasks_end; ++t) {
+		CHECK(&part.task_at(*t) == &p.jobs[t->job].tasks[t->type()][t->index()],
+		      "[%g, %g) %s: task_at points elsewhere", t0, t1, p.name.c_str());
+		vtasks.insert(std::make_pair((size_t)t->job, (size_t)t->slot));
+	}
+	CHECK(part.p == &p, "[%g, %g): part of pool %s holds pool %s", t0, t1,
+	      p.name.c_str(), part.p->name.c_str());
+	CHECK(part.job_count() == jobs.size() && vjobs == jobs,
+	      "[%g, %g) %s: %zu jobs, expected %zu", t0, t1, p.name.c_str(),
+	      part.job_count(), jobs.size());
+	CHECK(part.task_count() == tasks.size() && vtasks == tasks,
+	      "[%g, %g) %s: %zu tasks, expected %zu", t0, t1, p.name.c_str(),
+	      part.task_count(), tasks.size());
+}
+
+int main()
+{
+	Tempo::job_tracker jt(4, 4);
+	Tempo::pool &a = jt.add_pool("a", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+	Tempo::pool &b = jt.add_pool("b", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+
+	// jobs 1 and 3 have tasks created after the windows that hold
+	// them, job 6 has none, and jobs are added out of ctime order
+	const double none[] = { -1 };
+	const double m1[] = { 0, 0, -1 }, r1[] = { 5, -1 };
+	const double m2[] = { 2, 3, -1 };
+	const double m3[] = { 4, -1 }, r3[] = { 9, -1 };
+	const double m4[] = { 1, -1 };
+	const double m5[] = { 3, 3, -1 }, r5[] = { 3.5, -1 };
+	add_job(a, 1, 0, m1, r1);
+	add_job(a, 3, 4, m3, r3);
+	add_job(a, 2, 2, m2, none);
+	add_job(b, 5, 3, m5, r5);
+	add_job(b, 4, 1, m4, none);
+	add_job(b, 6, 2, none, none);
+
+	Tempo::workload_index index;
+	// one task per bucket puts bucket edges at multiples of 0.4,
+	// close to the job ctimes
+	index.build(jt.getpools(), 1);
+	CHECK(index.min_ctime() == 0 && index.max_ctime() == 4,
+	      "ctime range [%g, %g], expected [0, 4]", index.min_ctime(), index.max_ctime());
+
+	const double times[] = {
+		-1, 0, 0.4, 0.8, 1, 1.2, 1.6, 2, 2.4, 2.8, 3, 3.2, 3.6, 4,
+		4.0000001, 5, 9, 10 };
+	const size_t ntimes = sizeof(times) / sizeof(times[0]);
+	size_t nslices = 0;
+	for (size_t i = 0; i < ntimes; ++i) {
+		for (size_t k = 0; k < ntimes; ++k) {
+			double t0 = times[i], t1 = times[k];
+			Tempo::workload_view v = index.slice(t0, t1);
+			CHECK(v.parts.size() == 2, "[%g, %g): %zu parts", t0, t1, v.parts.size());
+			if (v.parts.size() != 2)
+				continue;
+			check_part(v.parts[0], a, t0, t1);
+			check_part(v.parts[1], b, t0, t1);
+
+			Tempo::workload_view vb = index.slice(b, t0, t1);
+			CHECK(vb.parts.size() == 1, "[%g, %g) b: %zu parts", t0, t1, vb.parts.size());
+			if (vb.parts.size() == 1)
+				check_part(vb.parts[0], b, t0, t1);
+			++nslices;
+		}
+	}
+
+	// whole jobs: job 3 of [4, 5) brings its reduce created at 9
+	Tempo::workload_view v = index.slice(4, 5);
+	CHECK(v.parts[0].job_count() == 1 && v.parts[0].task_count() == 2,
+	      "[4, 5): %zu jobs and %zu tasks of a, expected 1 and 2",
+	      v.parts[0].job_count(), v.parts[0].task_count());
+	// and tasks created in a window without their job stay out
+	v = index.slice(5, 10);
+	CHECK(v.job_count() == 0 && v.task_count() == 0,
+	      "[5, 10): %zu jobs and %zu tasks, expected none", v.job_count(), v.task_count());
+
+	// an unindexed pool gives an empty view
+	Tempo::pool &c = jt.add_pool("c", -1, -1, 1, 0, 0, Tempo::pool::SCHED_FAIR);
+	CHECK(index.slice(c, 0, 10).parts.empty(), "unindexed pool c has parts");
+
+	// an empty index
+	Tempo::workload_index empty;
+	std::list<Tempo::pool> nopools;
+	empty.build(nopools);
+	CHECK(empty.min_ctime() > empty.max_ctime(), "empty index has a ctime range");
+	CHECK(empty.slice(0, 10).parts.empty(), "empty index has parts");
+
+	printf("%zu windows checked, %d failures\n", nslices, failures);
+	return failures != 0;
+}